@@ -4,10 +4,15 @@
 #include "factors.h"
 #include "utils.h"
 #include "slam_utils.h"
+#include "state_space.h"
 #include "constants.h"
 using namespace NavSim;
 
-int main() {
-  collectDataAndRunSLAM();
-  return 0;
+// Usage: 2D.out [--record <log>] [--headless [seed]]
+//        2D.out --replay <log> [speed]
+// Flags may come in any order. Headless runs simulate in lockstep, without windows, as
+// fast as possible. Recorded logs can be replayed into the estimator with no simulation
+// at all, at `speed` times real time (default: as fast as possible).
+int main(int argc, char **argv) {
+  return slamMain<Planar2D>(argc, argv);
 }
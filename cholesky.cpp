@@ -0,0 +1,240 @@
+#include "cholesky.h"
+#include "parallel.h"
+#include <algorithm>
+#include <Eigen/Cholesky>
+#include <Eigen/OrderingMethods>
+#include <Eigen/SparseCore>
+
+// Spawning a thread costs tens of microseconds, more than factoring a level of a short
+// pose window; levels with less work than this run on the calling thread
+constexpr double MIN_PARALLEL_FLOPS = 1e6;
+
+SupernodalCholesky::SupernodalCholesky() : _n(0), _perm(), _supernodes(), _children(),
+    _levels(), _level_flops(), _pattern(), _num_analyses(0) {}
+
+int SupernodalCholesky::numSupernodes() const {
+  return (int) _supernodes.size();
+}
+
+int SupernodalCholesky::numAnalyses() const {
+  return _num_analyses;
+}
+
+bool SupernodalCholesky::samePattern(const hessian &A) const {
+  if ((int) A.rows() != _n || _pattern.empty()) return false;
+  size_t k = 0;
+  for (int j = 0; j < _n; j++)
+    for (int i = j; i < _n; i++)
+      if ((A(i, j) != 0.0) != (_pattern[k++] != 0)) return false;
+  return true;
+}
+
+// Builds the elimination tree of the (already reordered) matrix, the row structure of
+// every column of L, and from those the supernodes and the levels they are factored in.
+void SupernodalCholesky::analyze(const hessian &Ap) {
+  int n = _n;
+
+  // Elimination tree (Liu's algorithm with path compression)
+  std::vector<int> parent((size_t) n, -1), ancestor((size_t) n, -1);
+  for (int k = 0; k < n; k++) {
+    for (int i = 0; i < k; i++) {
+      if (Ap(k, i) == 0.0) continue;
+      int r = i;
+      while (ancestor[(size_t) r] != -1 && ancestor[(size_t) r] != k) {
+        int next = ancestor[(size_t) r];
+        ancestor[(size_t) r] = k;
+        r = next;
+      }
+      if (ancestor[(size_t) r] == -1) {
+        ancestor[(size_t) r] = k;
+        parent[(size_t) r] = k;
+      }
+    }
+  }
+
+  // Row structure of each column of L: the column's own pattern in A plus the
+  // structure its children in the tree pass up
+  std::vector<std::vector<int>> col_children((size_t) n);
+  for (int j = 0; j < n; j++)
+    if (parent[(size_t) j] != -1) col_children[(size_t) parent[(size_t) j]].push_back(j);
+  std::vector<std::vector<int>> structure((size_t) n);
+  std::vector<int> mark((size_t) n, -1);
+  for (int j = 0; j < n; j++) {
+    std::vector<int> &s = structure[(size_t) j];
+    mark[(size_t) j] = j;
+    for (int i = j + 1; i < n; i++) {
+      if (Ap(i, j) != 0.0) {
+        mark[(size_t) i] = j;
+        s.push_back(i);
+      }
+    }
+    for (int c : col_children[(size_t) j]) {
+      for (int i : structure[(size_t) c]) {
+        if (mark[(size_t) i] != j) {
+          mark[(size_t) i] = j;
+          s.push_back(i);
+        }
+      }
+    }
+    std::sort(s.begin(), s.end());
+  }
+
+  // Fundamental supernodes: a column joins the previous one's supernode if it is that
+  // column's only child's parent and the structures match
+  _supernodes.clear();
+  std::vector<int> col_to_sn((size_t) n, -1);
+  for (int j = 0; j < n; j++) {
+    bool extend = j > 0 && parent[(size_t) j - 1] == j &&
+        col_children[(size_t) j].size() == 1 &&
+        structure[(size_t) j - 1].size() == structure[(size_t) j].size() + 1;
+    if (!extend) {
+      _supernodes.emplace_back();
+      _supernodes.back().first = j;
+    }
+    _supernodes.back().last = j + 1;
+    col_to_sn[(size_t) j] = (int) _supernodes.size() - 1;
+  }
+  for (Supernode &sn : _supernodes) {
+    sn.rows = structure[(size_t) sn.last - 1];
+    int p = parent[(size_t) sn.last - 1];
+    sn.parent = (p == -1) ? -1 : col_to_sn[(size_t) p];
+  }
+
+  // Group supernodes by height in the tree; each level only depends on lower ones
+  size_t num_sn = _supernodes.size();
+  _children.assign(num_sn, std::vector<int>());
+  std::vector<int> height(num_sn, 0);
+  int max_height = 0;
+  for (size_t s = 0; s < num_sn; s++) {
+    int p = _supernodes[s].parent;
+    if (p != -1) {
+      _children[(size_t) p].push_back((int) s);
+      // Parents always come after their children
+      height[(size_t) p] = std::max(height[(size_t) p], height[s] + 1);
+    }
+    max_height = std::max(max_height, height[s]);
+  }
+  _levels.assign((size_t) max_height + 1, std::vector<int>());
+  _level_flops.assign((size_t) max_height + 1, 0.0);
+  for (size_t s = 0; s < num_sn; s++) {
+    _levels[(size_t) height[s]].push_back((int) s);
+    double ncols = _supernodes[s].last - _supernodes[s].first;
+    double front = ncols + (double) _supernodes[s].rows.size();
+    _level_flops[(size_t) height[s]] += ncols * front * front;
+  }
+}
+
+// Position of a global (reordered) row in the supernode's frontal matrix
+int SupernodalCholesky::localIndex(const Supernode &sn, int global) const {
+  if (global < sn.last) return global - sn.first;
+  auto it = std::lower_bound(sn.rows.begin(), sn.rows.end(), global);
+  return (sn.last - sn.first) + (int) (it - sn.rows.begin());
+}
+
+bool SupernodalCholesky::factorSupernode(int s, const hessian &Ap,
+    std::vector<hessian> &updates) {
+  Supernode &sn = _supernodes[(size_t) s];
+  int ncols = sn.last - sn.first;
+  int m = (int) sn.rows.size();
+
+  // Assemble the front: this supernode's columns of A, plus the children's updates
+  hessian front = hessian::Zero(ncols + m, ncols + m);
+  for (int c = 0; c < ncols; c++) {
+    for (int r = c; r < ncols; r++)
+      front(r, c) = Ap(sn.first + r, sn.first + c);
+    for (int r = 0; r < m; r++)
+      front(ncols + r, c) = Ap(sn.rows[(size_t) r], sn.first + c);
+  }
+  for (int child : _children[(size_t) s]) {
+    const Supernode &csn = _supernodes[(size_t) child];
+    hessian &u = updates[(size_t) child];
+    std::vector<int> local(csn.rows.size());
+    for (size_t k = 0; k < csn.rows.size(); k++)
+      local[k] = localIndex(sn, csn.rows[k]);
+    for (int c = 0; c < u.cols(); c++)
+      for (int r = c; r < u.rows(); r++)
+        front(local[(size_t) r], local[(size_t) c]) += u(r, c);
+    u.resize(0, 0);
+  }
+
+  // Dense partial factorization: F11 = L11 L11^T, L21 = F21 L11^-T,
+  // and the update F22 - L21 L21^T goes to the parent
+  Eigen::LLT<hessian> llt(front.topLeftCorner(ncols, ncols));
+  if (llt.info() != Eigen::Success) return false;
+  sn.L.resize(ncols + m, ncols);
+  sn.L.topRows(ncols) = llt.matrixL();
+  sn.L.bottomRows(m) = front.bottomLeftCorner(m, ncols);
+  llt.matrixU().solveInPlace<Eigen::OnTheRight>(sn.L.bottomRows(m));
+  if (sn.parent != -1) {
+    hessian &u = updates[(size_t) s];
+    u = front.bottomRightCorner(m, m);
+    u.selfadjointView<Eigen::Lower>().rankUpdate(sn.L.bottomRows(m), -1.0);
+  }
+  return true;
+}
+
+bool SupernodalCholesky::compute(const hessian &A) {
+  hessian sym = A.selfadjointView<Eigen::Lower>();
+  bool reuse = samePattern(A);
+  if (!reuse) {
+    _n = (int) A.rows();
+    _pattern.clear();
+    for (int j = 0; j < _n; j++)
+      for (int i = j; i < _n; i++)
+        _pattern.push_back(A(i, j) != 0.0);
+    Eigen::SparseMatrix<double> pattern = sym.sparseView();
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> amd;
+    Eigen::AMDOrdering<int>()(pattern, amd);
+    // AMD gives the inverse permutation; Ap = P A P^T
+    _perm = amd.inverse();
+  }
+  hessian Ap = _perm * sym * _perm.transpose();
+  if (!reuse) {
+    analyze(Ap);
+    _num_analyses++;
+  }
+
+  std::vector<hessian> updates(_supernodes.size());
+  std::vector<char> ok(_supernodes.size(), 1);
+  for (size_t l = 0; l < _levels.size(); l++) {
+    const std::vector<int> &level = _levels[l];
+    parallelFor((int) level.size(), [&](int k) {
+      int s = level[(size_t) k];
+      ok[(size_t) s] = factorSupernode(s, Ap, updates);
+    }, 1, _level_flops[l] < MIN_PARALLEL_FLOPS ? 1 : 0);
+    for (int s : level)
+      if (!ok[(size_t) s]) return false;
+  }
+  return true;
+}
+
+hessian SupernodalCholesky::solve(const hessian &B) const {
+  hessian X = _perm * B;
+  // L Y = P B
+  for (const Supernode &sn : _supernodes) {
+    int ncols = sn.last - sn.first;
+    auto xs = X.middleRows(sn.first, ncols);
+    sn.L.topRows(ncols).triangularView<Eigen::Lower>().solveInPlace(xs);
+    if (!sn.rows.empty())
+      X(sn.rows, Eigen::all) -= sn.L.bottomRows((Eigen::Index) sn.rows.size()) * xs;
+  }
+  // L^T Z = Y
+  for (auto it = _supernodes.rbegin(); it != _supernodes.rend(); ++it) {
+    const Supernode &sn = *it;
+    int ncols = sn.last - sn.first;
+    auto xs = X.middleRows(sn.first, ncols);
+    if (!sn.rows.empty())
+      xs -= sn.L.bottomRows((Eigen::Index) sn.rows.size()).transpose() * X(sn.rows, Eigen::all);
+    sn.L.topRows(ncols).triangularView<Eigen::Lower>().transpose().solveInPlace(xs);
+  }
+  return _perm.transpose() * X;
+}
+
+values SupernodalCholesky::solve(const values &b) const {
+  hessian B = b;
+  return solve(B).col(0);
+}
+
+hessian SupernodalCholesky::inverse() const {
+  return solve(hessian(hessian::Identity(_n, _n)));
+}
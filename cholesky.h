@@ -0,0 +1,61 @@
+#ifndef CHOLESKY_H
+#define CHOLESKY_H
+
+#include <Eigen/Core>
+#include <vector>
+#include "graph.h"
+
+/* Supernodal multifrontal Cholesky factorization of a symmetric positive definite matrix.
+ *
+ * The matrix is reordered with AMD, and the elimination tree of the reordered sparsity
+ * pattern groups columns with identical structure into supernodes. Each supernode is
+ * factored as a dense frontal matrix with blocked kernels (LLT, triangular solve and a
+ * rank update), and passes its update matrix up to its parent. Supernodes that don't
+ * depend on each other (the same distance from the leaves of the tree) are factored
+ * concurrently with parallelFor, once a level has enough work to pay for the threads.
+ *
+ * The ordering and the supernodes only depend on the sparsity pattern, so they are kept
+ * and reused as long as compute() is given matrices with the same pattern (as in the
+ * iterations of a Newton solve).
+ *
+ * Only the lower triangle of the input is read. */
+class SupernodalCholesky {
+public:
+  SupernodalCholesky();
+
+  // Returns false if the matrix is not (numerically) positive definite.
+  bool compute(const hessian &A);
+  // Solves A X = B for the last matrix passed to compute().
+  hessian solve(const hessian &B) const;
+  values solve(const values &b) const;
+  hessian inverse() const;
+
+  int numSupernodes() const;
+  // How many times compute() had to redo the symbolic analysis
+  int numAnalyses() const;
+
+private:
+  struct Supernode {
+    Supernode() : first(0), last(0), rows(), parent(-1), L() {}
+    int first, last;       // columns [first, last) of the reordered matrix
+    std::vector<int> rows; // sorted row structure below the diagonal block
+    int parent;
+    hessian L;             // [L11; L21], (last - first + rows.size()) x (last - first)
+  };
+
+  bool samePattern(const hessian &A) const;
+  void analyze(const hessian &Ap);
+  bool factorSupernode(int s, const hessian &Ap, std::vector<hessian> &updates);
+  int localIndex(const Supernode &sn, int global) const;
+
+  int _n;
+  Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> _perm;
+  std::vector<Supernode> _supernodes;
+  std::vector<std::vector<int>> _children;
+  std::vector<std::vector<int>> _levels;
+  std::vector<double> _level_flops;  // rough cost of factoring each level
+  std::vector<char> _pattern;        // nonzeros of the lower triangle last analyzed
+  int _num_analyses;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include "correlative_matcher.h"
+#include <algorithm>
+
+CorrelativeScanMatcher::CorrelativeScanMatcher(const points_t &reference,
+    const CorrelativeParams &params) : _params(params), _origin_x(0), _origin_y(0),
+    _width(1), _height(1), _levels() {
+  double res = _params.resolution;
+  int radius = (int) std::ceil(3 * _params.sigma / res);
+  double min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+  for (const point_t &p : reference) {
+    if (p(2) == 0) continue;
+    min_x = std::min(min_x, p(0));
+    min_y = std::min(min_y, p(1));
+    max_x = std::max(max_x, p(0));
+    max_y = std::max(max_y, p(1));
+  }
+  if (min_x <= max_x) {
+    _origin_x = min_x - radius * res;
+    _origin_y = min_y - radius * res;
+    _width = (int) std::ceil((max_x - min_x) / res) + 2 * radius + 1;
+    _height = (int) std::ceil((max_y - min_y) / res) + 2 * radius + 1;
+  }
+
+  // Finest level: likelihood of the nearest reference point, cut off at 3 sigma
+  std::vector<float> fine((size_t) _width * (size_t) _height, 0.0f);
+  for (const point_t &p : reference) {
+    if (p(2) == 0) continue;
+    int cx = (int) std::lround((p(0) - _origin_x) / res);
+    int cy = (int) std::lround((p(1) - _origin_y) / res);
+    for (int y = std::max(0, cy - radius); y <= std::min(_height - 1, cy + radius); y++) {
+      for (int x = std::max(0, cx - radius); x <= std::min(_width - 1, cx + radius); x++) {
+        double dx = _origin_x + x * res - p(0), dy = _origin_y + y * res - p(1);
+        float l = (float) std::exp(-(dx*dx + dy*dy) / (2 * _params.sigma * _params.sigma));
+        float &cell = fine[(size_t) y * (size_t) _width + (size_t) x];
+        cell = std::max(cell, l);
+      }
+    }
+  }
+  _levels.push_back(fine);
+
+  // Level k holds the max of the finest cells in [x, x + 2^k) x [y, y + 2^k)
+  for (int k = 1; k < _params.levels; k++) {
+    const std::vector<float> &prev = _levels.back();
+    int h = 1 << (k - 1);
+    std::vector<float> next(prev.size(), 0.0f);
+    for (int y = 0; y < _height; y++) {
+      for (int x = 0; x < _width; x++) {
+        float m = prev[(size_t) y * (size_t) _width + (size_t) x];
+        if (x + h < _width) m = std::max(m, prev[(size_t) y * (size_t) _width + (size_t) (x + h)]);
+        if (y + h < _height) {
+          m = std::max(m, prev[(size_t) (y + h) * (size_t) _width + (size_t) x]);
+          if (x + h < _width)
+            m = std::max(m, prev[(size_t) (y + h) * (size_t) _width + (size_t) (x + h)]);
+        }
+        next[(size_t) y * (size_t) _width + (size_t) x] = m;
+      }
+    }
+    _levels.push_back(next);
+  }
+}
+
+// Max of the finest cells in the block [x, x + 2^level) x [y, y + 2^level). A block that
+// starts below the grid is bounded by the one at the grid's edge, which covers its overlap.
+float CorrelativeScanMatcher::value(int level, int x, int y) const {
+  int size = 1 << level;
+  if (x + size <= 0 || y + size <= 0 || x >= _width || y >= _height) return 0.0f;
+  x = std::max(x, 0);
+  y = std::max(y, 0);
+  return _levels[(size_t) level][(size_t) y * (size_t) _width + (size_t) x];
+}
+
+// Mean grid value of the scan points (given as cell coordinates) shifted by (dx, dy)
+double CorrelativeScanMatcher::score(int level, const std::vector<int> &cells,
+    int dx, int dy) const {
+  double sum = 0;
+  for (size_t i = 0; i < cells.size(); i += 2)
+    sum += value(level, cells[i] + dx, cells[i + 1] + dy);
+  return sum / (double) (cells.size() / 2);
+}
+
+// Depth-first branch and bound. Candidates at `level` are blocks of 2^level x 2^level
+// translations whose score is an upper bound for every translation in the block.
+void CorrelativeScanMatcher::search(int level, std::vector<Candidate> &candidates,
+    const std::vector<std::vector<int>> &angle_cells, int window, Candidate &best) const {
+  std::sort(candidates.begin(), candidates.end(),
+      [](const Candidate &a, const Candidate &b) { return a.score > b.score; });
+  for (const Candidate &c : candidates) {
+    if (c.score <= best.score) break;
+    if (level == 0) {
+      best = c;
+      continue;
+    }
+    int h = 1 << (level - 1);
+    std::vector<Candidate> children;
+    for (int ox = 0; ox <= h; ox += h) {
+      for (int oy = 0; oy <= h; oy += h) {
+        int dx = c.dx + ox, dy = c.dy + oy;
+        if (dx > window || dy > window) continue;
+        children.push_back({c.angle, dx, dy,
+            score(level - 1, angle_cells[(size_t) c.angle], dx, dy)});
+      }
+    }
+    search(level - 1, children, angle_cells, window, best);
+  }
+}
+
+CorrelativeResult CorrelativeScanMatcher::match(const points_t &scan,
+    const transform_t &initial) const {
+  CorrelativeResult result;
+  double res = _params.resolution;
+  double max_range = 0;
+  int n = 0;
+  for (const point_t &p : scan) {
+    if (p(2) == 0) continue;
+    max_range = std::max(max_range, p.head<2>().norm());
+    n++;
+  }
+  if (n == 0) return result;
+
+  // Angular step that moves the furthest point by about one cell
+  double theta_step = (max_range > res) ? std::acos(1 - res * res / (2 * max_range * max_range)) : 0.1;
+  int num_steps = (int) std::ceil(_params.search_theta / theta_step);
+  int window = (int) std::ceil(_params.search_xy / res);
+  double theta0 = atan2(initial(1,0), initial(0,0));
+
+  // Scan points rotated by each candidate angle, as cells of the grid (no offset yet)
+  std::vector<std::vector<int>> angle_cells;
+  std::vector<double> angles;
+  for (int a = -num_steps; a <= num_steps; a++) {
+    double theta = theta0 + a * theta_step;
+    double c = cos(theta), s = sin(theta);
+    std::vector<int> cells;
+    cells.reserve(2 * (size_t) n);
+    for (const point_t &p : scan) {
+      if (p(2) == 0) continue;
+      double qx = c * p(0) - s * p(1) + initial(0,2);
+      double qy = s * p(0) + c * p(1) + initial(1,2);
+      cells.push_back((int) std::lround((qx - _origin_x) / res));
+      cells.push_back((int) std::lround((qy - _origin_y) / res));
+    }
+    angle_cells.push_back(cells);
+    angles.push_back(theta);
+  }
+
+  int top = (int) _levels.size() - 1;
+  int block = 1 << top;
+  std::vector<Candidate> roots;
+  for (size_t a = 0; a < angle_cells.size(); a++) {
+    for (int dx = -window; dx <= window; dx += block) {
+      for (int dy = -window; dy <= window; dy += block) {
+        roots.push_back({(int) a, dx, dy, score(top, angle_cells[a], dx, dy)});
+      }
+    }
+  }
+  Candidate best = {0, 0, 0, 0.0};
+  search(top, roots, angle_cells, window, best);
+  if (best.score <= 0) return result;
+
+  double theta = angles[(size_t) best.angle];
+  result.tf << cos(theta), -sin(theta), initial(0,2) + best.dx * res,
+               sin(theta), cos(theta), initial(1,2) + best.dy * res,
+               0, 0, 1;
+  result.score = best.score;
+  result.found = true;
+  return result;
+}
@@ -0,0 +1,59 @@
+#ifndef CORRELATIVE_MATCHER_H
+#define CORRELATIVE_MATCHER_H
+
+#include <cmath>
+#include <vector>
+#include "utils.h"
+
+struct CorrelativeParams {
+  double resolution = 0.05;      // m, size of the finest grid cells
+  double sigma = 0.1;            // m, blur of the reference points in the likelihood grid
+  double search_xy = 4.0;        // m, search window around the initial guess (each way)
+  double search_theta = M_PI/4;  // rad, search window around the initial guess (each way)
+  int levels = 6;                // pyramid levels; level k cells cover 2^k finest cells
+};
+
+struct CorrelativeResult {
+  CorrelativeResult() : tf(transform_t::Identity()), score(0.0), found(false) {}
+
+  transform_t tf; // takes the scan onto the reference scan (tf * p1 = p2)
+  double score;   // mean likelihood of the scan points, in [0, 1]
+  bool found;     // false if the scan has no valid points
+};
+
+/* Correlative scan matcher for aligning scans from a poor initial guess (e.g. after a
+ * GPS glitch), where ICP would converge to the wrong local minimum.
+ *
+ * The reference scan is rasterized into a likelihood grid (each cell holds the Gaussian
+ * likelihood of the nearest reference point), and a pyramid of max-pooled grids is built
+ * on top of it. match() does a branch-and-bound search over (x, y, theta): translations
+ * are searched coarse to fine, and the pooled grids give an upper bound on the score of
+ * every finer translation in a block, so most of the window is never scored. The result
+ * is the global optimum over the window, to within one cell and one angular step, and
+ * is a good starting point for point_to_line_icp. */
+class CorrelativeScanMatcher {
+public:
+  explicit CorrelativeScanMatcher(const points_t &reference,
+      const CorrelativeParams &params = CorrelativeParams());
+
+  CorrelativeResult match(const points_t &scan,
+      const transform_t &initial = transform_t::Identity()) const;
+
+private:
+  struct Candidate {
+    int angle, dx, dy;
+    double score;
+  };
+
+  CorrelativeParams _params;
+  double _origin_x, _origin_y; // center of cell (0, 0)
+  int _width, _height;
+  std::vector<std::vector<float>> _levels; // _levels[k][y * _width + x]
+
+  float value(int level, int x, int y) const;
+  double score(int level, const std::vector<int> &cells, int dx, int dy) const;
+  void search(int level, std::vector<Candidate> &candidates,
+      const std::vector<std::vector<int>> &angle_cells, int window, Candidate &best) const;
+};
+
+#endif
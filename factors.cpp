@@ -19,13 +19,16 @@ measurement<1> OdomFactor::f(const values &x) {
   return measurement<1> { x(_idx2) - x(_idx1) };
 }
 
-jacobian<1> OdomFactor::jf(const values &x) {
-  jacobian<1> j = jacobian<1>::Zero(x.size(), 1);
-  j(_idx2) = 1;
-  j(_idx1) = -1;
+jacobian<1> OdomFactor::jf_local(const values &/*x*/) {
+  jacobian<1> j(2, 1);
+  j << -1, 1;
   return j;
 }
 
+std::vector<int> OdomFactor::indices() const {
+  return {_idx1, _idx2};
+}
+
 bool OdomFactor::shiftIndices(int poseSize, int firstPoseIdx) {
   _idx1 -= poseSize;
   _idx2 -= poseSize;
@@ -40,10 +43,12 @@ measurement<1> GPSFactor::f(const values &x) {
   return measurement<1> { x(_idx) };
 }
 
-jacobian<1> GPSFactor::jf(const values &x) {
-  jacobian<1> j = jacobian<1>::Zero(x.size(), 1);
-  j(_idx) = 1;
-  return j;
+jacobian<1> GPSFactor::jf_local(const values &/*x*/) {
+  return jacobian<1>::Ones(1, 1);
+}
+
+std::vector<int> GPSFactor::indices() const {
+  return {_idx};
 }
 
 bool GPSFactor::shiftIndices(int poseSize, int firstPoseIdx) {
@@ -51,6 +56,35 @@ bool GPSFactor::shiftIndices(int poseSize, int firstPoseIdx) {
   return _idx >= firstPoseIdx;
 }
 
+LandmarkFactor1D::LandmarkFactor1D(int lmPose, int sensorPose,
+      const covariance<1> &sigma_inv, const measurement<1> m) : Factor<1>(
+    sigma_inv, m
+    ), _lmPose(lmPose), _sensorPose(sensorPose) { }
+
+measurement<1> LandmarkFactor1D::f(const values &x) {
+  double px = (_sensorPose >= 0) ? x(_sensorPose) : 0.0;
+  return measurement<1> { x(_lmPose) - px };
+}
+
+jacobian<1> LandmarkFactor1D::jf_local(const values &/*x*/) {
+  jacobian<1> j = jacobian<1>::Ones(_sensorPose >= 0 ? 2 : 1, 1);
+  if (_sensorPose >= 0) j(1) = -1;
+  return j;
+}
+
+std::vector<int> LandmarkFactor1D::indices() const {
+  if (_sensorPose >= 0) return {_lmPose, _sensorPose};
+  return {_lmPose};
+}
+
+bool LandmarkFactor1D::shiftIndices(int poseSize, int firstPoseIdx) {
+  if (_sensorPose >= 0) {
+    _sensorPose -= poseSize;
+    return _sensorPose >= firstPoseIdx;
+  }
+  return true;
+}
+
 LandmarkFactor2D::LandmarkFactor2D(int lmPose, int sensorPose,
       const covariance<2> &sigma_inv, const measurement<2> m) : Factor<2>(
     sigma_inv, m
@@ -69,29 +103,36 @@ measurement<2> LandmarkFactor2D::f(const values &x) {
   };
 }
 
-jacobian<2> LandmarkFactor2D::jf(const values &x) {
-  jacobian<2> j = jacobian<2>::Zero(x.size(), 2);
+// Rows follow indices(): the landmark's (x, y), then the sensor pose's (x, y, theta)
+jacobian<2> LandmarkFactor2D::jf_local(const values &x) {
+  jacobian<2> j = jacobian<2>::Zero(_sensorPose >= 0 ? 5 : 2, 2);
   double px(0), py(0), theta(0);
   if (_sensorPose >= 0) {
     px = x(_sensorPose);
     py = x(_sensorPose+1);
     theta = x(_sensorPose+2);
   }
-  j(_lmPose+0,0) = cos(theta);
-  j(_lmPose+1,0) = sin(theta);
-  j(_lmPose+0,1) = -sin(theta);
-  j(_lmPose+1,1) = cos(theta);
+  j(0,0) = cos(theta);
+  j(1,0) = sin(theta);
+  j(0,1) = -sin(theta);
+  j(1,1) = cos(theta);
   if (_sensorPose >= 0) {
-    j(_sensorPose+0,0)   = -cos(theta);
-    j(_sensorPose+1,0)   = -sin(theta);
-    j(_sensorPose+2,0)   = (x(_lmPose) - px) * (-sin(theta)) + (x(_lmPose+1) - py) * cos(theta);
-    j(_sensorPose+0,1)   = sin(theta);
-    j(_sensorPose+1,1)   = -cos(theta);
-    j(_sensorPose+2,1)   = (x(_lmPose) - px) * (-cos(theta)) + (x(_lmPose+1) - py) * (-sin(theta));
+    j(2,0)   = -cos(theta);
+    j(3,0)   = -sin(theta);
+    j(4,0)   = (x(_lmPose) - px) * (-sin(theta)) + (x(_lmPose+1) - py) * cos(theta);
+    j(2,1)   = sin(theta);
+    j(3,1)   = -cos(theta);
+    j(4,1)   = (x(_lmPose) - px) * (-cos(theta)) + (x(_lmPose+1) - py) * (-sin(theta));
   }
   return j;
 }
 
+std::vector<int> LandmarkFactor2D::indices() const {
+  if (_sensorPose >= 0)
+    return {_lmPose, _lmPose+1, _sensorPose, _sensorPose+1, _sensorPose+2};
+  return {_lmPose, _lmPose+1};
+}
+
 bool LandmarkFactor2D::shiftIndices(int poseSize, int firstPoseIdx) {
   if (_sensorPose >= 0) {
     _sensorPose -= poseSize;
@@ -121,31 +162,38 @@ measurement<3> OdomFactor2D::f(const values &x) {
   };
 }
 
-jacobian<3> OdomFactor2D::jf(const values &x) {
-  jacobian<3> j = jacobian<3>::Zero(x.size(), 3);
+// Rows follow indices(): pose2's (x, y, theta), then pose1's
+jacobian<3> OdomFactor2D::jf_local(const values &x) {
+  jacobian<3> j = jacobian<3>::Zero(_pose1 >= 0 ? 6 : 3, 3);
   double px(0), py(0), theta(0);
   if (_pose1 >= 0) {
     px = x(_pose1);
     py = x(_pose1+1);
     theta = x(_pose1+2);
   }
-  j(_pose2+0,0) = cos(theta);
-  j(_pose2+1,0) = sin(theta);
-  j(_pose2+0,1) = -sin(theta);
-  j(_pose2+1,1) = cos(theta);
-  j(_pose2+2,2) = 1;
+  j(0,0) = cos(theta);
+  j(1,0) = sin(theta);
+  j(0,1) = -sin(theta);
+  j(1,1) = cos(theta);
+  j(2,2) = 1;
   if (_pose1 >= 0) {
-    j(_pose1+0,0)   = -cos(theta);
-    j(_pose1+1,0)   = -sin(theta);
-    j(_pose1+2,0)   = (x(_pose2) - px) * (-sin(theta)) + (x(_pose2+1) - py) * cos(theta);
-    j(_pose1+0,1)   = sin(theta);
-    j(_pose1+1,1)   = -cos(theta);
-    j(_pose1+2,1)   = (x(_pose2) - px) * (-cos(theta)) + (x(_pose2+1) - py) * (-sin(theta));
-    j(_pose1+2,2) = -1;
+    j(3,0)   = -cos(theta);
+    j(4,0)   = -sin(theta);
+    j(5,0)   = (x(_pose2) - px) * (-sin(theta)) + (x(_pose2+1) - py) * cos(theta);
+    j(3,1)   = sin(theta);
+    j(4,1)   = -cos(theta);
+    j(5,1)   = (x(_pose2) - px) * (-cos(theta)) + (x(_pose2+1) - py) * (-sin(theta));
+    j(5,2) = -1;
   }
   return j;
 }
 
+std::vector<int> OdomFactor2D::indices() const {
+  if (_pose1 >= 0)
+    return {_pose2, _pose2+1, _pose2+2, _pose1, _pose1+1, _pose1+2};
+  return {_pose2, _pose2+1, _pose2+2};
+}
+
 bool OdomFactor2D::shiftIndices(int poseSize, int firstPoseIdx) {
   _pose2 -= poseSize;
   if (_pose1 >= 0) {
@@ -155,3 +203,74 @@ bool OdomFactor2D::shiftIndices(int poseSize, int firstPoseIdx) {
     return _pose2 >= firstPoseIdx;
   }
 }
+
+void OdomFactor::serialize(BlobWriter &out) const {
+  out.write(FactorType::Odom);
+  out.write<int32_t>(_idx1);
+  out.write<int32_t>(_idx2);
+  serializeNoise(out);
+}
+
+void GPSFactor::serialize(BlobWriter &out) const {
+  out.write(FactorType::GPS);
+  out.write<int32_t>(_idx);
+  serializeNoise(out);
+}
+
+void LandmarkFactor1D::serialize(BlobWriter &out) const {
+  out.write(FactorType::Landmark1D);
+  out.write<int32_t>(_lmPose);
+  out.write<int32_t>(_sensorPose);
+  serializeNoise(out);
+}
+
+void LandmarkFactor2D::serialize(BlobWriter &out) const {
+  out.write(FactorType::Landmark2D);
+  out.write<int32_t>(_lmPose);
+  out.write<int32_t>(_sensorPose);
+  serializeNoise(out);
+}
+
+void OdomFactor2D::serialize(BlobWriter &out) const {
+  out.write(FactorType::Odom2D);
+  out.write<int32_t>(_pose2);
+  out.write<int32_t>(_pose1);
+  serializeNoise(out);
+}
+
+AbstractFactor *deserializeFactor(BlobReader &in) {
+  FactorType type;
+  int32_t idx1 = 0, idx2 = 0;
+  if (!in.read(type) || !in.read(idx1)) return nullptr;
+  if (type != FactorType::GPS && !in.read(idx2)) return nullptr;
+  switch (type) {
+    case FactorType::Odom:
+    case FactorType::GPS: {
+      covariance<1> sigma_inv;
+      measurement<1> m;
+      if (!in.readMatrix(sigma_inv) || !in.readMatrix(m)) return nullptr;
+      double sigma = 1/sqrt(sigma_inv(0,0));
+      if (type == FactorType::GPS) return new GPSFactor(idx1, sigma, m(0));
+      return new OdomFactor(idx1, idx2, sigma, m(0));
+    }
+    case FactorType::Landmark1D: {
+      covariance<1> sigma_inv;
+      measurement<1> m;
+      if (!in.readMatrix(sigma_inv) || !in.readMatrix(m)) return nullptr;
+      return new LandmarkFactor1D(idx1, idx2, sigma_inv, m);
+    }
+    case FactorType::Landmark2D: {
+      covariance<2> sigma_inv;
+      measurement<2> m;
+      if (!in.readMatrix(sigma_inv) || !in.readMatrix(m)) return nullptr;
+      return new LandmarkFactor2D(idx1, idx2, sigma_inv, m);
+    }
+    case FactorType::Odom2D: {
+      covariance<3> sigma_inv;
+      measurement<3> m;
+      if (!in.readMatrix(sigma_inv) || !in.readMatrix(m)) return nullptr;
+      return new OdomFactor2D(idx1, idx2, sigma_inv, m);
+    }
+  }
+  return nullptr;
+}
@@ -13,6 +13,15 @@ using measurement = Eigen::Matrix<double, D, 1>;
 template <int D>
 using covariance = Eigen::Matrix<double, D, D>;
 
+// Tags written at the start of each serialized factor
+enum class FactorType : uint8_t {
+  Odom = 1,
+  GPS = 2,
+  Landmark2D = 3,
+  Odom2D = 4,
+  Landmark1D = 5,
+};
+
 template <int D>
 class Factor : public AbstractFactor {
 public:
@@ -23,7 +32,18 @@ public:
       _sigma_inv(sigma_inv), _measurement(measurement) {}
 
   virtual measurement<D> f(const values &/*x*/) = 0;
-  virtual jacobian<D> jf(const values &/*x*/) = 0;
+  // Jacobian of f with respect to the variables in indices(), one row each (in order)
+  virtual jacobian<D> jf_local(const values &/*x*/) = 0;
+
+  // Jacobian of f with respect to all of x
+  jacobian<D> jf(const values &x) {
+    std::vector<int> idx = indices();
+    jacobian<D> j_local = jf_local(x);
+    jacobian<D> j = jacobian<D>::Zero(x.size(), D);
+    for (size_t k = 0; k < idx.size(); k++)
+      j.row(idx[k]) += j_local.row((int) k);
+    return j;
+  }
 
   virtual double eval(const values &x) {
     measurement<D> diff = f(x) - _measurement;
@@ -38,16 +58,34 @@ public:
     jacobian<D> j = jf(x);
     return j * _sigma_inv * j.transpose();
   }
+
+  virtual void linearize(const values &x, values &grad, hessian &hess) {
+    jacobian<D> j = jf_local(x);
+    grad = j * (_sigma_inv * (f(x) - _measurement));
+    hess = j * _sigma_inv * j.transpose();
+  }
+
+protected:
+  void serializeNoise(BlobWriter &out) const {
+    out.writeMatrix(_sigma_inv);
+    out.writeMatrix(_measurement);
+  }
 };
 
+// Rebuilds a factor written by AbstractFactor::serialize.
+// Returns nullptr if the data is malformed.
+AbstractFactor *deserializeFactor(BlobReader &in);
+
 class OdomFactor : public Factor<1> {
   int _idx1, _idx2;
 
 public:
   OdomFactor(int idx1, int idx2, double sigma, double m);
   virtual measurement<1> f(const values &x);
-  virtual jacobian<1> jf(const values &x);
+  virtual jacobian<1> jf_local(const values &x);
   virtual bool shiftIndices(int poseSize, int firstPoseIdx);
+  virtual std::vector<int> indices() const;
+  virtual void serialize(BlobWriter &out) const;
 };
 
 
@@ -57,8 +95,24 @@ class GPSFactor : public Factor<1> {
 public:
   GPSFactor(int idx, double sigma, double m);
   virtual measurement<1> f(const values &x);
-  virtual jacobian<1> jf(const values &x);
+  virtual jacobian<1> jf_local(const values &x);
+  virtual bool shiftIndices(int poseSize, int firstPoseIdx);
+  virtual std::vector<int> indices() const;
+  virtual void serialize(BlobWriter &out) const;
+};
+
+// Like LandmarkFactor2D, but along a line: measures x(lmPose) - x(sensorPose).
+// A negative sensorPose makes this a prior on the landmark location.
+class LandmarkFactor1D : public Factor<1> {
+  int _lmPose, _sensorPose;
+
+public:
+  LandmarkFactor1D(int lmPose, int sensorPose, const covariance<1> &sigma_inv, const measurement<1> m);
+  virtual measurement<1> f(const values &x);
+  virtual jacobian<1> jf_local(const values &x);
   virtual bool shiftIndices(int poseSize, int firstPoseIdx);
+  virtual std::vector<int> indices() const;
+  virtual void serialize(BlobWriter &out) const;
 };
 
 class LandmarkFactor2D : public Factor<2> {
@@ -67,8 +121,10 @@ class LandmarkFactor2D : public Factor<2> {
 public:
   LandmarkFactor2D(int lmPose, int sensorPose, const covariance<2> &sigma_inv, const measurement<2> m);
   virtual measurement<2> f(const values &x);
-  virtual jacobian<2> jf(const values &x);
+  virtual jacobian<2> jf_local(const values &x);
   virtual bool shiftIndices(int poseSize, int firstPoseIdx);
+  virtual std::vector<int> indices() const;
+  virtual void serialize(BlobWriter &out) const;
 };
 
 class OdomFactor2D : public Factor<3> {
@@ -77,8 +133,10 @@ class OdomFactor2D : public Factor<3> {
 public:
   OdomFactor2D(int pose2, int pose1, const covariance<3> &sigma_inv, const measurement<3> m);
   virtual measurement<3> f(const values &x);
-  virtual jacobian<3> jf(const values &x);
+  virtual jacobian<3> jf_local(const values &x);
   virtual bool shiftIndices(int poseSize, int firstPoseIdx);
+  virtual std::vector<int> indices() const;
+  virtual void serialize(BlobWriter &out) const;
 };
 
 #endif
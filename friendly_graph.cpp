@@ -3,55 +3,59 @@
 #include "utils.h"
 #include "constants.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <Eigen/Core>
 #include <Eigen/LU>
 #include <vector>
 
 using namespace NavSim;
 
-constexpr int LM_SIZE = 2;
-constexpr int POSE_SIZE = 3;
+constexpr uint32_t CHECKPOINT_MAGIC = 0x4b434746; // "FGCK"
+constexpr uint32_t CHECKPOINT_VERSION = 5;
 
-FriendlyGraph::FriendlyGraph(int num_landmarks, int max_num_poses,
+template <typename Traits>
+FriendlyGraph<Traits>::FriendlyGraph(int num_landmarks, int max_num_poses,
       float camera_std, float gps_xy_std, float wheel_noise_rate) :
     _num_landmarks(num_landmarks), _max_pose_id(0), _min_pose_id(0),
     _max_num_poses(max_num_poses), _current_guess(LM_SIZE*num_landmarks),
-    _odom_cov_inv(), _sensor_cov_inv(), _gps_cov_inv(), _graph()
+    _odom_cov_inv(), _sensor_cov_inv(), _gps_cov_inv(),
+    _guessed_poses(), _pending_obs({}), _lm_obs((size_t)num_landmarks), _max_factors_per_landmark(0),
+    _merge_xy_dist(-1.0), _merge_theta_dist(-1.0), _graph()
 {
-  covariance<3> odom_cov = covariance<3>::Zero();
-  // TODO what are the right numbers here? Should y be correlated with theta?
-  odom_cov << wheel_noise_rate, 0, 0,
-              0, wheel_noise_rate, wheel_noise_rate/2.0,
-              0, wheel_noise_rate/2.0, wheel_noise_rate;
-  _odom_cov_inv = odom_cov.inverse();
-  covariance<2> sensor_cov = covariance<2>::Zero();
-  sensor_cov << camera_std * camera_std, 0,
-                0, camera_std * camera_std;
+  _odom_cov_inv = Traits::odomCovariance(wheel_noise_rate).inverse();
+  covariance<LM_SIZE> sensor_cov = covariance<LM_SIZE>::Identity() * camera_std * camera_std;
   _sensor_cov_inv = sensor_cov.inverse();
-  // GPS has no heading measurements
-  // which we represent using a large covariance
-  covariance<3> gps_cov = covariance<3>::Zero();
-  gps_cov << gps_xy_std * gps_xy_std, 0, 0,
-             0, gps_xy_std * gps_xy_std, 0,
-             0, 0, 50.0 * 50.0;
-  _gps_cov_inv = gps_cov.inverse();
+  _gps_cov_inv = Traits::gpsCovariance(gps_xy_std).inverse();
+  // Landmarks come first in the state vector and only ever connect to poses
+  _graph.eliminateLandmarks(num_landmarks, LM_SIZE);
+  // Most of the window barely moves between solves; only relinearize what does
+  _graph.setRelinearizeThreshold(1e-6);
 }
 
-int FriendlyGraph::numPoses() {
+template <typename Traits>
+int FriendlyGraph<Traits>::numPoses() {
   return _max_pose_id - _min_pose_id;
 }
 
-int FriendlyGraph::nonincrementingPoseIdx(int pose_id) {
+template <typename Traits>
+int FriendlyGraph<Traits>::nonincrementingPoseIdx(int pose_id) {
   return _num_landmarks * LM_SIZE + (pose_id - _min_pose_id) * POSE_SIZE;
 }
 
-void FriendlyGraph::incrementNumPoses() {
+template <typename Traits>
+void FriendlyGraph<Traits>::incrementNumPoses() {
   _max_pose_id++;
   _current_guess.conservativeResize(nonincrementingPoseIdx(_max_pose_id));
+  _current_guess.tail(POSE_SIZE).setZero(); // until odometry or a prior gives a guess
 }
 
-int FriendlyGraph::poseIdx(int pose_id) {
+template <typename Traits>
+int FriendlyGraph<Traits>::poseIdx(int pose_id) {
   if (pose_id == _max_pose_id) {
     incrementNumPoses();
   } else if (pose_id > _max_pose_id) {
@@ -61,12 +65,14 @@ int FriendlyGraph::poseIdx(int pose_id) {
   return nonincrementingPoseIdx(pose_id);
 }
 
-int FriendlyGraph::landmarkIdx(int lm_id) {
+template <typename Traits>
+int FriendlyGraph<Traits>::landmarkIdx(int lm_id) {
   assert(lm_id < _num_landmarks);
   return lm_id * LM_SIZE;
 }
 
-void FriendlyGraph::trimToMaxNumPoses() {
+template <typename Traits>
+void FriendlyGraph<Traits>::trimToMaxNumPoses() {
   if (numPoses() > _max_num_poses) {
     if (numPoses() != _max_num_poses + 1) {
       printf("Error: skipped a trim\n");
@@ -74,78 +80,188 @@ void FriendlyGraph::trimToMaxNumPoses() {
     }
     hessian sol_cov = _graph.covariance();
     int base_idx = poseIdx(_min_pose_id+1);
-    measurement<3> first_pose = getPoseEstimate(_min_pose_id+1);
-    covariance<3> first_pose_cov = sol_cov.block(
+    pose_state first_pose = stateEstimate(_min_pose_id+1);
+    covariance<POSE_SIZE> first_pose_cov = sol_cov.block(
         base_idx, base_idx, POSE_SIZE, POSE_SIZE);
     values old_guess = _current_guess;
     //printf("Trimming. Current uncertainty on base pose: %f %f %f\n",
     //    sqrt(first_pose_cov(0,0)), sqrt(first_pose_cov(1,1)), sqrt(first_pose_cov(2,2)));
     _graph.shiftIndices(POSE_SIZE, poseIdx(_min_pose_id));
     _min_pose_id += 1;
+    _guessed_poses.erase(_guessed_poses.begin(), _guessed_poses.lower_bound(_min_pose_id));
+    // The graph has already deleted the landmark factors attached to the old pose
+    for (auto &lm_obs : _lm_obs) {
+      auto it = lm_obs.begin();
+      while (it != lm_obs.end()) {
+        if (it->pose_id < _min_pose_id) it = lm_obs.erase(it);
+        else ++it;
+      }
+    }
     _current_guess.conservativeResize(nonincrementingPoseIdx(_max_pose_id));
     _current_guess.block(poseIdx(_min_pose_id), 0, _max_num_poses * POSE_SIZE, 1) =
       old_guess.block(poseIdx(_min_pose_id+1), 0, _max_num_poses * POSE_SIZE, 1);
-    addPosePrior(_min_pose_id, toTransform(first_pose), first_pose_cov);
+    addPosePrior(_min_pose_id, Traits::toTransform(first_pose), first_pose_cov);
   }
 }
 
-pose_t FriendlyGraph::getPoseEstimate(int pose_id) {
+template <typename Traits>
+typename FriendlyGraph<Traits>::pose_state FriendlyGraph<Traits>::stateEstimate(int pose_id) {
   assert("bad pose id" && pose_id >= _min_pose_id && pose_id < _max_pose_id);
-  pose_t p = _current_guess.block(poseIdx(pose_id), 0, POSE_SIZE, 1);
+  pose_state p = _current_guess.block(poseIdx(pose_id), 0, POSE_SIZE, 1);
   return p;
 }
 
-void FriendlyGraph::addGPSMeasurement(int pose_id, const transform_t &gps_tf) {
-  pose_t gps = toPose(gps_tf, 0); // heading doesn't matter
-  _graph.add(new OdomFactor2D(poseIdx(pose_id), -1, _gps_cov_inv, gps));
+template <typename Traits>
+pose_t FriendlyGraph<Traits>::getPoseEstimate(int pose_id) {
+  return Traits::toPose(stateEstimate(pose_id));
+}
+
+template <typename Traits>
+void FriendlyGraph<Traits>::addGPSMeasurement(int pose_id, const transform_t &gps_tf) {
+  pose_state gps = Traits::toState(gps_tf, 0); // heading doesn't matter
+  _graph.add(Traits::relativeFactor(poseIdx(pose_id), -1, _gps_cov_inv, gps));
 }
 
-void FriendlyGraph::addOdomMeasurement(int pose2_id, int pose1_id,
+template <typename Traits>
+void FriendlyGraph<Traits>::addOdomMeasurement(int pose2_id, int pose1_id,
     const transform_t &pose2_tf, const transform_t &pose1_tf) {
   transform_t rel_tf = pose2_tf * pose1_tf.inverse();
-  pose_t diff = toPose(rel_tf, 0.0);
-  float lin_dist = diff(0);
-  // Turning introduces more noise than going in a straight line
-  float ang_dist = ROBOT_WHEEL_BASE * diff(2) * 4;
-  float noise_distance_sq = lin_dist*lin_dist + ang_dist*ang_dist;
-  _graph.add(new OdomFactor2D(poseIdx(pose2_id), poseIdx(pose1_id),
+  pose_state diff = Traits::toState(rel_tf, 0.0);
+  double noise_distance_sq = Traits::odomNoiseDistanceSq(diff, ROBOT_WHEEL_BASE);
+  _graph.add(Traits::relativeFactor(poseIdx(pose2_id), poseIdx(pose1_id),
         _odom_cov_inv / noise_distance_sq, diff));
   pose_t pose1_est = getPoseEstimate(pose1_id);
-  transform_t new_pose_tf = rel_tf * toTransform(pose1_est);
-  pose_t pose2_est = toPose(new_pose_tf, pose1_est(2));
+  transform_t new_pose_tf = rel_tf * Traits::toTransform(stateEstimate(pose1_id));
+  pose_state pose2_est = Traits::toState(new_pose_tf, pose1_est(2));
   _current_guess.block(poseIdx(pose2_id),0,POSE_SIZE,1) = pose2_est;
+  _guessed_poses.insert(pose2_id);
+}
+
+template <typename Traits>
+bool FriendlyGraph<Traits>::addRelativePoseMeasurement(int pose2_id, int pose1_id,
+    const transform_t &rel_tf, const covariance<POSE_SIZE> &cov) {
+  if (pose1_id < _min_pose_id) return false;
+  _graph.add(Traits::relativeFactor(poseIdx(pose2_id), poseIdx(pose1_id),
+        cov.inverse(), Traits::toState(rel_tf, 0.0)));
+  return true;
+}
+
+template <typename Traits>
+void FriendlyGraph<Traits>::addLandmarkMeasurement(int pose_id, int lm_id, const point_t &bearing) {
+  poseIdx(pose_id); // registers the pose if it's new
+  landmarkIdx(lm_id);
+  _pending_obs.push_back({pose_id, lm_id, bearing.topRows(LM_SIZE)});
+}
+
+template <typename Traits>
+void FriendlyGraph<Traits>::setLandmarkSparsification(int max_factors_per_landmark,
+    double merge_xy_dist, double merge_theta_dist) {
+  _max_factors_per_landmark = max_factors_per_landmark;
+  _merge_xy_dist = merge_xy_dist;
+  _merge_theta_dist = merge_theta_dist;
+}
+
+template <typename Traits>
+int FriendlyGraph<Traits>::numLandmarkFactors(int lm_id) const {
+  return (int) _lm_obs[(size_t)lm_id].size();
+}
+
+// Fuses `bearing` (seen from pose_id) into an existing factor and re-anchors the factor
+// on pose_id, so that it survives trimming for as long as the newest observation does.
+// The old factor is moved into the new frame using the current pose estimates; this
+// ignores the uncertainty of the relative pose, which is negligible for poses close
+// enough to merge.
+template <typename Traits>
+void FriendlyGraph<Traits>::mergeLandmarkObservation(int lm_id, LandmarkObservation &obs,
+    int pose_id, const lm_state &bearing) {
+  transform_t rel_tf = Traits::toTransform(stateEstimate(pose_id)) *
+                       Traits::toTransform(stateEstimate(obs.pose_id)).inverse();
+  point_t p(0, 0, 1);
+  p.topRows(LM_SIZE) = obs.info.inverse() * obs.info_mean;
+  p = rel_tf * p;
+  covariance<LM_SIZE> rot = rel_tf.block(0, 0, LM_SIZE, LM_SIZE);
+  covariance<LM_SIZE> old_info = rot * obs.info * rot.transpose();
+
+  obs.pose_id = pose_id;
+  obs.info = old_info + _sensor_cov_inv;
+  obs.info_mean = old_info * p.topRows(LM_SIZE) + _sensor_cov_inv * bearing;
+
+  _graph.remove(obs.factor);
+  obs.factor = Traits::landmarkFactor(landmarkIdx(lm_id), nonincrementingPoseIdx(obs.pose_id),
+      obs.info, obs.info.inverse() * obs.info_mean);
+  _graph.add(obs.factor);
 }
 
-void FriendlyGraph::addLandmarkMeasurement(int pose_id, int lm_id, const point_t &bearing) {
-  measurement<2> lm = measurement<2> { bearing(0), bearing(1) };
-  _graph.add(new LandmarkFactor2D(landmarkIdx(lm_id), poseIdx(pose_id), _sensor_cov_inv, lm));
+// Runs before each solve. Merging compares pose estimates, so it only involves poses
+// that have a guess from odometry or a prior; the others just get a factor of their own.
+template <typename Traits>
+void FriendlyGraph<Traits>::sparsifyLandmarkObservations() {
+  for (const PendingObservation &pending : _pending_obs) {
+    if (pending.pose_id < _min_pose_id) continue; // already trimmed away
+    std::vector<LandmarkObservation> &lm_obs = _lm_obs[(size_t)pending.lm_id];
+    bool guessed = _guessed_poses.count(pending.pose_id) > 0;
+    pose_t pose = getPoseEstimate(pending.pose_id);
+
+    LandmarkObservation *nearest = nullptr;
+    double nearest_dist = 0.0;
+    for (LandmarkObservation &obs : lm_obs) {
+      if (!guessed || _guessed_poses.count(obs.pose_id) == 0) continue;
+      pose_t other = getPoseEstimate(obs.pose_id);
+      double xy_dist = (pose - other).topRows(2).norm();
+      double theta_dist = std::abs(nearestHeadingBranch(pose(2) - other(2), 0.0));
+      if (xy_dist <= _merge_xy_dist && theta_dist <= _merge_theta_dist &&
+          (nearest == nullptr || xy_dist < nearest_dist)) {
+        nearest = &obs;
+        nearest_dist = xy_dist;
+      }
+    }
+
+    if (nearest != nullptr) {
+      mergeLandmarkObservation(pending.lm_id, *nearest, pending.pose_id, pending.bearing);
+    } else if (_max_factors_per_landmark <= 0 ||
+               (int) lm_obs.size() < _max_factors_per_landmark) {
+      LandmarkObservation obs { pending.pose_id, _sensor_cov_inv,
+          _sensor_cov_inv * pending.bearing, nullptr };
+      obs.factor = Traits::landmarkFactor(landmarkIdx(pending.lm_id),
+          nonincrementingPoseIdx(pending.pose_id), _sensor_cov_inv, pending.bearing);
+      _graph.add(obs.factor);
+      lm_obs.push_back(obs);
+    }
+    // Otherwise the landmark is over budget and this observation is dropped
+  }
+  _pending_obs.clear();
 }
 
-void FriendlyGraph::addLandmarkPrior(int lm_id, point_t location, double xy_std) {
-  covariance<2> prior_cov = covariance<2>::Zero();
-  prior_cov << xy_std * xy_std, 0,
-               0, xy_std * xy_std;
-  covariance<2> prior_cov_inv = prior_cov.inverse();
-  measurement<2> lm = measurement<2> { location(0), location(1) };
-  _graph.add(new LandmarkFactor2D(landmarkIdx(lm_id), -1, prior_cov_inv, lm));
+template <typename Traits>
+void FriendlyGraph<Traits>::addLandmarkPrior(int lm_id, point_t location, double xy_std) {
+  covariance<LM_SIZE> prior_cov = covariance<LM_SIZE>::Identity() * xy_std * xy_std;
+  covariance<LM_SIZE> prior_cov_inv = prior_cov.inverse();
+  lm_state lm = location.topRows(LM_SIZE);
+  _graph.add(Traits::landmarkFactor(landmarkIdx(lm_id), -1, prior_cov_inv, lm));
   _current_guess.block(landmarkIdx(lm_id),0,LM_SIZE,1) = lm;
 }
 
-void FriendlyGraph::addPosePrior(int pose_id, const transform_t &pose_tf, covariance<3> &cov) {
-  covariance<3> prior_cov_inv = cov.inverse();
-  pose_t pose = toPose(pose_tf, 0);
-  _graph.add(new OdomFactor2D(poseIdx(pose_id), -1, prior_cov_inv, pose));
+template <typename Traits>
+void FriendlyGraph<Traits>::addPosePrior(int pose_id, const transform_t &pose_tf,
+    const covariance<POSE_SIZE> &cov) {
+  covariance<POSE_SIZE> prior_cov_inv = cov.inverse();
+  pose_state pose = Traits::toState(pose_tf, 0);
+  _graph.add(Traits::relativeFactor(poseIdx(pose_id), -1, prior_cov_inv, pose));
   _current_guess.block(poseIdx(pose_id),0,POSE_SIZE,1) = pose;
+  _guessed_poses.insert(pose_id);
 }
 
 // Guarantee: after solve(), _graph.solution() == _current_guess
-void FriendlyGraph::solve() {
+template <typename Traits>
+void FriendlyGraph<Traits>::solve() {
+  sparsifyLandmarkObservations();
   trimToMaxNumPoses();
   _graph.solve(_current_guess);
   _current_guess = _graph.solution();
 }
 
-points_t FriendlyGraph::getLandmarkLocations() {
+template <typename Traits>
+points_t FriendlyGraph<Traits>::getLandmarkLocations() {
   points_t lms({});
   for (int i = 0; i < _num_landmarks*LM_SIZE; i += LM_SIZE) {
     point_t lm ({0, 0, 1});
@@ -155,20 +271,192 @@ points_t FriendlyGraph::getLandmarkLocations() {
   return lms;
 }
 
-trajectory_t FriendlyGraph::getSmoothedTrajectory() {
+template <typename Traits>
+trajectory_t FriendlyGraph<Traits>::getSmoothedTrajectory() {
   const values &x = _current_guess;
   trajectory_t tfs({});
   for (int i = poseIdx(_min_pose_id); i < nonincrementingPoseIdx(_max_pose_id); i += POSE_SIZE) {
-    if (POSE_SIZE == 3) { // 2D
-      tfs.push_back(toTransformRotateFirst(0, 0, x(i+2)) * toTransformRotateFirst(x(i), x(i+1), 0));
-    } else { // 1D
-      tfs.push_back(toTransformRotateFirst(x(i), 0, 0));
-    }
+    tfs.push_back(Traits::toTransform(x.block(i, 0, POSE_SIZE, 1)));
   }
   return tfs;
 }
 
-int FriendlyGraph::getMaxNumPoses() const {
+template <typename Traits>
+int FriendlyGraph<Traits>::getMaxNumPoses() const {
   return _max_num_poses;
 }
 
+
+template <typename Traits>
+std::string FriendlyGraph<Traits>::checkpoint() const {
+  BlobWriter out;
+  out.write(CHECKPOINT_MAGIC);
+  out.write(CHECKPOINT_VERSION);
+  out.write<int32_t>(_num_landmarks);
+  out.write<int32_t>(_max_pose_id);
+  out.write<int32_t>(_min_pose_id);
+  out.write<int32_t>(_max_num_poses);
+  out.writeMatrix(_current_guess);
+  out.writeMatrix(_odom_cov_inv);
+  out.writeMatrix(_sensor_cov_inv);
+  out.writeMatrix(_gps_cov_inv);
+
+  out.write<int32_t>(_max_factors_per_landmark);
+  out.write(_merge_xy_dist);
+  out.write(_merge_theta_dist);
+  out.write<uint32_t>((uint32_t) _guessed_poses.size());
+  for (int pose_id : _guessed_poses) out.write<int32_t>(pose_id);
+  out.write<uint32_t>((uint32_t) _pending_obs.size());
+  for (const PendingObservation &pending : _pending_obs) {
+    out.write<int32_t>(pending.pose_id);
+    out.write<int32_t>(pending.lm_id);
+    out.writeMatrix(pending.bearing);
+  }
+  // Merged landmark factors are referred to by their position in the graph
+  const std::vector<AbstractFactor *> &factors = _graph.factors();
+  for (const auto &lm_obs : _lm_obs) {
+    out.write<uint32_t>((uint32_t) lm_obs.size());
+    for (const LandmarkObservation &obs : lm_obs) {
+      out.write<int32_t>(obs.pose_id);
+      out.writeMatrix(obs.info);
+      out.writeMatrix(obs.info_mean);
+      out.write<uint32_t>((uint32_t) (std::find(factors.begin(), factors.end(), obs.factor) -
+                                      factors.begin()));
+    }
+  }
+
+  _graph.serialize(out);
+  return out.data();
+}
+
+template <typename Traits>
+bool FriendlyGraph<Traits>::restore(const std::string &blob) {
+  // Everything is parsed into locals and only swapped in once the whole blob checks out
+  BlobReader in(blob);
+  uint32_t magic = 0, version = 0;
+  if (!in.read(magic) || !in.read(version) ||
+      magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION) {
+    printf("Error: not a FriendlyGraph checkpoint (or wrong version)\n");
+    return false;
+  }
+  int32_t num_landmarks = 0, max_pose_id = 0, min_pose_id = 0, max_num_poses = 0;
+  values current_guess;
+  covariance<POSE_SIZE> odom_cov_inv, gps_cov_inv;
+  covariance<LM_SIZE> sensor_cov_inv;
+  in.read(num_landmarks);
+  in.read(max_pose_id);
+  in.read(min_pose_id);
+  in.read(max_num_poses);
+  in.readMatrix(current_guess);
+  in.readMatrix(odom_cov_inv);
+  in.readMatrix(sensor_cov_inv);
+  in.readMatrix(gps_cov_inv);
+  bool ok = in.ok() && num_landmarks >= 0 && max_num_poses > 0 && min_pose_id >= 0 &&
+      min_pose_id <= max_pose_id &&
+      current_guess.size() == (int64_t) num_landmarks * LM_SIZE +
+                              (int64_t) (max_pose_id - min_pose_id) * POSE_SIZE;
+
+  int32_t max_factors_per_landmark = 0;
+  double merge_xy_dist = 0.0, merge_theta_dist = 0.0;
+  uint32_t num_guessed = 0, num_pending = 0;
+  in.read(max_factors_per_landmark);
+  in.read(merge_xy_dist);
+  in.read(merge_theta_dist);
+  in.read(num_guessed);
+  std::set<int> guessed_poses;
+  for (uint32_t i = 0; i < num_guessed && in.ok() && ok; i++) {
+    int32_t pose_id = 0;
+    in.read(pose_id);
+    guessed_poses.insert(pose_id);
+  }
+  in.read(num_pending);
+  std::vector<PendingObservation> pending_obs;
+  for (uint32_t i = 0; i < num_pending && in.ok() && ok; i++) {
+    int32_t pose_id = 0, lm_id = 0;
+    lm_state bearing;
+    in.read(pose_id);
+    in.read(lm_id);
+    in.readMatrix(bearing);
+    ok = lm_id >= 0 && lm_id < num_landmarks && pose_id <= max_pose_id;
+    pending_obs.push_back({pose_id, lm_id, bearing});
+  }
+  std::vector<std::vector<LandmarkObservation>> lm_obs(ok ? (size_t) num_landmarks : 0);
+  std::vector<std::vector<uint32_t>> factor_idxs(lm_obs.size());
+  for (size_t l = 0; l < lm_obs.size() && in.ok(); l++) {
+    uint32_t num_obs = 0;
+    in.read(num_obs);
+    for (uint32_t i = 0; i < num_obs && in.ok(); i++) {
+      LandmarkObservation obs { 0, covariance<LM_SIZE>(), lm_state(), nullptr };
+      int32_t pose_id = 0;
+      uint32_t factor_idx = 0;
+      in.read(pose_id);
+      in.readMatrix(obs.info);
+      in.readMatrix(obs.info_mean);
+      in.read(factor_idx);
+      obs.pose_id = pose_id;
+      lm_obs[l].push_back(obs);
+      factor_idxs[l].push_back(factor_idx);
+    }
+  }
+
+  Graph graph;
+  if (!ok || !in.ok() || !graph.deserialize(in) || !in.atEnd()) {
+    printf("Error: truncated or corrupt FriendlyGraph checkpoint\n");
+    return false;
+  }
+  const std::vector<AbstractFactor *> &factors = graph.factors();
+  for (size_t l = 0; l < lm_obs.size(); l++) {
+    for (size_t i = 0; i < lm_obs[l].size(); i++) {
+      if (factor_idxs[l][i] >= factors.size()) {
+        printf("Error: corrupt FriendlyGraph checkpoint\n");
+        return false;
+      }
+      lm_obs[l][i].factor = factors[factor_idxs[l][i]];
+    }
+  }
+
+  _num_landmarks = num_landmarks;
+  _max_pose_id = max_pose_id;
+  _min_pose_id = min_pose_id;
+  _max_num_poses = max_num_poses;
+  _current_guess = current_guess;
+  _odom_cov_inv = odom_cov_inv;
+  _sensor_cov_inv = sensor_cov_inv;
+  _gps_cov_inv = gps_cov_inv;
+  _max_factors_per_landmark = max_factors_per_landmark;
+  _merge_xy_dist = merge_xy_dist;
+  _merge_theta_dist = merge_theta_dist;
+  _guessed_poses.swap(guessed_poses);
+  _pending_obs.swap(pending_obs);
+  _lm_obs.swap(lm_obs);
+  _graph.swap(graph);
+  return true;
+}
+
+template <typename Traits>
+std::future<bool> FriendlyGraph<Traits>::writeCheckpoint(const std::string &path) const {
+  std::string blob = checkpoint();
+  return std::async(std::launch::async, [path](std::string data) {
+    std::string tmp_path = path + ".tmp";
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), (std::streamsize) data.size());
+    file.close();
+    if (!file) return false;
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+  }, std::move(blob));
+}
+
+template <typename Traits>
+bool FriendlyGraph<Traits>::restoreFromFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    printf("Error: could not open checkpoint %s\n", path.c_str());
+    return false;
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return restore(contents.str());
+}
+
+template class FriendlyGraph<Planar2D>;
+template class FriendlyGraph<Linear1D>;
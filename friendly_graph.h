@@ -4,18 +4,52 @@
 #include "graph.h"
 #include "factors.h"
 #include "utils.h"
+#include "state_space.h"
+#include <future>
+#include <set>
+#include <string>
 
+/* Traits fixes the dimension of poses and landmarks at compile time;
+ * see state_space.h. Planar2D and Linear1D are instantiated in friendly_graph.cpp. */
+template <typename Traits>
 class FriendlyGraph {
+public:
+  static constexpr int POSE_SIZE = Traits::POSE_SIZE;
+  static constexpr int LM_SIZE = Traits::LM_SIZE;
+  using pose_state = measurement<POSE_SIZE>;
+  using lm_state = measurement<LM_SIZE>;
+
 private:
+  // A landmark factor in the graph, possibly the fusion of several observations
+  // taken from nearby poses. Everything is expressed in the frame of `pose_id`.
+  struct LandmarkObservation {
+    int pose_id;
+    covariance<LM_SIZE> info;
+    lm_state info_mean; // info * (fused measurement)
+    AbstractFactor *factor;
+  };
+  struct PendingObservation {
+    int pose_id;
+    int lm_id;
+    lm_state bearing;
+  };
+
   int _num_landmarks;
   int _max_pose_id;
   int _min_pose_id;
   int _max_num_poses;
   values _current_guess;
 
-  covariance<3> _odom_cov_inv;
-  covariance<2> _sensor_cov_inv;
-  covariance<3> _gps_cov_inv;
+  covariance<POSE_SIZE> _odom_cov_inv;
+  covariance<LM_SIZE> _sensor_cov_inv;
+  covariance<POSE_SIZE> _gps_cov_inv;
+
+  std::set<int> _guessed_poses; // ids of poses with a guess from odometry or a prior
+  std::vector<PendingObservation> _pending_obs;
+  std::vector<std::vector<LandmarkObservation>> _lm_obs; // indexed by landmark id
+  int _max_factors_per_landmark;
+  double _merge_xy_dist;
+  double _merge_theta_dist;
 
   int nonincrementingPoseIdx(int pose_id);
   int poseIdx(int pose_id);
@@ -23,6 +57,10 @@ private:
   int numPoses();
   void incrementNumPoses();
   void trimToMaxNumPoses();
+  pose_state stateEstimate(int pose_id);
+  void sparsifyLandmarkObservations();
+  void mergeLandmarkObservation(int lm_id, LandmarkObservation &obs,
+      int pose_id, const lm_state &bearing);
 
 public:
   Graph _graph;
@@ -50,10 +88,28 @@ public:
   void addGPSMeasurement(int pose_id, const transform_t &gps_tf);
   void addOdomMeasurement(int pose2_id, int pose1_id,
     const transform_t &pose2_tf, const transform_t &pose1_tf);
+  /* A measured relative transform pose2_tf * pose1_tf^-1 with the covariance of its
+   * state (e.g. from scan matching). pose1 may be any earlier pose; returns false
+   * (and adds nothing) if it has already been trimmed from the window. */
+  bool addRelativePoseMeasurement(int pose2_id, int pose1_id,
+    const transform_t &rel_tf, const covariance<POSE_SIZE> &cov);
   void addLandmarkMeasurement(int pose_id, int lm_id, const point_t &bearing);
   void addLandmarkPrior(int lm_id, point_t location, double xy_std);
-  void addPosePrior(int pose_id, const transform_t &pose_tf, covariance<3> &cov);
+  void addPosePrior(int pose_id, const transform_t &pose_tf, const covariance<POSE_SIZE> &cov);
+
+  /* Landmark measurements are buffered and added to the graph at the next `solve()`.
+   * A measurement taken within (merge_xy_dist, merge_theta_dist) of a pose that already
+   * has a factor for the same landmark is fused into that factor instead of adding
+   * a new one (the information matrices add up, so nothing is lost while the robot
+   * sits still). Once a landmark has `max_factors_per_landmark` factors in the window,
+   * further measurements that can't be merged are dropped. 0 means no budget.
+   * By default nothing is merged (negative distances) and there is no budget; e.g.
+   * (0, 0.05 * ROBOT_LENGTH, 0.05) merges what a robot standing still sees. */
+  void setLandmarkSparsification(int max_factors_per_landmark,
+      double merge_xy_dist, double merge_theta_dist);
+  int numLandmarkFactors(int lm_id) const;
 
+  /* Estimate of a pose in the window, padded out to (x, y, theta) for 1D graphs. */
   pose_t getPoseEstimate(int pose_id);
   void solve();
   points_t getLandmarkLocations();
@@ -63,6 +119,20 @@ public:
   trajectory_t getSmoothedTrajectory();
   int getMaxNumPoses() const;
 
+  /* Serializes the complete estimator state (current guess, active factors, window
+   * bounds and noise models) into a binary blob. This only copies memory, so it is
+   * cheap enough to call between solves. */
+  std::string checkpoint() const;
+  /* Replaces the state of this graph with a checkpoint, recomputing the last solution's
+   * covariance. The next `solve()` starts from the checkpointed guess. Returns false
+   * (leaving the graph as it was) if the blob is not a valid checkpoint. */
+  bool restore(const std::string &blob);
+  /* Takes a checkpoint now and writes it to `path` on a background thread, so the caller
+   * can keep adding measurements. The file is replaced atomically. The future
+   * reports whether the write succeeded. */
+  std::future<bool> writeCheckpoint(const std::string &path) const;
+  bool restoreFromFile(const std::string &path);
+
 };
 
 #endif
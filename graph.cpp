@@ -1,25 +1,78 @@
 
 #include "graph.h"
+#include "factors.h"
+#include "cholesky.h"
+#include "parallel.h"
+#include <cassert>
+#include <cmath>
 #include <iostream>
 #include <Eigen/Core>
 #include <Eigen/LU>
+#include <algorithm>
+#include <utility>
 #include <vector>
 
 AbstractFactor::~AbstractFactor() {}
 
 Graph::Graph() : _x0(values::Zero(1)), _sol(values::Zero(1)), _sol_cov(hessian::Zero(1,1)),
-    _factors({}) {}
+    _factors({}), _num_elim_landmarks(0), _lm_size(2),
+    _relin_threshold(0.0), _linear_solver(LinearSolver::LU), _verbose(true),
+    _num_linearizations(0), _cholesky(new SupernodalCholesky()) {}
 
 Graph::~Graph() {
   for (auto f : _factors) {
-    free(f);
+    delete f;
   }
 }
 
+void Graph::eliminateLandmarks(int numLandmarks, int landmarkSize) {
+  _num_elim_landmarks = numLandmarks;
+  _lm_size = landmarkSize;
+  for (auto f : _factors)
+    assert("landmarks must not be connected to each other" && !linksLandmarks(f));
+}
+
+// Whether the factor touches two different eliminated landmarks. Checked as factors
+// come in, so that schurStep can rely on Hll being block-diagonal.
+bool Graph::linksLandmarks(const AbstractFactor *f) const {
+  int L = _num_elim_landmarks * _lm_size, landmark = -1;
+  for (int k : f->indices()) {
+    if (k < 0 || k >= L) continue;
+    if (landmark >= 0 && k / _lm_size != landmark) return true;
+    landmark = k / _lm_size;
+  }
+  return false;
+}
+
+void Graph::setRelinearizeThreshold(double threshold) {
+  _relin_threshold = threshold;
+}
+
+void Graph::setLinearSolver(LinearSolver solver) {
+  _linear_solver = solver;
+}
+
+void Graph::setVerbose(bool verbose) {
+  _verbose = verbose;
+}
+
+int Graph::numLinearizations() const {
+  return _num_linearizations;
+}
+
 void Graph::add(AbstractFactor *f) {
+  assert("landmarks must not be connected to each other" && !linksLandmarks(f));
   _factors.push_back(f);
 }
 
+void Graph::remove(AbstractFactor *f) {
+  auto it = std::find(_factors.begin(), _factors.end(), f);
+  if (it != _factors.end()) {
+    delete *it;
+    _factors.erase(it);
+  }
+}
+
 double Graph::eval(const values &x) {
   double sum = 0.0;
   for (auto f : _factors)
@@ -27,39 +80,172 @@ double Graph::eval(const values &x) {
   return sum;
 }
 
+void Graph::linearize(AbstractFactor *f, const values &x, Linearization &lin) {
+  lin.idx = f->indices();
+  lin.x_lin.resize((int) lin.idx.size());
+  for (size_t k = 0; k < lin.idx.size(); k++)
+    lin.x_lin((int) k) = x(lin.idx[k]);
+  f->linearize(x, lin.grad, lin.hess);
+}
+
+// Largest change of any of the factor's variables since it was linearized
+double Graph::linearizationDelta(const Linearization &lin, const values &x) {
+  double max_delta = 0.0;
+  for (size_t k = 0; k < lin.idx.size(); k++)
+    max_delta = std::max(max_delta, std::abs(x(lin.idx[k]) - lin.x_lin((int) k)));
+  return max_delta;
+}
+
+// Adds sign * (the factor's linear model) to the assembled system. The linear model
+// of a factor linearized at x_lin has gradient g + H (x - x_lin) at x, so
+// b collects g - H x_lin and the full gradient is b + hess * x.
+void Graph::accumulate(const Linearization &lin, double sign, values &b, hessian &hess) {
+  values b_f = lin.grad - lin.hess * lin.x_lin;
+  int n = (int) lin.idx.size();
+  for (int r = 0; r < n; r++) {
+    b(lin.idx[(size_t)r]) += sign * b_f(r);
+    for (int c = 0; c < n; c++)
+      hess(lin.idx[(size_t)r], lin.idx[(size_t)c]) += sign * lin.hess(r, c);
+  }
+}
+
 void Graph::solve(const values &x0, double alpha, int maxiters, double tol) {
   _x0 = x0;
   values x = x0;
   double error = 2*tol;
   int i = 0;
   int N = x0.size();
+  std::vector<Linearization> cache(_factors.size());
+  _num_linearizations = 0;
+  values b = values::Zero(N);
+  hessian lin_hess = hessian::Zero(N,N);
   while (error > tol && i < maxiters) {
-    values grad = values::Zero(N);
-    hessian hess = hessian::Zero(N,N);
-    for (auto f : _factors) {
-      grad += f->gradient_at(x);
-      hess += f->hessian_at(x);
+    std::vector<size_t> stale;
+    for (size_t k = 0; k < _factors.size(); k++) {
+      if (i == 0 || linearizationDelta(cache[k], x) > _relin_threshold) stale.push_back(k);
     }
+    _num_linearizations += (int) stale.size();
+    if (2 * stale.size() > _factors.size()) {
+      // Mostly stale: rebuild from scratch, which also flushes any rounding
+      // error from patching the system in place
+      b.setZero();
+      lin_hess.setZero();
+      for (size_t k : stale)
+        linearize(_factors[k], x, cache[k]);
+      for (const Linearization &lin : cache)
+        accumulate(lin, 1.0, b, lin_hess);
+    } else {
+      for (size_t k : stale) {
+        accumulate(cache[k], -1.0, b, lin_hess);
+        linearize(_factors[k], x, cache[k]);
+        accumulate(cache[k], 1.0, b, lin_hess);
+      }
+    }
+    values grad = b + lin_hess * x;
+    hessian hess = lin_hess;
     for (int j = 0; j < N; j++) {
       // Presumably we have no factors affecting this variable
       if (hess(j,j) == 0) hess(j,j) = 0.001; // avoid singular matrix
     }
-    x -= alpha * (hess.inverse() * grad);
+    x -= alpha * newtonStep(hess, grad);
     error = sqrt(grad.transpose() * grad);
     i += 1;
-    if (i%100 == 0)
+    if (_verbose && i%100 == 0)
       std::cout << "Iteration " << i << ": " << error << std::endl;
   }
-  std::cout << "MAP took " << i << " iterations." << std::endl;
+  if (_verbose) std::cout << "MAP took " << i << " iterations." << std::endl;
   _sol = x;
+  computeCovariance();
+}
 
+// Covariance of the solution: the inverse of the Hessian at _sol. Factors added since
+// the last solve that involve new variables are left out.
+void Graph::computeCovariance() {
+  int N = _sol.size();
   hessian hess = hessian::Zero(N,N);
-  for (auto f : _factors)
-    hess += f->hessian_at(_sol);
+  values b = values::Zero(N);
+  for (auto f : _factors) {
+    std::vector<int> idx = f->indices();
+    if (std::any_of(idx.begin(), idx.end(), [N](int k) { return k < 0 || k >= N; })) continue;
+    Linearization lin;
+    linearize(f, _sol, lin);
+    accumulate(lin, 1.0, b, hess);
+  }
   for (int j = 0; j < N; j++) {
     if (hess(j,j) == 0) hess(j,j) = 0.001; // Again, avoid singular matrix
   }
-  _sol_cov = hess.inverse();
+  _sol_cov = (_num_elim_landmarks > 0) ? schurCovariance(hess) : invert(hess);
+}
+
+values Graph::newtonStep(const hessian &hess, const values &grad) {
+  if (_num_elim_landmarks > 0) return schurStep(hess, grad);
+  return solveLinear(hess, grad);
+}
+
+values Graph::solveLinear(const hessian &A, const values &b) {
+  if (_linear_solver == LinearSolver::Cholesky && _cholesky->compute(A))
+    return _cholesky->solve(b);
+  return A.inverse() * b;
+}
+
+hessian Graph::invert(const hessian &A) {
+  if (_linear_solver == LinearSolver::Cholesky && _cholesky->compute(A))
+    return _cholesky->inverse();
+  return A.inverse();
+}
+
+// Partition the system as [ Hll Hlp ; Hpl Hpp ] with landmarks first. Hll is
+// block-diagonal, so Hll^-1 costs one small inverse per landmark and the
+// landmarks can be eliminated independently of each other.
+values Graph::schurStep(const hessian &hess, const values &grad) {
+  int N = hess.rows();
+  int L = _num_elim_landmarks * _lm_size;
+  int P = N - L;
+  assert("landmarks must fit in the state vector" && L <= N);
+
+  // Y = Hll^-1 Hlp and z = Hll^-1 gl, one landmark block row at a time
+  hessian Y(L, P);
+  values z(L);
+  parallelFor(_num_elim_landmarks, [&](int l) {
+    int i = l * _lm_size;
+    hessian block_inv = hess.block(i, i, _lm_size, _lm_size).inverse();
+    Y.block(i, 0, _lm_size, P) = block_inv * hess.block(i, L, _lm_size, P);
+    z.segment(i, _lm_size) = block_inv * grad.segment(i, _lm_size);
+  });
+
+  // Reduced pose system: (Hpp - Hpl Hll^-1 Hlp) dp = gp - Hpl Hll^-1 gl
+  hessian S = hess.bottomRightCorner(P, P) - hess.block(L, 0, P, L) * Y;
+  values b = grad.tail(P) - hess.block(L, 0, P, L) * z;
+
+  values step(N);
+  step.tail(P) = solveLinear(S, b);
+  step.head(L) = z - Y * step.tail(P);
+  return step;
+}
+
+// The full inverse in terms of the same partition:
+//   Cov_pp = S^-1,  Cov_lp = -Y S^-1,  Cov_ll = Hll^-1 + Y S^-1 Y^T
+hessian Graph::schurCovariance(const hessian &hess) {
+  int N = hess.rows();
+  int L = _num_elim_landmarks * _lm_size;
+  int P = N - L;
+
+  hessian Y(L, P);
+  hessian cov = hessian::Zero(N, N);
+  parallelFor(_num_elim_landmarks, [&](int l) {
+    int i = l * _lm_size;
+    hessian block_inv = hess.block(i, i, _lm_size, _lm_size).inverse();
+    Y.block(i, 0, _lm_size, P) = block_inv * hess.block(i, L, _lm_size, P);
+    cov.block(i, i, _lm_size, _lm_size) = block_inv;
+  });
+
+  hessian S = hess.bottomRightCorner(P, P) - hess.block(L, 0, P, L) * Y;
+  hessian S_inv = invert(S);
+  cov.bottomRightCorner(P, P) = S_inv;
+  cov.block(0, L, L, P) = -Y * S_inv;
+  cov.block(L, 0, P, L) = cov.block(0, L, L, P).transpose();
+  cov.topLeftCorner(L, L) += Y * S_inv * Y.transpose();
+  return cov;
 }
 
 values Graph::x0() {
@@ -78,10 +264,72 @@ void Graph::shiftIndices(int poseSize, int firstPoseIdx) {
   auto it = _factors.begin();
   while (it != _factors.end()) {
     if (!(*it)->shiftIndices(poseSize, firstPoseIdx)) {
-      free(*it);
+      delete *it;
       it = _factors.erase(it);
     } else {
       ++it;
     }
   }
 }
+
+const std::vector<AbstractFactor *> &Graph::factors() const {
+  return _factors;
+}
+
+void Graph::serialize(BlobWriter &out) const {
+  out.writeMatrix(_x0);
+  out.writeMatrix(_sol);
+  out.write<int32_t>(_num_elim_landmarks);
+  out.write<int32_t>(_lm_size);
+  out.write(_relin_threshold);
+  out.write(_linear_solver);
+  out.write<uint32_t>((uint32_t) _factors.size());
+  for (auto f : _factors)
+    f->serialize(out);
+}
+
+bool Graph::deserialize(BlobReader &in) {
+  // Parsed into a scratch graph, so that a bad blob leaves this one as it was
+  Graph parsed;
+  int32_t num_elim_landmarks = 0, lm_size = 0;
+  uint8_t solver = 0;
+  uint32_t num_factors = 0;
+  in.readMatrix(parsed._x0);
+  in.readMatrix(parsed._sol);
+  in.read(num_elim_landmarks);
+  in.read(lm_size);
+  in.read(parsed._relin_threshold);
+  in.read(solver);
+  in.read(num_factors);
+  if (!in.ok() || lm_size <= 0 || num_elim_landmarks < 0 ||
+      (int64_t) num_elim_landmarks * lm_size > parsed._x0.size() ||
+      parsed._x0.size() != parsed._sol.size() || solver > (uint8_t) LinearSolver::Cholesky)
+    return false;
+  parsed._num_elim_landmarks = num_elim_landmarks;
+  parsed._lm_size = lm_size;
+  parsed._linear_solver = LinearSolver(solver);
+  for (uint32_t i = 0; i < num_factors && in.ok(); i++) {
+    AbstractFactor *f = deserializeFactor(in);
+    if (f == nullptr) return false;
+    parsed._factors.push_back(f);
+    if (parsed.linksLandmarks(f)) return false;
+  }
+  if (!in.ok()) return false;
+  // The covariance isn't stored: it is dense, and bigger than the rest put together
+  parsed.computeCovariance();
+  swap(parsed);
+  return true;
+}
+
+void Graph::swap(Graph &other) {
+  std::swap(_x0, other._x0);
+  std::swap(_sol, other._sol);
+  std::swap(_sol_cov, other._sol_cov);
+  std::swap(_factors, other._factors);
+  std::swap(_num_elim_landmarks, other._num_elim_landmarks);
+  std::swap(_lm_size, other._lm_size);
+  std::swap(_relin_threshold, other._relin_threshold);
+  std::swap(_linear_solver, other._linear_solver);
+  std::swap(_num_linearizations, other._num_linearizations);
+  std::swap(_cholesky, other._cholesky);
+}
@@ -3,7 +3,9 @@
 #define GRAPH_H
 
 #include <Eigen/Core>
+#include <memory>
 #include <vector>
+#include "serialization.h"
 
 using values = Eigen::Matrix<double, Eigen::Dynamic, 1>;
 using hessian = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>;
@@ -14,19 +16,65 @@ public:
   virtual double eval(const values &/*x*/) = 0;
   virtual values gradient_at(const values &/*x*/) = 0;
   virtual hessian hessian_at(const values &/*x*/) = 0;
+  // The variables this factor depends on.
+  virtual std::vector<int> indices() const = 0;
+  // Gradient and Hessian at x restricted to indices() (in that order).
+  virtual void linearize(const values &/*x*/, values &/*grad*/, hessian &/*hess*/) = 0;
   // Used to handle graph trimming so graph size does not grow arbitrarily.
   // Shifts all factor indices related to robot poses down by `poseSize`. If this
   // moves the index outside the range used for poses, return false.
   // If this returns false, the factor should be removed from the graph.
   virtual bool shiftIndices(int poseSize, int firstPoseIdx) = 0;
+  // Writes a type tag followed by everything needed to rebuild the factor
+  // (see deserializeFactor in factors.h).
+  virtual void serialize(BlobWriter &out) const = 0;
 };
 
+// A factor's gradient and Hessian at some linearization point, restricted to the
+// factor's own variables. solve() keeps one per factor between iterations.
+struct Linearization {
+  Linearization() : idx(), x_lin(), grad(), hess() {}
+  std::vector<int> idx;
+  values x_lin;
+  values grad;
+  hessian hess;
+};
+
+// How Graph factors the (full or landmark-reduced) Newton system
+enum class LinearSolver : uint8_t {
+  LU = 0,
+  // SupernodalCholesky (cholesky.h); falls back to LU if the system is not
+  // positive definite
+  Cholesky = 1,
+};
+
+class SupernodalCholesky;
+
 class Graph {
 private:
   values _x0;
   values _sol;
   hessian _sol_cov;
   std::vector<AbstractFactor *> _factors;
+  int _num_elim_landmarks;
+  int _lm_size;
+  double _relin_threshold;
+  LinearSolver _linear_solver;
+  bool _verbose;
+  int _num_linearizations;
+  // Kept between Newton steps so that its symbolic analysis is reused
+  std::unique_ptr<SupernodalCholesky> _cholesky;
+
+  values newtonStep(const hessian &hess, const values &grad);
+  values schurStep(const hessian &hess, const values &grad);
+  hessian schurCovariance(const hessian &hess);
+  values solveLinear(const hessian &A, const values &b);
+  hessian invert(const hessian &A);
+  void computeCovariance();
+  bool linksLandmarks(const AbstractFactor *f) const;
+  void linearize(AbstractFactor *f, const values &x, Linearization &lin);
+  double linearizationDelta(const Linearization &lin, const values &x);
+  void accumulate(const Linearization &lin, double sign, values &b, hessian &hess);
 
 public:
   Graph();
@@ -34,12 +82,48 @@ public:
   ~Graph();
 
   void add(AbstractFactor *f);
+  // Removes (and deletes) a factor previously passed to add().
+  void remove(AbstractFactor *f);
   double eval(const values &x);
   void solve(const values &x0, double alpha=1.0, int maxiters=1000, double tol=1e-10);
+  // Switches solve() to eliminate landmark variables before factoring.
+  // The landmarks must occupy the first `numLandmarks * landmarkSize` entries of the
+  // state vector and must never share a factor with each other (as in FriendlyGraph),
+  // so that their block of the Hessian is block-diagonal (asserted here and in add()).
+  // Each landmark is then eliminated with a small Schur complement, only the reduced
+  // pose system is factored, and the landmark updates are recovered by back-substitution.
+  // Pass numLandmarks = 0 to go back to factoring the full system.
+  void eliminateLandmarks(int numLandmarks, int landmarkSize=2);
+  // Lazy relinearization: within a solve(), a factor is only re-evaluated once one of
+  // its variables has moved more than `threshold` since it was last linearized.
+  // Otherwise its cached linearization is reused (its gradient is extrapolated
+  // with the cached Hessian), and relinearized factors are patched into the
+  // assembled system in place. The solution is exact up to the effect of moves
+  // smaller than `threshold`; the default of 0 relinearizes everything that moved.
+  void setRelinearizeThreshold(double threshold);
+  // Defaults to LU. Cholesky exploits the sparsity of long pose windows and
+  // factors independent parts of the system on separate threads; for short
+  // windows (FriendlyGraph's 10 poses) LU is as fast.
+  void setLinearSolver(LinearSolver solver);
+  // Whether solve() reports its progress on stdout (the default). Not checkpointed.
+  void setVerbose(bool verbose);
+  // How many factor linearizations the iterations of the last solve() did
+  int numLinearizations() const;
   values x0();
   values solution();
   hessian covariance();
   void shiftIndices(int poseSize, int firstPoseIdx);
+
+  // Factors in the order they were added; used to refer to factors in checkpoints.
+  const std::vector<AbstractFactor *> &factors() const;
+  // Writes the factors and the last solution so that a graph restored with
+  // deserialize() is in the same state. The covariance is recomputed on restore.
+  void serialize(BlobWriter &out) const;
+  // Replaces the contents of this graph. Returns false, leaving the graph unchanged, if
+  // the blob is malformed.
+  bool deserialize(BlobReader &in);
+  // Exchanges everything but the verbose setting with `other`
+  void swap(Graph &other);
 };
 
 #endif
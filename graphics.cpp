@@ -20,11 +20,12 @@ sf::Vector2f MyWindow::toWindowFrame(const point_t &p) {
   return sf::Vector2f((p(0)-window_center_x_)*scale_x + offset_x, (p(1)-window_center_y_)*scale_y + offset_y);
 }
 
-MyWindow::MyWindow(const char *name) :
+MyWindow::MyWindow(const char *name, bool is_2d) :
   sf_window_(sf::VideoMode(DEFAULT_WINDOW_WIDTH_PX, DEFAULT_WINDOW_WIDTH_PX), name),
   window_width_(DEFAULT_WINDOW_WIDTH),
   window_center_x_(DEFAULT_WINDOW_CENTER_X),
-  window_center_y_(DEFAULT_WINDOW_CENTER_Y)
+  window_center_y_(DEFAULT_WINDOW_CENTER_Y),
+  is_2d_(is_2d)
 {
 }
 
@@ -71,9 +72,9 @@ void MyWindow::display() {
 double MyWindow::vertOffset(sf::Color c) {
   if (c.g > 0 && c.r == 0 && c.b == 0)
     return 0.0;
-  if (!IS_2D && c.r == c.b && c.r == c.g)
+  if (!is_2d_ && c.r == c.b && c.r == c.g)
     return -2*ROBOT_WHEEL_BASE;
-  if (!IS_2D)
+  if (!is_2d_)
     return +2*ROBOT_WHEEL_BASE;
   return 0.0;
 }
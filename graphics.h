@@ -6,7 +6,8 @@
 
 class MyWindow {
 public:
-  MyWindow(const char *name);
+  /* 1D visualizations offset each trajectory vertically so they don't overlap. */
+  MyWindow(const char *name, bool is_2d = true);
   void drawObstacles(const obstacles_t &obss);
   void drawTraj(const trajectory_t &traj, sf::Color c);
   void drawRobot(const transform_t &tf, sf::Color c);
@@ -20,6 +21,7 @@ private:
   double window_width_;
   double window_center_x_;
   double window_center_y_;
+  bool is_2d_;
 
   sf::Vector2f toWindowFrame(const point_t &p);
   sf::Vector2f toWindowFrame(const point_t &p, double vertOffset);
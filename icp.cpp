@@ -1,49 +1,58 @@
 
 #include "icp.h"
+#include "point_cloud.h"
+#include "parallel.h"
+#include <memory>
+#include <Eigen/Cholesky>
+#include <Eigen/LU>
 #include <Eigen/SVD>
 #include <iostream>
 
-transform_t do_icp(const points_t &cloud1, const points_t &cloud2) {
+transform_t do_icp(const points_t &cloud1, const points_t &cloud2,
+    double max_correspondence_dist) {
   transform_t tf = toTransform({0,0,0});
   int iters = 0;
-  size_t n = cloud1.size();
-  points_t tf_cloud1 = cloud1;
+  PointCloud src(cloud1), moved, dst(cloud2);
+  // Both trees are built once. tf is rigid, so the point of tf * cloud1 nearest to q
+  // is the point of cloud1 nearest to tf^-1 q.
+  KdTree2D tree1(cloud1), tree2(cloud2);
+  std::vector<std::pair<size_t, size_t>> pairs;
   // TODO use a smarter stopping criterion
   while (iters++ < 10) {
-    points_t closest1({}), closest2({});
-    std::vector<size_t> idxs1({}), idxs2({});
-    idxs1.resize(n);
-    idxs2.resize(n);
-    for (size_t i = 0; i < n; i++) {
-      double min_dist_1 = 100000;
-      for (size_t j = 0; j < n; j++) {
-        double dist = (tf_cloud1[i] - cloud2[j]).matrix().norm();
-        if (dist < min_dist_1) {
-          min_dist_1 = dist;
-          idxs1[i] = j;
-        }
-      }
-      double min_dist_2 = 100000;
-      for (size_t j = 0; j < n; j++) {
-        double dist = (tf_cloud1[j] - cloud2[i]).matrix().norm();
-        if (dist < min_dist_2) {
-          min_dist_2 = dist;
-          idxs2[i] = j;
-        }
-      }
-    }
-    for (size_t i = 0; i < n; i++) {
-      size_t j = idxs1[i];
-      if (idxs2[j] == i) {
+    transformCloud(tf, src, moved);
+    transform_t tf_inv = tf.inverse();
+    pairs.clear();
+    for (size_t i = 0; i < moved.size(); i++) {
+      if (!moved.valid(i)) continue;
+      int j = tree2.nearest(point_t(moved.x()[i], moved.y()[i], 1), max_correspondence_dist);
+      if (j == -1) continue;
+      if (tree1.nearest(tf_inv * cloud2[(size_t) j]) == (int) i) {
         // Mutually closest points
-        closest1.push_back(tf_cloud1[i]);
-        closest2.push_back(cloud2[j]);
+        pairs.push_back({i, (size_t) j});
       }
     }
-    transform_t next_tf = associated_closed_form(closest1, closest2);
-    for (size_t i = 0; i < n; i++) {
-      tf_cloud1[i] = next_tf * tf_cloud1[i];
+    if (pairs.empty()) break;
+
+    // Closed form alignment of the pairs (as in associated_closed_form). The
+    // centroids only count the matched points of each cloud.
+    moved.clearValid();
+    dst.clearValid();
+    for (const auto &pair : pairs) {
+      moved.setValid(pair.first, true);
+      dst.setValid(pair.second, true);
+    }
+    Eigen::Vector2d m1 = centroid(moved), m2 = centroid(dst);
+    Eigen::Matrix2d w = Eigen::Matrix2d::Zero();
+    for (const auto &pair : pairs) {
+      Eigen::Vector2d p1(moved.x()[pair.first] - m1(0), moved.y()[pair.first] - m1(1));
+      Eigen::Vector2d p2(dst.x()[pair.second] - m2(0), dst.y()[pair.second] - m2(1));
+      w += p1 * p2.transpose();
     }
+    Eigen::JacobiSVD<Eigen::Matrix2d> svd(w, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    Eigen::Matrix2d r = svd.matrixV() * svd.matrixU().transpose();
+    transform_t next_tf = transform_t::Identity();
+    next_tf.block(0,0,2,2) = r;
+    next_tf.block(0,2,2,1) = m2 - r * m1;
     tf = next_tf * tf;
   }
   return tf;
@@ -77,3 +86,112 @@ transform_t associated_closed_form(const points_t &cloud1, const points_t &cloud
   post_shift.block(0,2,2,1) = m2.topRows(2);
   return post_shift * tf_rot * pre_shift;
 }
+
+ICPTarget::ICPTarget(const points_t &scan, double max_neighbour_gap) : points(scan), tree(scan),
+    normals(scan.size(), Eigen::Vector2d::Zero()), has_normal(scan.size(), false) {
+  size_t n = scan.size();
+  auto neighbour = [&](size_t i, size_t j) {
+    return j < n && scan[j](2) != 0 && (scan[j] - scan[i]).norm() < max_neighbour_gap;
+  };
+  for (size_t i = 0; i < n; i++) {
+    if (scan[i](2) == 0) continue;
+    bool prev = i > 0 && neighbour(i, i - 1);
+    bool next = neighbour(i, i + 1);
+    if (!prev && !next) continue;
+    // The line through the neighbours on either side (or the one neighbour we have)
+    Eigen::Vector2d dir = (scan[next ? i + 1 : i] - scan[prev ? i - 1 : i]).head<2>();
+    if (dir.norm() == 0) continue;
+    normals[i] = Eigen::Vector2d(-dir(1), dir(0)).normalized();
+    has_normal[i] = true;
+  }
+}
+
+ICPResult point_to_line_icp(const points_t &source, const ICPTarget &target,
+    const transform_t &initial, const ICPParams &params) {
+  ICPResult result;
+  result.tf = initial;
+
+  while (result.iterations < params.max_iterations) {
+    result.iterations++;
+    Eigen::Matrix3d H = Eigen::Matrix3d::Zero();
+    Eigen::Vector3d g = Eigen::Vector3d::Zero();
+    double sq_error = 0;
+    int num_residuals = 0, num_inliers = 0;
+    for (const point_t &p : source) {
+      if (p(2) == 0) continue;
+      point_t q = result.tf * p;
+      int j = target.tree.nearest(q, params.max_correspondence_dist);
+      if (j == -1) continue;
+      num_inliers++;
+      Eigen::Vector2d diff = (q - target.points[(size_t) j]).head<2>();
+      // d q / d (x, y, theta) for a correction applied on the left of tf
+      Eigen::Matrix<double, 2, 3> J;
+      J << 1, 0, -q(1),
+           0, 1, q(0);
+      if (target.has_normal[(size_t) j]) {
+        const Eigen::Vector2d &n = target.normals[(size_t) j];
+        Eigen::RowVector3d Jn = n.transpose() * J;
+        double r = n.dot(diff);
+        H += Jn.transpose() * Jn;
+        g += Jn.transpose() * r;
+        sq_error += r * r;
+        num_residuals += 1;
+      } else {
+        H += J.transpose() * J;
+        g += J.transpose() * diff;
+        sq_error += diff.squaredNorm();
+        num_residuals += 2;
+      }
+    }
+    result.num_inliers = num_inliers;
+    result.hessian = H;
+    if (num_residuals < 3) break;
+    result.rms_error = sqrt(sq_error / num_residuals);
+    if (result.rms_error < params.min_rms_error) {
+      result.converged = true;
+      break;
+    }
+
+    Eigen::Vector3d delta = -H.ldlt().solve(g);
+    transform_t step;
+    step << cos(delta(2)), -sin(delta(2)), delta(0),
+            sin(delta(2)), cos(delta(2)), delta(1),
+            0, 0, 1;
+    result.tf = step * result.tf;
+    if (delta.head<2>().norm() < params.min_delta_translation &&
+        std::abs(delta(2)) < params.min_delta_rotation) {
+      result.converged = true;
+      break;
+    }
+  }
+  return result;
+}
+
+ICPResult point_to_line_icp(const points_t &source, const points_t &target,
+    const transform_t &initial, const ICPParams &params) {
+  return point_to_line_icp(source, ICPTarget(target, params.max_neighbour_gap), initial, params);
+}
+
+std::vector<ICPResult> point_to_line_icp_batch(const std::vector<points_t> &scans,
+    const std::vector<ScanPair> &pairs, const ICPParams &params) {
+  // Prepare every scan that is used as a target, once
+  std::vector<int> target_ids;
+  std::vector<bool> is_target(scans.size(), false);
+  for (const ScanPair &pair : pairs) {
+    if (!is_target[(size_t) pair.target]) target_ids.push_back(pair.target);
+    is_target[(size_t) pair.target] = true;
+  }
+  std::vector<std::unique_ptr<ICPTarget>> targets(scans.size());
+  parallelFor((int) target_ids.size(), [&](int k) {
+    size_t id = (size_t) target_ids[(size_t) k];
+    targets[id].reset(new ICPTarget(scans[id], params.max_neighbour_gap));
+  }, 1);
+
+  std::vector<ICPResult> results(pairs.size());
+  parallelFor((int) pairs.size(), [&](int k) {
+    const ScanPair &pair = pairs[(size_t) k];
+    results[(size_t) k] = point_to_line_icp(scans[(size_t) pair.source],
+        *targets[(size_t) pair.target], pair.initial, params);
+  }, 1);
+  return results;
+}
@@ -2,9 +2,75 @@
 #pragma once
 
 #include "utils.h"
+#include "kdtree.h"
+#include <cmath>
 
-transform_t do_icp(const points_t &cloud1, const points_t &cloud2);
+// Returns the transform that takes cloud1 -> cloud2, matching mutually nearest points.
+// Pairs further apart than max_correspondence_dist are not used.
+transform_t do_icp(const points_t &cloud1, const points_t &cloud2,
+    double max_correspondence_dist = INFINITY);
 
 // Returns the transform that takes cloud1 -> cloud2 (ie tf * p1 = p2)
 // Assumes points have already been associated (i.e. clouds are ordered)
 transform_t associated_closed_form(const points_t &cloud1, const points_t &cloud2);
+
+struct ICPParams {
+  int max_iterations = 30;
+  double max_correspondence_dist = 1.0;
+  // Stop once a step moves less than this (meters and radians)
+  double min_delta_translation = 1e-6;
+  double min_delta_rotation = 1e-6;
+  // Stop once the RMS residual is below this
+  double min_rms_error = 1e-6;
+  // Scan neighbours further apart than this are not used to estimate normals
+  double max_neighbour_gap = 0.5;
+};
+
+struct ICPResult {
+  ICPResult() : tf(transform_t::Identity()), iterations(0), rms_error(INFINITY), num_inliers(0),
+      converged(false), hessian(Eigen::Matrix3d::Zero()) {}
+
+  transform_t tf; // takes the source scan onto the target scan (tf * p1 = p2)
+  int iterations;
+  double rms_error; // RMS residual of the inlier correspondences
+  int num_inliers;
+  bool converged;
+  // Gauss-Newton Hessian J^T J of the residuals with respect to a small
+  // (x, y, theta) correction applied on the left of tf
+  Eigen::Matrix3d hessian;
+};
+
+/* A scan prepared as a point-to-line ICP target: a k-d tree over its points, and the
+ * normal of the line through each point's neighbours in scan order. Points with no
+ * close neighbours (e.g. landmarks) have no normal and are matched point-to-point.
+ * Build once and reuse when registering several scans against the same target. */
+class ICPTarget {
+public:
+  explicit ICPTarget(const points_t &scan, double max_neighbour_gap = ICPParams().max_neighbour_gap);
+
+  points_t points;
+  KdTree2D tree;
+  std::vector<Eigen::Vector2d> normals;
+  std::vector<bool> has_normal;
+};
+
+// Point-to-line ICP solved by Gauss-Newton on SE(2), starting from `initial`.
+// Scans are as returned by World::readLidar, in the robot frame and ordered by angle;
+// points with a 0 homogeneous coordinate are ignored.
+ICPResult point_to_line_icp(const points_t &source, const ICPTarget &target,
+    const transform_t &initial = transform_t::Identity(), const ICPParams &params = ICPParams());
+ICPResult point_to_line_icp(const points_t &source, const points_t &target,
+    const transform_t &initial = transform_t::Identity(), const ICPParams &params = ICPParams());
+
+// One registration in a batch: scans[source] onto scans[target], starting from `initial`
+struct ScanPair {
+  int source;
+  int target;
+  transform_t initial;
+};
+
+/* Runs point_to_line_icp for every pair, spread over worker threads with parallelFor.
+ * Each scan used as a target is prepared (k-d tree and normals) once and shared by
+ * all the pairs that use it. Results are in the same order as `pairs`. */
+std::vector<ICPResult> point_to_line_icp_batch(const std::vector<points_t> &scans,
+    const std::vector<ScanPair> &pairs, const ICPParams &params = ICPParams());
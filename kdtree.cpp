@@ -0,0 +1,81 @@
+#include "kdtree.h"
+#include <algorithm>
+#include <numeric>
+
+// Ranges this small are scanned linearly instead of split further
+constexpr int LEAF_SIZE = 8;
+
+KdTree2D::KdTree2D(const points_t &points) : _pts(), _idx(points.size()), _axis(points.size(), 0) {
+  std::iota(_idx.begin(), _idx.end(), 0);
+  std::vector<Eigen::Vector2d> original;
+  original.reserve(points.size());
+  for (const point_t &p : points)
+    original.push_back(p.head<2>());
+  _pts = original;
+  build(0, (int) points.size());
+  for (size_t i = 0; i < _idx.size(); i++)
+    _pts[i] = original[(size_t) _idx[i]];
+}
+
+// Only _idx is reordered while building; _pts still holds the points in their
+// original order until the constructor copies them into tree order.
+void KdTree2D::build(int lo, int hi) {
+  if (hi - lo <= LEAF_SIZE) return;
+  Eigen::Vector2d min_pt = _pts[(size_t) _idx[(size_t) lo]], max_pt = min_pt;
+  for (int i = lo + 1; i < hi; i++) {
+    min_pt = min_pt.cwiseMin(_pts[(size_t) _idx[(size_t) i]]);
+    max_pt = max_pt.cwiseMax(_pts[(size_t) _idx[(size_t) i]]);
+  }
+  Eigen::Vector2d spread = max_pt - min_pt;
+  int axis = spread(1) > spread(0) ? 1 : 0;
+  int mid = lo + (hi - lo) / 2;
+  std::nth_element(_idx.begin() + lo, _idx.begin() + mid, _idx.begin() + hi,
+      [&](int a, int b) { return _pts[(size_t) a](axis) < _pts[(size_t) b](axis); });
+  _axis[(size_t) mid] = (unsigned char) axis;
+  build(lo, mid);
+  build(mid + 1, hi);
+}
+
+void KdTree2D::search(int lo, int hi, const Eigen::Vector2d &q, int &best,
+    double &best_dist_sq) const {
+  if (hi - lo <= LEAF_SIZE) {
+    for (int i = lo; i < hi; i++) {
+      double d = (_pts[(size_t) i] - q).squaredNorm();
+      if (d < best_dist_sq) {
+        best_dist_sq = d;
+        best = i;
+      }
+    }
+    return;
+  }
+  int mid = lo + (hi - lo) / 2;
+  double d = (_pts[(size_t) mid] - q).squaredNorm();
+  if (d < best_dist_sq) {
+    best_dist_sq = d;
+    best = mid;
+  }
+  int axis = _axis[(size_t) mid];
+  double diff = q(axis) - _pts[(size_t) mid](axis);
+  // Search the side q is on first; the other side can only help if the
+  // splitting line is closer than the best point so far
+  if (diff < 0) {
+    search(lo, mid, q, best, best_dist_sq);
+    if (diff * diff < best_dist_sq) search(mid + 1, hi, q, best, best_dist_sq);
+  } else {
+    search(mid + 1, hi, q, best, best_dist_sq);
+    if (diff * diff < best_dist_sq) search(lo, mid, q, best, best_dist_sq);
+  }
+}
+
+int KdTree2D::nearest(const point_t &p, double max_dist, double *dist_sq) const {
+  int best = -1;
+  double best_dist_sq = max_dist * max_dist;
+  search(0, (int) _pts.size(), p.head<2>(), best, best_dist_sq);
+  if (best == -1) return -1;
+  if (dist_sq != nullptr) *dist_sq = best_dist_sq;
+  return _idx[(size_t) best];
+}
+
+size_t KdTree2D::size() const {
+  return _pts.size();
+}
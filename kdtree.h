@@ -0,0 +1,29 @@
+#ifndef KDTREE_H
+#define KDTREE_H
+
+#include <cmath>
+#include "utils.h"
+
+/* Static 2D k-d tree over the (x, y) coordinates of a point cloud, for nearest
+ * neighbour queries in O(log n). The tree is stored implicitly: each node is the
+ * median of a range of a reordered copy of the points, split on the axis with the
+ * larger spread. */
+class KdTree2D {
+public:
+  explicit KdTree2D(const points_t &points);
+
+  // Index (into the original cloud) of the point closest to p, or -1 if no point
+  // is within max_dist. If dist_sq is given, it is set to the squared distance.
+  int nearest(const point_t &p, double max_dist = INFINITY, double *dist_sq = nullptr) const;
+  size_t size() const;
+
+private:
+  void build(int lo, int hi);
+  void search(int lo, int hi, const Eigen::Vector2d &q, int &best, double &best_dist_sq) const;
+
+  std::vector<Eigen::Vector2d> _pts; // points in tree order
+  std::vector<int> _idx;             // original index of each point in _pts
+  std::vector<unsigned char> _axis;  // split axis of the node at each position
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "monte_carlo.h"
+#include <algorithm>
+#include <cmath>
+#include "parallel.h"
+#include "state_space.h"
+
+namespace {
+
+// The fields of SLAMErrors, so the summary can loop over them
+double SLAMErrors::*const ERROR_FIELDS[] = {
+  &SLAMErrors::initial_error,
+  &SLAMErrors::smoothed_error,
+  &SLAMErrors::initial_potential,
+  &SLAMErrors::smoothed_potential,
+  &SLAMErrors::ground_truth_potential,
+};
+
+}
+
+template <typename Traits>
+MonteCarloSummary runMonteCarlo(int num_runs, uint64_t seed, int num_threads) {
+  MonteCarloSummary summary;
+  summary.runs.resize((size_t) std::max(num_runs, 0));
+  parallelFor(num_runs, [&](int i) {
+    summary.runs[(size_t) i] = runSLAMTrial<Traits>(seed, (uint32_t) i);
+  }, 1, num_threads);
+
+  for (auto field : ERROR_FIELDS) {
+    double sum = 0.0, max = num_runs > 0 ? -INFINITY : 0.0;
+    for (const SLAMErrors &run : summary.runs) {
+      sum += run.*field;
+      max = std::max(max, run.*field);
+    }
+    double mean = num_runs > 0 ? sum / num_runs : 0.0;
+    double var = 0.0;
+    for (const SLAMErrors &run : summary.runs)
+      var += (run.*field - mean) * (run.*field - mean);
+    summary.mean.*field = mean;
+    summary.std.*field = num_runs > 1 ? sqrt(var / (num_runs - 1)) : 0.0;
+    summary.max.*field = max;
+  }
+  return summary;
+}
+
+template MonteCarloSummary runMonteCarlo<Planar2D>(int, uint64_t, int);
+template MonteCarloSummary runMonteCarlo<Linear1D>(int, uint64_t, int);
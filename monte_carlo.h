@@ -0,0 +1,26 @@
+#ifndef MONTE_CARLO_H
+#define MONTE_CARLO_H
+
+#include <cstdint>
+#include <vector>
+#include "slam_utils.h"
+
+/* Results of a batch of SLAM runs: each run's errors in run order, and the mean,
+ * standard deviation and maximum of each field over all runs. */
+struct MonteCarloSummary {
+  MonteCarloSummary() : runs(), mean(), std(), max() {}
+
+  std::vector<SLAMErrors> runs;
+  SLAMErrors mean;
+  SLAMErrors std;
+  SLAMErrors max;
+};
+
+/* Runs runSLAMTrial for runs 0 .. num_runs-1 of `seed` on up to num_threads threads
+ * (0 means one per core). Each run has its own random streams and writes only its own
+ * slot, and the summary is reduced in run order, so the result is bit-identical for any
+ * number of threads. Instantiated for Planar2D and Linear1D. */
+template <typename Traits>
+MonteCarloSummary runMonteCarlo(int num_runs, uint64_t seed, int num_threads = 0);
+
+#endif
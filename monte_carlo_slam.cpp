@@ -0,0 +1,30 @@
+#include <Eigen/LU>
+#include <cstdio>
+#include <cstdlib>
+#include "monte_carlo.h"
+#include "state_space.h"
+
+// Usage: monte_carlo.out [runs] [seed] [threads]
+// Repeats the 2D SLAM demo headless for `runs` independent noise draws and prints the
+// errors of each run and their statistics. The output only depends on runs and seed.
+int main(int argc, char **argv) {
+  int runs = argc > 1 ? atoi(argv[1]) : 16;
+  uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : 1;
+  int threads = argc > 3 ? atoi(argv[3]) : 0;
+
+  MonteCarloSummary summary = runMonteCarlo<Planar2D>(runs, seed, threads);
+
+  printf("run   initial err  smoothed err  smoothed pot  truth pot\n");
+  for (size_t i = 0; i < summary.runs.size(); i++) {
+    const SLAMErrors &e = summary.runs[i];
+    printf("%3zu  %12.3f  %12.3f  %12.3f  %9.3f\n", i, e.initial_error, e.smoothed_error,
+        e.smoothed_potential, e.ground_truth_potential);
+  }
+  const SLAMErrors *rows[] = {&summary.mean, &summary.std, &summary.max};
+  const char *names[] = {"mean", "std", "max"};
+  for (int k = 0; k < 3; k++) {
+    printf("%-4s %12.3f  %12.3f  %12.3f  %9.3f\n", names[k], rows[k]->initial_error,
+        rows[k]->smoothed_error, rows[k]->smoothed_potential, rows[k]->ground_truth_potential);
+  }
+  return 0;
+}
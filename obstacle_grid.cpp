@@ -0,0 +1,526 @@
+#include "obstacle_grid.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "constants.h"
+#include "parallel.h"
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Both cell coordinates packed into one hash key (the low 32 bits of each suffice)
+uint64_t cellKey(long cx, long cy) {
+  return (uint64_t((uint32_t) cx) << 32) | uint64_t((uint32_t) cy);
+}
+
+using xy_t = std::pair<double, double>;
+
+// Positive if o, a, b turn counterclockwise
+double cross(const xy_t &o, const xy_t &a, const xy_t &b) {
+  return (a.first - o.first) * (b.second - o.second) - (a.second - o.second) * (b.first - o.first);
+}
+
+// Twice the signed area of the polygon, positive if it is counterclockwise
+double twiceArea(const xy_t *pts, int n) {
+  double area = 0.0;
+  for (int i = 0; i < n; i++) {
+    const xy_t &a = pts[i], &b = pts[(i + 1) % n];
+    area += a.first * b.second - b.first * a.second;
+  }
+  return area;
+}
+
+// Andrew's monotone chain. Sorts `pts` and writes their convex hull to `hull`
+// (counterclockwise, without collinear points), which needs room for n + 1 points.
+// Returns the hull's size.
+int convexHull(xy_t *pts, int n, xy_t *hull) {
+  std::sort(pts, pts + n);
+  int k = 0;
+  for (int i = 0; i < n; i++) {
+    while (k >= 2 && cross(hull[k-2], hull[k-1], pts[i]) <= 0) k--;
+    hull[k++] = pts[i];
+  }
+  for (int i = n - 2, lower = k + 1; i >= 0; i--) {
+    while (k >= lower && cross(hull[k-2], hull[k-1], pts[i]) <= 0) k--;
+    hull[k++] = pts[i];
+  }
+  return std::max(k - 1, 1);
+}
+
+// Whether the polygon with n vertices at x, y pairs `xy` is strictly convex: every corner
+// turns the same way (ccw tells which), none is straight, and the edges go around only
+// once, so their x direction changes sign twice
+bool strictlyConvex(const double *xy, int n, bool &ccw) {
+  int turn_sign = 0, flips = 0;
+  double first_dx = 0, last_dx = 0;
+  for (int i = 0; i < n; i++) {
+    int j = (i + 1) % n, k = (i + 2) % n;
+    double ax = xy[2 * j] - xy[2 * i], ay = xy[2 * j + 1] - xy[2 * i + 1];
+    double bx = xy[2 * k] - xy[2 * j], by = xy[2 * k + 1] - xy[2 * j + 1];
+    double turn = ax * by - ay * bx;
+    int sign = turn > 0 ? 1 : (turn < 0 ? -1 : 0);
+    if (sign == 0 || (turn_sign != 0 && sign != turn_sign)) return false;
+    turn_sign = sign;
+    if (ax == 0) continue;
+    if (first_dx == 0) first_dx = ax;
+    if (last_dx != 0 && (ax > 0) != (last_dx > 0)) flips++;
+    last_dx = ax;
+  }
+  if ((first_dx > 0) != (last_dx > 0)) flips++;
+  ccw = turn_sign > 0;
+  return n >= 3 && flips <= 2;
+}
+
+// Splits the polygon with n vertices at x, y pairs `xy` into convex pieces: the polygon
+// itself if it is convex, triangles clipped off as ears otherwise. Each piece's vertices
+// are appended to x, y (counterclockwise) and its end offset to `ends`. A polygon that
+// isn't simple can run out of ears; the hull of what is left of it then stands in for
+// the rest.
+void convexPieces(const double *xy, int n, std::vector<double> &x, std::vector<double> &y,
+                  std::vector<int> &ends) {
+  auto append = [&](const xy_t *pts, int n) {
+    for (int i = 0; i < n; i++) {
+      x.push_back(pts[i].first);
+      y.push_back(pts[i].second);
+    }
+    ends.push_back((int) x.size());
+  };
+  // The common case needs no hull: the polygon is its own, give or take the first vertex
+  bool ccw;
+  if (strictlyConvex(xy, n, ccw)) {
+    for (int i = 0; i < n; i++) {
+      int k = ccw ? i : n - 1 - i;
+      x.push_back(xy[2 * k]);
+      y.push_back(xy[2 * k + 1]);
+    }
+    ends.push_back((int) x.size());
+    return;
+  }
+  thread_local std::vector<xy_t> poly, pts, hull;
+  poly.resize((size_t) n);
+  hull.resize((size_t) n + 1);
+  for (int i = 0; i < n; i++) poly[(size_t) i] = xy_t(xy[2 * i], xy[2 * i + 1]);
+  pts = poly;
+  int hull_size = convexHull(pts.data(), n, hull.data());
+  double area = twiceArea(poly.data(), n);
+  if (std::abs(area) >= twiceArea(hull.data(), hull_size) * (1 - 1e-9)) {
+    append(hull.data(), hull_size);
+    return;
+  }
+
+  if (area < 0) std::reverse(poly.begin(), poly.end());
+  while (poly.size() > 3) {
+    size_t m = poly.size(), ear = m;
+    for (size_t i = 0; i < m && ear == m; i++) {
+      const xy_t &a = poly[(i + m - 1) % m], &b = poly[i], &c = poly[(i + 1) % m];
+      double turn = cross(a, b, c);
+      if (turn < 0) continue; // reflex corner
+      bool empty = true;
+      for (size_t j = 0; j < m && empty && turn > 0; j++) {
+        const xy_t &q = poly[j];
+        if (j == i || j == (i + 1) % m || j == (i + m - 1) % m) continue;
+        empty = cross(a, b, q) < 0 || cross(b, c, q) < 0 || cross(c, a, q) < 0;
+      }
+      if (!empty) continue;
+      // A straight corner is dropped without a (flat) triangle
+      if (turn > 0) {
+        xy_t triangle[3] = {a, b, c};
+        append(triangle, 3);
+      }
+      ear = i;
+    }
+    if (ear == m) break;
+    poly.erase(poly.begin() + (long) ear);
+  }
+  if (poly.size() == 3 && cross(poly[0], poly[1], poly[2]) > 0) {
+    append(poly.data(), 3);
+  } else if (poly.size() > 3) {
+    pts = poly;
+    append(hull.data(), convexHull(pts.data(), (int) pts.size(), hull.data()));
+  }
+}
+
+// Whether some edge normal of polygon a separates a from b by more than `margin`
+bool separatedByEdgeOf(const double *ax, const double *ay, int na,
+                       const double *bx, const double *by, int nb, double margin) {
+  for (int i = 0; i < na; i++) {
+    int j = i + 1 < na ? i + 1 : 0;
+    double nx = ay[j] - ay[i], ny = ax[i] - ax[j];
+    double a_min = INFINITY, a_max = -INFINITY, b_min = INFINITY, b_max = -INFINITY;
+    for (int k = 0; k < na; k++) {
+      double d = nx * ax[k] + ny * ay[k];
+      a_min = std::min(a_min, d);
+      a_max = std::max(a_max, d);
+    }
+    for (int k = 0; k < nb; k++) {
+      double d = nx * bx[k] + ny * by[k];
+      b_min = std::min(b_min, d);
+      b_max = std::max(b_max, d);
+    }
+    double gap = margin > 0 ? margin * std::sqrt(nx * nx + ny * ny) : 0.0;
+    if (a_max + gap < b_min || b_max + gap < a_min) return true;
+  }
+  return false;
+}
+
+// Separating axis theorem: convex polygons are apart if and only if an edge normal of
+// one of them separates them
+bool convexOverlap(const double *ax, const double *ay, int na,
+                   const double *bx, const double *by, int nb, double margin) {
+  return !separatedByEdgeOf(ax, ay, na, bx, by, nb, margin) &&
+         !separatedByEdgeOf(bx, by, nb, ax, ay, na, margin);
+}
+
+// The footprint drawRobot draws, in the world frame: tf is world to robot, so a robot
+// frame point p is at R^T (p - t)
+void footprint(const transform_t &tf, double *x, double *y) {
+  const double px[3] = {NavSim::ROBOT_LENGTH/2, -NavSim::ROBOT_LENGTH/2, -NavSim::ROBOT_LENGTH/2};
+  const double py[3] = {0.0, NavSim::ROBOT_WHEEL_BASE/2, -NavSim::ROBOT_WHEEL_BASE/2};
+  for (int i = 0; i < 3; i++) {
+    double rx = px[i] - tf(0,2), ry = py[i] - tf(1,2);
+    x[i] = tf(0,0) * rx + tf(1,0) * ry;
+    y[i] = tf(0,1) * rx + tf(1,1) * ry;
+  }
+}
+
+// Neighbouring cells have similar keys, so they are mixed (splitmix64's finalizer)
+// before being used as a slot index
+uint64_t mixKey(uint64_t key) {
+  key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+  return key ^ (key >> 31);
+}
+
+}
+
+ObstacleGrid::ObstacleGrid(double cell_size) : _cell_size(cell_size),
+    _slots(), _num_cells(0), _entry_id(), _entry_next(),
+    _x0(), _y0(), _ex(), _ey(), _nx(), _ny(), _first_edge({0}),
+    _piece_x(), _piece_y(), _first_vertex({0}), _first_piece({0}), _min_x(), _min_y(), _max_x(), _max_y() {
+  rehash(64);
+}
+
+int ObstacleGrid::add(const obstacle_t &obs) {
+  int n = obs.rows();
+  std::vector<double> xy((size_t) (2 * n));
+  for (int i = 0; i < n; i++) {
+    xy[(size_t) (2 * i)] = obs(i,0);
+    xy[(size_t) (2 * i + 1)] = obs(i,1);
+  }
+  return index(xy.data(), n);
+}
+
+void ObstacleGrid::addAll(const double *xy, const uint64_t *offsets, size_t n) {
+  size_t num_edges = _x0.size() + (size_t) (offsets[n] - offsets[0]);
+  _first_edge.reserve(_first_edge.size() + n);
+  for (std::vector<double> *v : {&_x0, &_y0, &_ex, &_ey, &_nx, &_ny, &_piece_x, &_piece_y})
+    v->reserve(num_edges);
+  _first_vertex.reserve(_first_vertex.size() + n);
+  _first_piece.reserve(_first_piece.size() + n);
+  for (std::vector<double> *v : {&_min_x, &_min_y, &_max_x, &_max_y}) v->reserve(v->size() + n);
+  // Sized for about 4 cells per obstacle up front, rather than growing step by step
+  size_t num_slots = _slots.size();
+  while (num_slots < 2 * (_num_cells + 4 * n)) num_slots *= 2;
+  if (num_slots != _slots.size()) rehash(num_slots);
+  _entry_id.reserve(_entry_id.size() + 4 * n);
+  _entry_next.reserve(_entry_next.size() + 4 * n);
+  for (size_t i = 0; i < n; i++) {
+    index(xy + 2 * offsets[i], (int) (offsets[i + 1] - offsets[i]));
+  }
+}
+
+// Adds the edges and cells of a new obstacle with n vertices at x, y pairs `xy`;
+// returns its index
+int ObstacleGrid::index(const double *xy, int n) {
+  int id = (int) _first_edge.size() - 1;
+  size_t first = _x0.size();
+  for (std::vector<double> *v : {&_x0, &_y0, &_ex, &_ey, &_nx, &_ny}) v->resize(first + (size_t) n);
+  double *px = _x0.data() + first, *py = _y0.data() + first, *pex = _ex.data() + first;
+  double *pey = _ey.data() + first, *pnx = _nx.data() + first, *pny = _ny.data() + first;
+  double min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+  for (int i = 0; i < n; i++) {
+    int j = (i + 1) % n;
+    double x = xy[2 * i], y = xy[2 * i + 1];
+    px[i] = x;
+    py[i] = y;
+    pex[i] = xy[2 * j] - x;
+    pey[i] = xy[2 * j + 1] - y;
+    pnx[i] = pey[i];
+    pny[i] = -pex[i];
+    min_x = std::min(min_x, x);
+    min_y = std::min(min_y, y);
+    max_x = std::max(max_x, x);
+    max_y = std::max(max_y, y);
+  }
+  _first_edge.push_back((int) _x0.size());
+  convexPieces(xy, n, _piece_x, _piece_y, _first_vertex);
+  _first_piece.push_back((int) _first_vertex.size() - 1);
+  _min_x.push_back(min_x);
+  _min_y.push_back(min_y);
+  _max_x.push_back(max_x);
+  _max_y.push_back(max_y);
+  long x0 = cellCoord(_min_x.back()), x1 = cellCoord(_max_x.back());
+  long y0 = cellCoord(_min_y.back()), y1 = cellCoord(_max_y.back());
+  for (long cx = x0; cx <= x1; cx++) {
+    for (long cy = y0; cy <= y1; cy++) {
+      addToCell(cellKey(cx, cy), id);
+    }
+  }
+  return id;
+}
+
+size_t ObstacleGrid::numObstacles() const {
+  return _first_edge.size() - 1;
+}
+
+// An obstacle's vertices are the starts of its edges
+int ObstacleGrid::vertices(int id, const double *&x, const double *&y) const {
+  int begin = _first_edge[(size_t) id];
+  x = _x0.data() + begin;
+  y = _y0.data() + begin;
+  return _first_edge[(size_t) id + 1] - begin;
+}
+
+obstacle_t ObstacleGrid::obstacle(int id) const {
+  const double *x, *y;
+  int n = vertices(id, x, y);
+  obstacle_t obs(n, 2);
+  for (int i = 0; i < n; i++) {
+    obs(i,0) = x[i];
+    obs(i,1) = y[i];
+  }
+  return obs;
+}
+
+obstacles_t ObstacleGrid::obstacles() const {
+  obstacles_t obss;
+  obss.reserve(numObstacles());
+  for (size_t i = 0; i < numObstacles(); i++) obss.push_back(obstacle((int) i));
+  return obss;
+}
+
+double ObstacleGrid::cellSize() const {
+  return _cell_size;
+}
+
+std::vector<int> ObstacleGrid::obstaclesNear(double x, double y, double radius) const {
+  std::vector<int> ids;
+  for (long cx = cellCoord(x - radius); cx <= cellCoord(x + radius); cx++) {
+    for (long cy = cellCoord(y - radius); cy <= cellCoord(y + radius); cy++) {
+      for (int e = cell(cx, cy); e >= 0; e = _entry_next[(size_t) e]) {
+        ids.push_back(_entry_id[(size_t) e]);
+      }
+    }
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+long ObstacleGrid::cellCoord(double v) const {
+  return (long) std::floor(v / _cell_size);
+}
+
+int ObstacleGrid::cell(long cx, long cy) const {
+  return _slots[findSlot(cellKey(cx, cy))].head;
+}
+
+// The slot holding `key`, or the empty slot where it would go
+size_t ObstacleGrid::findSlot(uint64_t key) const {
+  const Slot *slots = _slots.data();
+  size_t mask = _slots.size() - 1;
+  size_t s = (size_t) mixKey(key) & mask;
+  while (slots[s].head >= 0 && slots[s].key != key) s = (s + 1) & mask;
+  return s;
+}
+
+void ObstacleGrid::addToCell(uint64_t key, int id) {
+  Slot &slot = _slots[findSlot(key)];
+  int entry = (int) _entry_id.size();
+  _entry_id.push_back(id);
+  _entry_next.push_back(-1);
+  if (slot.head >= 0) {
+    _entry_next[(size_t) slot.tail] = entry;
+    slot.tail = entry;
+    return;
+  }
+  slot = Slot{key, entry, entry};
+  // Kept at most half full, so probe sequences stay short
+  if (++_num_cells * 2 > _slots.size()) rehash(2 * _slots.size());
+}
+
+void ObstacleGrid::rehash(size_t num_slots) {
+  std::vector<Slot> old(num_slots, Slot{0, -1, -1});
+  old.swap(_slots);
+  for (const Slot &slot : old) {
+    if (slot.head >= 0) _slots[findSlot(slot.key)] = slot;
+  }
+}
+
+double ObstacleGrid::rayEdges(double rx, double ry, double dx, double dy, int begin, int end) const {
+  double min_t = 2.0;
+  int k = begin;
+#if defined(__AVX2__) && defined(__FMA__)
+  // rayEdgeIntersection, 4 edges per iteration, with the same operations in the same
+  // order so that every lane rounds exactly like the scalar code
+  const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+  const __m256d vrx = _mm256_set1_pd(rx), vry = _mm256_set1_pd(ry);
+  const __m256d vdx = _mm256_set1_pd(dx), vdy = _mm256_set1_pd(dy);
+  __m256d best = _mm256_set1_pd(2.0);
+  for (; k + 4 <= end; k += 4) {
+    __m256d nx = _mm256_loadu_pd(&_nx[(size_t) k]), ny = _mm256_loadu_pd(&_ny[(size_t) k]);
+    __m256d bx = _mm256_sub_pd(vrx, _mm256_loadu_pd(&_x0[(size_t) k]));
+    __m256d by = _mm256_sub_pd(vry, _mm256_loadu_pd(&_y0[(size_t) k]));
+    __m256d det = _mm256_sub_pd(zero, _mm256_fmadd_pd(vdx, nx, _mm256_mul_pd(vdy, ny)));
+    __m256d t0 = _mm256_div_pd(_mm256_fmadd_pd(bx, nx, _mm256_mul_pd(by, ny)), det);
+    __m256d t1 = _mm256_div_pd(_mm256_fmsub_pd(bx, vdy, _mm256_mul_pd(vdx, by)), det);
+    __m256d hit = _mm256_and_pd(_mm256_cmp_pd(det, zero, _CMP_NEQ_OQ),
+        _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(t1, zero, _CMP_GE_OQ),
+                                    _mm256_cmp_pd(t1, one, _CMP_LE_OQ)),
+                      _mm256_cmp_pd(t0, zero, _CMP_GE_OQ)));
+    best = _mm256_min_pd(best, _mm256_blendv_pd(best, t0, hit));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, best);
+  min_t = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+#endif
+  for (; k < end; k++) {
+    size_t e = (size_t) k;
+    double t;
+    if (rayEdgeIntersection(rx, ry, dx, dy, _x0[e], _y0[e], _ex[e], _ey[e], &t) && t < min_t) {
+      min_t = t;
+    }
+  }
+  return min_t;
+}
+
+double obstacleIntersection(const point_t &r0, const point_t &r1, const ObstacleGrid &grid) {
+  double size = grid._cell_size;
+  double dx = r1(0) - r0(0), dy = r1(1) - r0(1);
+  long cx = grid.cellCoord(r0(0)), cy = grid.cellCoord(r0(1));
+  int step_x = dx > 0 ? 1 : (dx < 0 ? -1 : 0);
+  int step_y = dy > 0 ? 1 : (dy < 0 ? -1 : 0);
+  // Segment parameter at which the walk next crosses a vertical / horizontal cell
+  // boundary, and how far apart those crossings are
+  double next_x = step_x == 0 ? INFINITY : ((cx + (step_x > 0)) * size - r0(0)) / dx;
+  double next_y = step_y == 0 ? INFINITY : ((cy + (step_y > 0)) * size - r0(1)) / dy;
+  double delta_x = step_x == 0 ? INFINITY : size / std::abs(dx);
+  double delta_y = step_y == 0 ? INFINITY : size / std::abs(dy);
+
+  double min_t = 2.0;
+  std::vector<int> tested; // obstacles span cells; test each one only once
+  while (true) {
+    int head = grid.cell(cx, cy);
+    if (head >= 0) {
+      // Obstacles added one after another have adjacent edges in the table, so runs of
+      // consecutive ids are tested as one block
+      int run_begin = 0, run_end = 0;
+      for (int e = head; e >= 0; e = grid._entry_next[(size_t) e]) {
+        int id = grid._entry_id[(size_t) e];
+        if (std::find(tested.begin(), tested.end(), id) != tested.end()) continue;
+        tested.push_back(id);
+        if (grid._first_edge[(size_t) id] != run_end) {
+          min_t = std::min(min_t, grid.rayEdges(r0(0), r0(1), dx, dy, run_begin, run_end));
+          run_begin = grid._first_edge[(size_t) id];
+        }
+        run_end = grid._first_edge[(size_t) id + 1];
+      }
+      min_t = std::min(min_t, grid.rayEdges(r0(0), r0(1), dx, dy, run_begin, run_end));
+    }
+    double exit_t = std::min(next_x, next_y);
+    // A hit before the walk leaves this cell can't be beaten by a later cell
+    if (min_t <= exit_t || exit_t > 1.0) break;
+    if (next_x < next_y) {
+      cx += step_x;
+      next_x += delta_x;
+    } else {
+      cy += step_y;
+      next_y += delta_y;
+    }
+  }
+  return min_t <= 1.0 ? min_t : 2.0;
+}
+
+// Tests the convex polygon (x[i], y[i]), grown by `margin`, against every obstacle
+// listed in the cells its bounding box overlaps. `tested` is scratch space.
+bool polygonCollides(const double *x, const double *y, int n, double margin,
+                     const ObstacleGrid &grid, std::vector<int> &tested) {
+  double min_x = *std::min_element(x, x + n) - margin, max_x = *std::max_element(x, x + n) + margin;
+  double min_y = *std::min_element(y, y + n) - margin, max_y = *std::max_element(y, y + n) + margin;
+  tested.clear();
+  for (long cx = grid.cellCoord(min_x); cx <= grid.cellCoord(max_x); cx++) {
+    for (long cy = grid.cellCoord(min_y); cy <= grid.cellCoord(max_y); cy++) {
+      for (int e = grid.cell(cx, cy); e >= 0; e = grid._entry_next[(size_t) e]) {
+        int id = grid._entry_id[(size_t) e];
+        if (std::find(tested.begin(), tested.end(), id) != tested.end()) continue;
+        tested.push_back(id);
+        size_t i = (size_t) id;
+        if (grid._max_x[i] < min_x || grid._min_x[i] > max_x ||
+            grid._max_y[i] < min_y || grid._min_y[i] > max_y)
+          continue;
+        for (int k = grid._first_piece[i]; k < grid._first_piece[i + 1]; k++) {
+          size_t first = (size_t) grid._first_vertex[(size_t) k];
+          int size = grid._first_vertex[(size_t) k + 1] - grid._first_vertex[(size_t) k];
+          if (convexOverlap(x, y, n, &grid._piece_x[first], &grid._piece_y[first], size, margin))
+            return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+bool footprintCollides(const transform_t &tf, const ObstacleGrid &grid) {
+  double x[3], y[3];
+  footprint(tf, x, y);
+  std::vector<int> tested;
+  return polygonCollides(x, y, 3, 0.0, grid, tested);
+}
+
+bool sweptFootprintCollides(const transform_t &from, const transform_t &to,
+                            const ObstacleGrid &grid) {
+  const double max_step = 0.1; // rad
+  pose_t a = toPose(from, 0.0);
+  pose_t b = toPose(to, a(2));
+  int steps = std::max(1, (int) std::ceil(std::abs(b(2) - a(2)) / max_step));
+  // A point at distance r from the center of rotation strays at most r (1 - cos(d/2))
+  // from the chord while turning through d
+  double radius = std::hypot(NavSim::ROBOT_LENGTH/2, NavSim::ROBOT_WHEEL_BASE/2);
+  double margin = radius * (1 - cos(std::abs(b(2) - a(2)) / steps / 2));
+  std::vector<int> tested;
+  xy_t pts[6], hull[7];
+  double x[6], y[6];
+  footprint(from, x, y);
+  for (int s = 1; s <= steps; s++) {
+    for (int i = 0; i < 3; i++) pts[i] = xy_t(x[i], y[i]);
+    footprint(s == steps ? to : toTransform(a + (b - a) * s / steps), x, y);
+    for (int i = 0; i < 3; i++) pts[3 + i] = xy_t(x[i], y[i]);
+    int n = convexHull(pts, 6, hull);
+    double hx[6], hy[6];
+    for (int i = 0; i < n; i++) {
+      hx[i] = hull[i].first;
+      hy[i] = hull[i].second;
+    }
+    if (polygonCollides(hx, hy, n, margin, grid, tested)) return true;
+  }
+  return false;
+}
+
+std::vector<char> footprintCollides(const trajectory_t &tfs, const ObstacleGrid &grid,
+                                    int num_threads) {
+  // Poses go in chunks so that each chunk reuses one scratch list
+  const int chunk = 64;
+  int n = (int) tfs.size();
+  std::vector<char> collisions(tfs.size(), 0);
+  parallelFor((n + chunk - 1) / chunk, [&](int c) {
+    std::vector<int> tested;
+    double x[3], y[3];
+    for (int i = c * chunk; i < std::min(n, (c + 1) * chunk); i++) {
+      footprint(tfs[(size_t) i], x, y);
+      collisions[(size_t) i] = polygonCollides(x, y, 3, 0.0, grid, tested);
+    }
+  }, 1, num_threads);
+  return collisions;
+}
@@ -0,0 +1,105 @@
+#ifndef OBSTACLE_GRID_H
+#define OBSTACLE_GRID_H
+
+#include <cstdint>
+#include <vector>
+#include "utils.h"
+
+/* Uniform grid over the obstacles, so collision and ray queries only look at the
+ * obstacles near the query instead of all of them. Each obstacle is listed in every
+ * cell its bounding box overlaps. Cells are hashed, so the grid is unbounded and only
+ * costs memory where there are obstacles. The hash table and the cells' lists live in
+ * a few flat arrays, so adding an obstacle rarely allocates and loading a large world
+ * (see addAll) is quick.
+ *
+ * The edges of all obstacles are also flattened into one structure-of-arrays table,
+ * which ray queries test 4 edges at a time with AVX2 (when enabled, see ARCH in the
+ * Makefile). The results are bit-identical to rayEdgeIntersection in utils.cpp. That
+ * table is the only copy of the obstacles; obstacle() and obstacles() rebuild them.
+ *
+ * Queries are const and allocate nothing shared, so several threads can query at once
+ * (but not while an obstacle is being added). */
+class ObstacleGrid {
+public:
+  explicit ObstacleGrid(double cell_size = 2.0);
+
+  // Returns the index of the new obstacle in obstacles()
+  int add(const obstacle_t &obs);
+  // Adds n obstacles at once from packed x, y vertex pairs: obstacle i has vertices
+  // offsets[i] to offsets[i+1] - 1 (the layout of a ScenarioFile), read in place
+  void addAll(const double *xy, const uint64_t *offsets, size_t n);
+  size_t numObstacles() const;
+  // Points x and y at the coordinates of obstacle id's vertices; returns their number
+  int vertices(int id, const double *&x, const double *&y) const;
+  obstacle_t obstacle(int id) const;
+  // A copy of all obstacles, in the order they were added
+  obstacles_t obstacles() const;
+  double cellSize() const;
+  // Indices (sorted) of the obstacles listed in the cells within `radius` of (x, y):
+  // every obstacle that comes that close, and possibly a few more
+  std::vector<int> obstaclesNear(double x, double y, double radius) const;
+
+private:
+  friend double obstacleIntersection(const point_t &r0, const point_t &r1, const ObstacleGrid &grid);
+  friend bool polygonCollides(const double *x, const double *y, int n, double margin,
+                              const ObstacleGrid &grid, std::vector<int> &tested);
+
+  double _cell_size;
+  // Open addressing (linear probing, power-of-two size) from cell key to the cell's
+  // list of obstacles: entries head, _entry_next[head], ... up to -1, holding obstacle
+  // indices _entry_id[...] in the order they were added. Empty slots have head -1. A
+  // slot is one 16-byte record, so a lookup touches a single cache line.
+  struct Slot {
+    uint64_t key;
+    int head, tail;
+  };
+  std::vector<Slot> _slots;
+  size_t _num_cells;
+  std::vector<int> _entry_id, _entry_next;
+  // Edge k starts at (_x0[k], _y0[k]), has direction (_ex[k], _ey[k]) and normal
+  // (_nx[k], _ny[k]) = (_ey[k], -_ex[k]). Obstacle i owns edges _first_edge[i] to
+  // _first_edge[i+1] - 1.
+  std::vector<double> _x0, _y0, _ex, _ey, _nx, _ny;
+  std::vector<int> _first_edge;
+  // Obstacle i split into convex pieces _first_piece[i] to _first_piece[i+1] - 1 (see
+  // footprintCollides). Piece k has vertices _first_vertex[k] to _first_vertex[k+1] - 1
+  // of _piece_x, _piece_y (counterclockwise). And the obstacle's bounding box.
+  std::vector<double> _piece_x, _piece_y;
+  std::vector<int> _first_vertex, _first_piece;
+  std::vector<double> _min_x, _min_y, _max_x, _max_y;
+
+  long cellCoord(double v) const;
+  // First entry of the cell's list, or -1 if the cell is empty
+  int cell(long cx, long cy) const;
+  size_t findSlot(uint64_t key) const;
+  int index(const double *xy, int n);
+  void addToCell(uint64_t key, int id);
+  void rehash(size_t num_slots);
+  // Smallest t (or 2.0) at which the ray (rx, ry) + t(dx, dy) crosses edges [begin, end)
+  double rayEdges(double rx, double ry, double dx, double dy, int begin, int end) const;
+};
+
+/* Same as the obstacles_t version in utils.h, but only the obstacles in the cells the
+ * segment crosses are tested, in a DDA walk that stops at the first cell containing a
+ * hit. Returns 2.0 unless the hit lies on the segment. */
+double obstacleIntersection(const point_t &r0, const point_t &r1, const ObstacleGrid &grid);
+
+/* Collision checks for the robot's whole footprint, the triangle drawRobot draws
+ * (ROBOT_LENGTH long, ROBOT_WHEEL_BASE wide at the back), rather than a point. Obstacles
+ * are first rejected by bounding box, then tested against the footprint with the
+ * separating axis theorem. SAT needs convex shapes, so the grid splits each non-convex
+ * obstacle into triangles when it is added (ear clipping); convex obstacles stay whole.
+ * Touching counts as colliding. */
+bool footprintCollides(const transform_t &tf, const ObstacleGrid &grid);
+/* Whether the footprint hits anything on the way from `from` to `to`, with x, y and
+ * heading interpolated linearly. The swept area is covered by the hulls of the
+ * footprints at the ends of sub-steps of at most 0.1 rad, each padded by how far the
+ * footprint's corners bow out while turning through that sub-step. */
+bool sweptFootprintCollides(const transform_t &from, const transform_t &to,
+                            const ObstacleGrid &grid);
+/* footprintCollides for each of many poses (e.g. a planner's candidates), on up to
+ * num_threads threads (0 means one per core). Element i is nonzero if tfs[i] collides. */
+std::vector<char> footprintCollides(const trajectory_t &tfs, const ObstacleGrid &grid,
+                                    int num_threads = 0);
+
+#endif
@@ -0,0 +1,146 @@
+#include "occupancy_grid.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <Eigen/LU>
+
+namespace {
+
+constexpr long T = OccupancyGrid::TILE_SIZE;
+
+uint64_t tileKey(long tx, long ty) {
+  return (uint64_t((uint32_t) tx) << 32) | uint64_t((uint32_t) ty);
+}
+
+// Rounds towards -infinity, unlike integer division, so negative cells land in the
+// tile to their left
+long tileOf(long c) {
+  return c >= 0 ? c / T : -((-c - 1) / T) - 1;
+}
+
+}
+
+OccupancyGrid::OccupancyGrid(double resolution, OccupancyParams params)
+    : _resolution(resolution), _params(params), _tiles(), _tile_index(), _tile_dirty(),
+      _tile_coords(), _dirty(), _last_tx(0), _last_ty(0), _last_tile(-1) {}
+
+void OccupancyGrid::addScan(const transform_t &tf, const points_t &hits) {
+  transform_t robot_to_world = tf.inverse();
+  point_t origin = robot_to_world * point_t(0, 0, 1);
+  for (const point_t &p : hits) {
+    if (p(2) == 0.0) continue;
+    addRay(origin, robot_to_world * p, true);
+  }
+}
+
+// Walks the cells the segment crosses (Amanatides & Woo), lowering the log-odds of
+// each, then updates the end cell
+void OccupancyGrid::addRay(const point_t &from, const point_t &to, bool hit) {
+  double x0 = from(0) / _resolution, y0 = from(1) / _resolution;
+  double dx = to(0) / _resolution - x0, dy = to(1) / _resolution - y0;
+  long cx = (long) std::floor(x0), cy = (long) std::floor(y0);
+  long end_x = cellCoord(to(0)), end_y = cellCoord(to(1));
+  int step_x = dx > 0 ? 1 : -1, step_y = dy > 0 ? 1 : -1;
+  double next_x = dx == 0 ? INFINITY : (cx + (dx > 0) - x0) / dx;
+  double next_y = dy == 0 ? INFINITY : (cy + (dy > 0) - y0) / dy;
+  double delta_x = dx == 0 ? INFINITY : 1 / std::abs(dx);
+  double delta_y = dy == 0 ? INFINITY : 1 / std::abs(dy);
+  // Rounding can make the walk miss the end cell by one; it never needs more steps
+  long steps = std::abs(end_x - cx) + std::abs(end_y - cy);
+  for (long i = 0; i < steps && (cx != end_x || cy != end_y); i++) {
+    update(cx, cy, _params.miss);
+    if (next_x < next_y) {
+      cx += step_x;
+      next_x += delta_x;
+    } else {
+      cy += step_y;
+      next_y += delta_y;
+    }
+  }
+  update(end_x, end_y, hit ? _params.hit : _params.miss);
+}
+
+double OccupancyGrid::resolution() const {
+  return _resolution;
+}
+
+float OccupancyGrid::logOdds(double x, double y) const {
+  long cx = cellCoord(x), cy = cellCoord(y);
+  const tile_t *t = tile(tileOf(cx), tileOf(cy));
+  if (t == nullptr) return 0.0f;
+  return (*t)[(size_t) ((cy - tileOf(cy) * T) * T + (cx - tileOf(cx) * T))];
+}
+
+double OccupancyGrid::probability(double x, double y) const {
+  return 1.0 / (1.0 + exp(-logOdds(x, y)));
+}
+
+points_t OccupancyGrid::occupiedCells(double min_probability) const {
+  float min_log_odds = (float) log(min_probability / (1.0 - min_probability));
+  points_t cells;
+  for (size_t i = 0; i < _tiles.size(); i++) {
+    for (long j = 0; j < T * T; j++) {
+      if (_tiles[i][(size_t) j] < min_log_odds) continue;
+      long cx = _tile_coords[i].tx * T + j % T, cy = _tile_coords[i].ty * T + j / T;
+      cells.push_back(point_t((cx + 0.5) * _resolution, (cy + 0.5) * _resolution, 1));
+    }
+  }
+  return cells;
+}
+
+size_t OccupancyGrid::numTiles() const {
+  return _tiles.size();
+}
+
+std::vector<OccupancyGrid::TileCoord> OccupancyGrid::takeDirtyTiles() {
+  std::vector<TileCoord> dirty;
+  for (int i : _dirty) {
+    dirty.push_back(_tile_coords[(size_t) i]);
+    _tile_dirty[(size_t) i] = false;
+  }
+  _dirty.clear();
+  return dirty;
+}
+
+const OccupancyGrid::tile_t *OccupancyGrid::tile(long tx, long ty) const {
+  auto it = _tile_index.find(tileKey(tx, ty));
+  return it == _tile_index.end() ? nullptr : &_tiles[(size_t) it->second];
+}
+
+long OccupancyGrid::cellCoord(double v) const {
+  return (long) std::floor(v / _resolution);
+}
+
+// The tile's index in _tiles, allocating it (unknown everywhere) on first use
+int OccupancyGrid::tileIndex(long tx, long ty) {
+  if (_last_tile >= 0 && tx == _last_tx && ty == _last_ty) return _last_tile;
+  auto it = _tile_index.find(tileKey(tx, ty));
+  int index;
+  if (it != _tile_index.end()) {
+    index = it->second;
+  } else {
+    index = (int) _tiles.size();
+    _tiles.emplace_back();
+    _tiles.back().fill(0.0f);
+    _tile_index[tileKey(tx, ty)] = index;
+    _tile_dirty.push_back(false);
+    _tile_coords.push_back(TileCoord{tx, ty});
+  }
+  _last_tx = tx;
+  _last_ty = ty;
+  _last_tile = index;
+  return index;
+}
+
+void OccupancyGrid::update(long cx, long cy, float delta) {
+  long tx = tileOf(cx), ty = tileOf(cy);
+  int index = tileIndex(tx, ty);
+  float &cell = _tiles[(size_t) index][(size_t) ((cy - ty * T) * T + (cx - tx * T))];
+  float updated = std::min(_params.max, std::max(_params.min, cell + delta));
+  if (updated == cell) return;
+  cell = updated;
+  if (!_tile_dirty[(size_t) index]) {
+    _tile_dirty[(size_t) index] = true;
+    _dirty.push_back(index);
+  }
+}
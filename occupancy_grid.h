@@ -0,0 +1,80 @@
+#ifndef OCCUPANCY_GRID_H
+#define OCCUPANCY_GRID_H
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "utils.h"
+
+/* How lidar evidence changes a cell's log-odds of being occupied. Cells a beam passes
+ * through get `miss`, the cell it ends in gets `hit`, and log-odds are clamped to
+ * [min, max] so the map can still change its mind about a cell. */
+struct OccupancyParams {
+  OccupancyParams() : hit(0.85f), miss(-0.4f), min(-2.0f), max(3.5f) {}
+
+  float hit;
+  float miss;
+  float min;
+  float max;
+};
+
+/* An occupancy grid map built from lidar scans. Cells are grouped into square tiles of
+ * TILE_SIZE x TILE_SIZE, which are only allocated when a beam first touches them, so
+ * memory grows with the area explored rather than with its bounding box. Each tile is
+ * one contiguous block, and rays are traced cell by cell (DDA) with the current tile
+ * kept at hand, so most cells are updated without a tile lookup.
+ *
+ * Tiles whose cells changed are remembered until takeDirtyTiles(), so consumers (a
+ * planner, a display) only need to look at what changed since they last asked. */
+class OccupancyGrid {
+public:
+  static constexpr int TILE_SIZE = 32;
+  using tile_t = std::array<float, TILE_SIZE * TILE_SIZE>; // log-odds, row-major in y
+
+  explicit OccupancyGrid(double resolution = 0.1, OccupancyParams params = OccupancyParams());
+
+  /* Adds a scan taken at robot transform `tf` (world to robot, like readTrueTransform
+   * or a pose estimate). Hits are in the robot frame, as from World::readLidar; (0,0,0)
+   * entries are skipped. */
+  void addScan(const transform_t &tf, const points_t &hits);
+  // Adds one beam from `from` to `to` (world frame); marks its end occupied if `hit`
+  void addRay(const point_t &from, const point_t &to, bool hit);
+
+  double resolution() const;
+  // Log-odds at a world position; 0 (unknown) where nothing was observed
+  float logOdds(double x, double y) const;
+  double probability(double x, double y) const;
+  // Centers of the cells with at least this probability of being occupied
+  points_t occupiedCells(double min_probability = 0.7) const;
+  size_t numTiles() const;
+
+  /* Tile coordinates: tile (tx, ty) covers cells tx * TILE_SIZE .. (tx + 1) * TILE_SIZE - 1
+   * in x, and likewise in y; cell (cx, cy) covers world x from cx * resolution. */
+  struct TileCoord {
+    long tx;
+    long ty;
+  };
+  // Tiles changed since the last call, each listed once
+  std::vector<TileCoord> takeDirtyTiles();
+  // The tile's log-odds, or nullptr if it was never touched
+  const tile_t *tile(long tx, long ty) const;
+
+private:
+  double _resolution;
+  OccupancyParams _params;
+  std::vector<tile_t> _tiles;
+  std::unordered_map<uint64_t, int> _tile_index;
+  std::vector<bool> _tile_dirty;
+  std::vector<TileCoord> _tile_coords;
+  std::vector<int> _dirty;  // indices of dirty tiles
+  // The tile the last update went to
+  long _last_tx, _last_ty;
+  int _last_tile;
+
+  long cellCoord(double v) const;
+  int tileIndex(long tx, long ty);
+  void update(long cx, long cy, float delta);
+};
+
+#endif
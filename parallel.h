@@ -0,0 +1,40 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/* Number of worker threads used by parallelFor. Always at least 1. */
+inline int numWorkerThreads() {
+  int n = (int) std::thread::hardware_concurrency();
+  return n > 0 ? n : 1;
+}
+
+/* Calls f(i) for every i in [0, n), splitting the range into contiguous chunks
+ * that run on separate threads. Each index is visited exactly once, so callers
+ * that only write to slot i of some output get results independent of the
+ * number of threads. Small ranges run inline on the calling thread.
+ * At most max_threads threads are used (numWorkerThreads() if 0). */
+template <typename F>
+void parallelFor(int n, const F &f, int min_chunk = 16, int max_threads = 0) {
+  if (max_threads <= 0) max_threads = numWorkerThreads();
+  int num_threads = std::min(max_threads, (n + min_chunk - 1) / min_chunk);
+  if (num_threads <= 1) {
+    for (int i = 0; i < n; i++) f(i);
+    return;
+  }
+  std::vector<std::thread> threads;
+  int chunk = (n + num_threads - 1) / num_threads;
+  for (int t = 1; t < num_threads; t++) {
+    int begin = t * chunk;
+    int end = std::min(n, begin + chunk);
+    threads.emplace_back([&f, begin, end] {
+      for (int i = begin; i < end; i++) f(i);
+    });
+  }
+  for (int i = 0; i < std::min(n, chunk); i++) f(i);
+  for (std::thread &t : threads) t.join();
+}
+
+#endif
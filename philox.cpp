@@ -0,0 +1,64 @@
+#include "philox.h"
+#include <cmath>
+
+namespace {
+
+constexpr uint32_t PHILOX_M0 = 0xD2511F53, PHILOX_M1 = 0xCD9E8D57;
+constexpr uint32_t PHILOX_W0 = 0x9E3779B9, PHILOX_W1 = 0xBB67AE85;
+
+// Uniform in (0, 1), never 0 (Box-Muller takes its log), from 53 random bits
+double uniform(uint32_t hi, uint32_t lo) {
+  uint64_t bits = (uint64_t(hi) << 21) ^ (lo >> 11);
+  return (double(bits & ((uint64_t(1) << 53) - 1)) + 0.5) / 9007199254740992.0;
+}
+
+}
+
+philox_counter_t philox4x32(philox_counter_t ctr, philox_key_t key) {
+  for (int round = 0; round < 10; round++) {
+    uint64_t p0 = uint64_t(PHILOX_M0) * ctr[0];
+    uint64_t p1 = uint64_t(PHILOX_M1) * ctr[2];
+    ctr = {uint32_t(p1 >> 32) ^ ctr[1] ^ key[0], uint32_t(p1),
+           uint32_t(p0 >> 32) ^ ctr[3] ^ key[1], uint32_t(p0)};
+    key[0] += PHILOX_W0;
+    key[1] += PHILOX_W1;
+  }
+  return ctr;
+}
+
+NormalStream::NormalStream(uint64_t seed, uint32_t run, uint32_t sensor)
+    : _key({uint32_t(seed), uint32_t(seed >> 32)}), _run(run), _sensor(sensor),
+      _position(0), _block(0), _block_valid(false), _samples() {}
+
+double NormalStream::next() {
+  uint64_t block = _position / BLOCK_SIZE;
+  if (!_block_valid || block != _block) generateBlock(block);
+  return _samples[_position++ % BLOCK_SIZE];
+}
+
+void NormalStream::fill(double *out, int n) {
+  for (int i = 0; i < n; i++) out[i] = next();
+}
+
+void NormalStream::seek(uint64_t index) {
+  _position = index;
+}
+
+uint64_t NormalStream::position() const {
+  return _position;
+}
+
+// Each Philox call gives two uniforms, hence two normals. The counter is
+// (pair index, sensor, run), so every sample of every stream has its own counter.
+void NormalStream::generateBlock(uint64_t block) {
+  for (int j = 0; j < BLOCK_SIZE / 2; j++) {
+    uint64_t pair = block * (BLOCK_SIZE / 2) + (uint64_t) j;
+    philox_counter_t r = philox4x32({uint32_t(pair), uint32_t(pair >> 32), _sensor, _run}, _key);
+    double radius = sqrt(-2.0 * log(uniform(r[0], r[1])));
+    double angle = 2 * M_PI * uniform(r[2], r[3]);
+    _samples[(size_t) (2 * j)] = radius * cos(angle);
+    _samples[(size_t) (2 * j + 1)] = radius * sin(angle);
+  }
+  _block = block;
+  _block_valid = true;
+}
@@ -0,0 +1,41 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <array>
+#include <cstdint>
+
+/* Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"): a
+ * counter-based generator, so every output is a pure function of (counter, key). A
+ * stream can start anywhere without generating what comes before it, and streams for
+ * different runs and sensors are just different counters. */
+using philox_counter_t = std::array<uint32_t, 4>;
+using philox_key_t = std::array<uint32_t, 2>;
+philox_counter_t philox4x32(philox_counter_t counter, philox_key_t key);
+
+/* Standard normal samples for one (seed, run, sensor). Sample i only depends on those
+ * three and i, whatever else is drawn and on whichever thread. Samples are generated
+ * 64 at a time (Box-Muller on pairs of 53-bit uniforms). */
+class NormalStream {
+public:
+  explicit NormalStream(uint64_t seed = 0, uint32_t run = 0, uint32_t sensor = 0);
+
+  double next();
+  void fill(double *out, int n);
+  // Makes sample `index` the next one returned
+  void seek(uint64_t index);
+  uint64_t position() const;
+
+private:
+  static constexpr int BLOCK_SIZE = 64;
+
+  philox_key_t _key;
+  uint32_t _run, _sensor;
+  uint64_t _position;
+  uint64_t _block;    // index of the block in _samples
+  bool _block_valid;
+  std::array<double, BLOCK_SIZE> _samples;
+
+  void generateBlock(uint64_t block);
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "point_cloud.h"
+#include <algorithm>
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+PointCloud::PointCloud() : _x(), _y(), _valid() {}
+
+PointCloud::PointCloud(const points_t &points) : _x(), _y(), _valid() {
+  resize(points.size());
+  for (size_t i = 0; i < points.size(); i++) {
+    _x[i] = points[i](0);
+    _y[i] = points[i](1);
+    setValid(i, points[i](2) != 0.0);
+  }
+}
+
+size_t PointCloud::size() const {
+  return _x.size();
+}
+
+void PointCloud::resize(size_t n) {
+  _x.resize(n, 0.0);
+  _y.resize(n, 0.0);
+  _valid.resize((n + 63) / 64, 0);
+  // Points dropped by shrinking must not come back as valid
+  if (n % 64 != 0) _valid.back() &= (uint64_t(1) << (n % 64)) - 1;
+}
+
+void PointCloud::push_back(double x, double y, bool valid) {
+  size_t i = size();
+  resize(i + 1);
+  _x[i] = x;
+  _y[i] = y;
+  setValid(i, valid);
+}
+
+bool PointCloud::valid(size_t i) const {
+  return (_valid[i / 64] >> (i % 64)) & 1;
+}
+
+void PointCloud::setValid(size_t i, bool valid) {
+  uint64_t bit = uint64_t(1) << (i % 64);
+  if (valid) _valid[i / 64] |= bit;
+  else _valid[i / 64] &= ~bit;
+}
+
+void PointCloud::clearValid() {
+  std::fill(_valid.begin(), _valid.end(), 0);
+}
+
+size_t PointCloud::numValid() const {
+  size_t n = 0;
+  for (uint64_t word : _valid)
+    n += (size_t) __builtin_popcountll(word);
+  return n;
+}
+
+double *PointCloud::x() { return _x.data(); }
+double *PointCloud::y() { return _y.data(); }
+const double *PointCloud::x() const { return _x.data(); }
+const double *PointCloud::y() const { return _y.data(); }
+uint64_t *PointCloud::validMask() { return _valid.data(); }
+const uint64_t *PointCloud::validMask() const { return _valid.data(); }
+
+points_t PointCloud::toPoints() const {
+  points_t points(size(), point_t::Zero());
+  for (size_t i = 0; i < size(); i++) {
+    if (valid(i)) points[i] << _x[i], _y[i], 1;
+  }
+  return points;
+}
+
+void transformCloud(const transform_t &tf, const PointCloud &in, PointCloud &out) {
+  size_t n = in.size();
+  if (&out != &in) {
+    out.resize(n);
+    std::copy(in.validMask(), in.validMask() + (n + 63) / 64, out.validMask());
+  }
+  const double *x = in.x(), *y = in.y();
+  double *ox = out.x(), *oy = out.y();
+  size_t i = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+  __m256d a = _mm256_set1_pd(tf(0,0)), b = _mm256_set1_pd(tf(0,1)), c = _mm256_set1_pd(tf(0,2));
+  __m256d d = _mm256_set1_pd(tf(1,0)), e = _mm256_set1_pd(tf(1,1)), f = _mm256_set1_pd(tf(1,2));
+  for (; i + 4 <= n; i += 4) {
+    __m256d vx = _mm256_loadu_pd(x + i), vy = _mm256_loadu_pd(y + i);
+    __m256d rx = _mm256_fmadd_pd(a, vx, _mm256_fmadd_pd(b, vy, c));
+    __m256d ry = _mm256_fmadd_pd(d, vx, _mm256_fmadd_pd(e, vy, f));
+    _mm256_storeu_pd(ox + i, rx);
+    _mm256_storeu_pd(oy + i, ry);
+  }
+#endif
+  for (; i < n; i++) {
+    double px = x[i], py = y[i];
+    ox[i] = tf(0,0) * px + tf(0,1) * py + tf(0,2);
+    oy[i] = tf(1,0) * px + tf(1,1) * py + tf(1,2);
+  }
+}
+
+Eigen::Vector2d centroid(const PointCloud &cloud) {
+  size_t n = cloud.size();
+  size_t num_valid = cloud.numValid();
+  if (num_valid == 0) return Eigen::Vector2d::Zero();
+  const double *x = cloud.x(), *y = cloud.y();
+  double sx = 0, sy = 0;
+  size_t i = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+  const uint64_t *mask = cloud.validMask();
+  // Expand 4 validity bits into a lane mask, zeroing the invalid points
+  const __m256i lane_bits = _mm256_set_epi64x(8, 4, 2, 1);
+  __m256d acc_x = _mm256_setzero_pd(), acc_y = _mm256_setzero_pd();
+  for (; i + 4 <= n; i += 4) {
+    long long bits = (long long) ((mask[i / 64] >> (i % 64)) & 0xf);
+    __m256i lanes = _mm256_and_si256(_mm256_set1_epi64x(bits), lane_bits);
+    __m256d keep = _mm256_castsi256_pd(_mm256_cmpeq_epi64(lanes, lane_bits));
+    acc_x = _mm256_add_pd(acc_x, _mm256_and_pd(keep, _mm256_loadu_pd(x + i)));
+    acc_y = _mm256_add_pd(acc_y, _mm256_and_pd(keep, _mm256_loadu_pd(y + i)));
+  }
+  double lanes_x[4], lanes_y[4];
+  _mm256_storeu_pd(lanes_x, acc_x);
+  _mm256_storeu_pd(lanes_y, acc_y);
+  sx = lanes_x[0] + lanes_x[1] + lanes_x[2] + lanes_x[3];
+  sy = lanes_y[0] + lanes_y[1] + lanes_y[2] + lanes_y[3];
+#endif
+  for (; i < n; i++) {
+    if (cloud.valid(i)) {
+      sx += x[i];
+      sy += y[i];
+    }
+  }
+  return Eigen::Vector2d(sx, sy) / (double) num_valid;
+}
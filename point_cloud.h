@@ -0,0 +1,49 @@
+#ifndef POINT_CLOUD_H
+#define POINT_CLOUD_H
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <vector>
+#include "utils.h"
+
+/* Structure-of-arrays point cloud: x and y in separate contiguous arrays, plus a bitmask
+ * marking which points are valid. "No data" points (0, 0, 0) of a points_t become
+ * invalid points rather than points at the origin.
+ *
+ * The kernels below are vectorized with AVX2 and FMA when they are enabled at compile
+ * time (see ARCH in the Makefile) and fall back to scalar loops otherwise. */
+class PointCloud {
+public:
+  PointCloud();
+  explicit PointCloud(const points_t &points);
+
+  size_t size() const;
+  void resize(size_t n);
+  void push_back(double x, double y, bool valid = true);
+
+  bool valid(size_t i) const;
+  void setValid(size_t i, bool valid);
+  void clearValid();
+  size_t numValid() const;
+
+  double *x();
+  double *y();
+  const double *x() const;
+  const double *y() const;
+  // One bit per point, 64 points per word
+  uint64_t *validMask();
+  const uint64_t *validMask() const;
+
+  points_t toPoints() const;
+
+private:
+  std::vector<double> _x, _y;
+  std::vector<uint64_t> _valid;
+};
+
+// out = tf * in. Validity is copied; out may be the same cloud as in.
+void transformCloud(const transform_t &tf, const PointCloud &in, PointCloud &out);
+// Mean of the valid points; (0, 0) if there are none
+Eigen::Vector2d centroid(const PointCloud &cloud);
+
+#endif
@@ -29,25 +29,45 @@ void printRange(Graph &g, values ground_truth, int start, int end, int size) {
   }
 }
 
-void printResults(MyWindow &window, FriendlyGraph &fg,
+template <typename Traits>
+SLAMErrors evaluateSLAM(FriendlyGraph<Traits> &fg,
     const trajectory_t &true_trajectory, const points_t &true_landmarks,
     const trajectory_t &odom_trajectory, const points_t &prior_landmarks) {
   Graph &g = fg._graph;
-  int pose_size(1), lm_size(1);
-  if (IS_2D) {
-    pose_size = 3;
-    lm_size = 2;
-  }
+  int base_pose_id = (int) true_trajectory.size() - fg.getMaxNumPoses();
+  double base_pose_theta = fg.getPoseEstimate(base_pose_id)(2);
+  values ground_truth = toVector<Traits>(true_trajectory, true_landmarks,
+      fg.getMaxNumPoses(), base_pose_theta);
+  values x0 = toVector<Traits>(odom_trajectory, prior_landmarks,
+      fg.getMaxNumPoses(), base_pose_theta);
+  SLAMErrors errors;
+  // TODO maybe we should compute error in a more sophisticated way?
+  // E.g. we don't really care about absolute landmark location so much as
+  // location relative to the robot.
+  errors.initial_error = (ground_truth-x0).norm();
+  errors.smoothed_error = (ground_truth-g.solution()).norm();
+  errors.initial_potential = g.eval(x0);
+  errors.smoothed_potential = g.eval(g.solution());
+  errors.ground_truth_potential = g.eval(ground_truth);
+  return errors;
+}
+
+template <typename Traits>
+void printResults(MyWindow *window, FriendlyGraph<Traits> &fg,
+    const trajectory_t &true_trajectory, const points_t &true_landmarks,
+    const trajectory_t &odom_trajectory, const points_t &prior_landmarks) {
+  Graph &g = fg._graph;
+  int pose_size = Traits::POSE_SIZE;
+  int lm_size = Traits::LM_SIZE;
   int L = true_landmarks.size();
 
   std::cout.precision(3);
   std::cout << std::fixed;
 
   std::cout << std::showpos;
-  double base_pose_theta = g.solution()(lm_size*L + 2);
-  values ground_truth = toVector(true_trajectory, true_landmarks,
-      fg.getMaxNumPoses(), base_pose_theta);
-  values x0 = toVector(odom_trajectory, prior_landmarks,
+  int base_pose_id = (int) true_trajectory.size() - fg.getMaxNumPoses();
+  double base_pose_theta = fg.getPoseEstimate(base_pose_id)(2);
+  values ground_truth = toVector<Traits>(true_trajectory, true_landmarks,
       fg.getMaxNumPoses(), base_pose_theta);
   std::cout << std::endl << "Landmark locations:" << std::endl;
   printRange(g, ground_truth, 0, lm_size*L, lm_size);
@@ -55,23 +75,32 @@ void printResults(MyWindow &window, FriendlyGraph &fg,
   printRange(g, ground_truth, lm_size*L, ground_truth.size(), pose_size);
   std::cout << std::noshowpos;
 
-  // TODO maybe we should compute error in a more sophisticated way?
-  // E.g. we don't really care about absolute landmark location so much as
-  // location relative to the robot.
-  std::cout << std::endl << "Initial error: " << (ground_truth-x0).norm() << std::endl;
-  std::cout << "Smoothed error: " << (ground_truth-g.solution()).norm() << std::endl;
-  std::cout << "Initial potential: " << g.eval(x0) << std::endl;
-  std::cout << "Smoothed potential: " << g.eval(g.solution()) << std::endl;
-  std::cout << "Ground truth potential: " << g.eval(ground_truth) << std::endl;
+  SLAMErrors errors = evaluateSLAM<Traits>(fg, true_trajectory, true_landmarks,
+      odom_trajectory, prior_landmarks);
+  std::cout << std::endl << "Initial error: " << errors.initial_error << std::endl;
+  std::cout << "Smoothed error: " << errors.smoothed_error << std::endl;
+  std::cout << "Initial potential: " << errors.initial_potential << std::endl;
+  std::cout << "Smoothed potential: " << errors.smoothed_potential << std::endl;
+  std::cout << "Ground truth potential: " << errors.ground_truth_potential << std::endl;
 
+  if (window == nullptr) return;
   points_t smoothed_lms = fg.getLandmarkLocations();
   trajectory_t smoothed_traj = fg.getSmoothedTrajectory();
-  window.drawPoints(smoothed_lms, sf::Color::Green, 3);
-  window.drawTraj(smoothed_traj, sf::Color::Green);
-  window.display();
+  window->drawPoints(smoothed_lms, sf::Color::Green, 3);
+  window->drawTraj(smoothed_traj, sf::Color::Green);
+  window->display();
   int c = 0;
   while (c != -2) {
-    while ((c = window.pollWindowEvent()) != -1 && c != -2) {};
+    while ((c = window->pollWindowEvent()) != -1 && c != -2) {};
     usleep(100 * 1000);
   };
 }
+
+template SLAMErrors evaluateSLAM<Planar2D>(FriendlyGraph<Planar2D> &,
+    const trajectory_t &, const points_t &, const trajectory_t &, const points_t &);
+template SLAMErrors evaluateSLAM<Linear1D>(FriendlyGraph<Linear1D> &,
+    const trajectory_t &, const points_t &, const trajectory_t &, const points_t &);
+template void printResults<Planar2D>(MyWindow *, FriendlyGraph<Planar2D> &,
+    const trajectory_t &, const points_t &, const trajectory_t &, const points_t &);
+template void printResults<Linear1D>(MyWindow *, FriendlyGraph<Linear1D> &,
+    const trajectory_t &, const points_t &, const trajectory_t &, const points_t &);
@@ -5,8 +5,17 @@
 #include "friendly_graph.h"
 #include "utils.h"
 #include "graphics.h"
+#include "slam_utils.h"
 
-void printResults(MyWindow &window, FriendlyGraph &fg,
+template <typename Traits>
+SLAMErrors evaluateSLAM(FriendlyGraph<Traits> &fg,
+    const trajectory_t &true_trajectory, const points_t &true_landmarks,
+    const trajectory_t &odom_trajectory, const points_t &prior_landmarks);
+
+/* Prints the estimates next to the ground truth. If a window is given, the smoothed
+ * estimates are drawn and this waits for the window to be closed. */
+template <typename Traits>
+void printResults(MyWindow *window, FriendlyGraph<Traits> &fg,
     const trajectory_t &true_trajectory, const points_t &true_landmarks,
     const trajectory_t &odom_trajectory, const points_t &prior_landmarks);
 
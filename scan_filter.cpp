@@ -0,0 +1,129 @@
+#include "scan_filter.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+long cellCoord(double v, double cell_size) {
+  return (long) std::floor(v / cell_size);
+}
+
+// Both cell coordinates packed into one hash key (the low 32 bits of each suffice)
+uint64_t cellKey(long cx, long cy) {
+  return (uint64_t((uint32_t) cx) << 32) | uint64_t((uint32_t) cy);
+}
+
+// Moves the kept points to the front, preserving their order, and drops the rest
+void compact(points_t &scan, const std::vector<bool> &keep) {
+  size_t out = 0;
+  for (size_t i = 0; i < scan.size(); i++) {
+    if (keep[i]) scan[out++] = scan[i];
+  }
+  scan.resize(out);
+}
+
+}
+
+void rangeFilter(points_t &scan, double min_range, double max_range) {
+  double min_sq = min_range * min_range, max_sq = max_range * max_range;
+  scan.erase(std::remove_if(scan.begin(), scan.end(), [&](const point_t &p) {
+        double d = p.head<2>().squaredNorm();
+        return p(2) == 0.0 || d < min_sq || d > max_sq;
+      }), scan.end());
+}
+
+void voxelDownsample(points_t &scan, double voxel_size, VoxelSelect select) {
+  if (voxel_size <= 0.0 || scan.empty()) return;
+  // Voxels are numbered in order of their first point, so voxel k's point can be
+  // written to scan[k]: no later voxel reads a point before its first one
+  std::unordered_map<uint64_t, size_t> voxel_of;
+  voxel_of.reserve(scan.size());
+  std::vector<Eigen::Vector2d> sums;
+  std::vector<int> counts;
+  std::vector<size_t> best;
+  std::vector<double> best_dist_sq;
+  for (size_t i = 0; i < scan.size(); i++) {
+    if (scan[i](2) == 0.0) continue;
+    long cx = cellCoord(scan[i](0), voxel_size), cy = cellCoord(scan[i](1), voxel_size);
+    auto inserted = voxel_of.emplace(cellKey(cx, cy), counts.size());
+    size_t v = inserted.first->second;
+    if (inserted.second) {
+      sums.push_back(Eigen::Vector2d::Zero());
+      counts.push_back(0);
+      best.push_back(i);
+      best_dist_sq.push_back(INFINITY);
+    }
+    sums[v] += scan[i].head<2>();
+    counts[v]++;
+    Eigen::Vector2d center((cx + 0.5) * voxel_size, (cy + 0.5) * voxel_size);
+    double d = (scan[i].head<2>() - center).squaredNorm();
+    if (d < best_dist_sq[v]) {
+      best_dist_sq[v] = d;
+      best[v] = i;
+    }
+  }
+  for (size_t v = 0; v < counts.size(); v++) {
+    if (select == VoxelSelect::Centroid) {
+      Eigen::Vector2d mean = sums[v] / counts[v];
+      scan[v] = point_t(mean(0), mean(1), 1);
+    } else {
+      scan[v] = scan[best[v]];
+    }
+  }
+  scan.resize(counts.size());
+}
+
+void removeStatisticalOutliers(points_t &scan, double radius, int min_neighbours, double std_ratio) {
+  size_t n = scan.size();
+  if (radius <= 0.0 || n == 0) return;
+
+  // Bucket the points into radius-sized cells (compressed: the points of cell c are
+  // members[start[c]] .. members[start[c+1]-1]), so every neighbour of a point is in
+  // the 3x3 block of cells around it
+  std::unordered_map<uint64_t, size_t> cell_of;
+  cell_of.reserve(n);
+  std::vector<long> cx(n), cy(n);
+  std::vector<size_t> point_cell(n), start({0});
+  for (size_t i = 0; i < n; i++) {
+    cx[i] = cellCoord(scan[i](0), radius);
+    cy[i] = cellCoord(scan[i](1), radius);
+    auto inserted = cell_of.emplace(cellKey(cx[i], cy[i]), start.size() - 1);
+    if (inserted.second) start.push_back(0);
+    point_cell[i] = inserted.first->second;
+    start[point_cell[i] + 1]++;
+  }
+  for (size_t c = 1; c < start.size(); c++) start[c] += start[c - 1];
+  std::vector<size_t> members(n), fill(start.begin(), start.end() - 1);
+  for (size_t i = 0; i < n; i++) members[fill[point_cell[i]]++] = i;
+
+  std::vector<int> neighbours(n, 0);
+  double radius_sq = radius * radius;
+  for (size_t i = 0; i < n; i++) {
+    for (long dx = -1; dx <= 1; dx++) {
+      for (long dy = -1; dy <= 1; dy++) {
+        auto cell = cell_of.find(cellKey(cx[i] + dx, cy[i] + dy));
+        if (cell == cell_of.end()) continue;
+        for (size_t k = start[cell->second]; k < start[cell->second + 1]; k++) {
+          size_t j = members[k];
+          if (j != i && (scan[j] - scan[i]).head<2>().squaredNorm() <= radius_sq) neighbours[i]++;
+        }
+      }
+    }
+  }
+
+  double mean = 0.0, var = 0.0;
+  for (int count : neighbours) mean += count;
+  mean /= (double) n;
+  for (int count : neighbours) var += (count - mean) * (count - mean);
+  double threshold = std::max((double) min_neighbours, mean - std_ratio * sqrt(var / (double) n));
+  std::vector<bool> keep(n);
+  for (size_t i = 0; i < n; i++) keep[i] = neighbours[i] >= threshold;
+  compact(scan, keep);
+}
+
+void filterScan(points_t &scan, const ScanFilterParams &params) {
+  rangeFilter(scan, params.min_range, params.max_range);
+  voxelDownsample(scan, params.voxel_size, params.voxel_select);
+  removeStatisticalOutliers(scan, params.outlier_radius, params.outlier_min_neighbours,
+      params.outlier_std_ratio);
+}
@@ -0,0 +1,42 @@
+#ifndef SCAN_FILTER_H
+#define SCAN_FILTER_H
+
+#include <cmath>
+#include <cstdint>
+#include "utils.h"
+
+/* Preprocessing for lidar scans (in the robot frame, sensor at the origin) before they
+ * go to registration or rendering. Every filter works in place, keeps the surviving
+ * points in scan order (point_to_line_icp takes normals from scan neighbours) and runs
+ * in expected linear time, using a hashed grid instead of a tree. */
+
+enum class VoxelSelect : uint8_t {
+  Centroid = 0, // replace the points in a voxel by their mean
+  Nearest = 1,  // keep the point closest to the voxel center
+};
+
+struct ScanFilterParams {
+  double min_range = 0.0;         // m, closer points are dropped
+  double max_range = INFINITY;    // m, farther points are dropped
+  double voxel_size = 0.0;        // m, 0 disables downsampling
+  VoxelSelect voxel_select = VoxelSelect::Centroid;
+  double outlier_radius = 0.0;    // m, neighbourhood for outlier removal; 0 disables it
+  int outlier_min_neighbours = 1; // points with fewer neighbours are always outliers
+  double outlier_std_ratio = 2.0; // ... as are points this many std devs below the mean count
+};
+
+// Drops "no data" points and points outside [min_range, max_range] of the sensor
+void rangeFilter(points_t &scan, double min_range, double max_range);
+// Keeps one point per voxel_size x voxel_size cell; it takes the place in the scan of
+// the first point that fell in the cell. "No data" points are dropped.
+void voxelDownsample(points_t &scan, double voxel_size, VoxelSelect select = VoxelSelect::Centroid);
+/* Drops points in sparse neighbourhoods: counts the neighbours of each point within
+ * `radius` and removes the points with fewer than `min_neighbours`, or with a count more
+ * than `std_ratio` standard deviations below the mean. Linear as long as the density of
+ * the scan is bounded, e.g. after voxelDownsample. */
+void removeStatisticalOutliers(points_t &scan, double radius, int min_neighbours, double std_ratio);
+
+// All of the above, in order: range, voxel, outliers
+void filterScan(points_t &scan, const ScanFilterParams &params);
+
+#endif
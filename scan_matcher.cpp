@@ -0,0 +1,87 @@
+#include "scan_matcher.h"
+#include <cmath>
+#include <Eigen/LU>
+
+// Matches with fewer inliers than this are not trusted
+constexpr int MIN_INLIERS = 20;
+
+// The small correction that point_to_line_icp applies on the left of its transform
+static transform_t leftIncrement(const Eigen::Vector3d &delta) {
+  transform_t step;
+  step << cos(delta(2)), -sin(delta(2)), delta(0),
+          sin(delta(2)), cos(delta(2)), delta(1),
+          0, 0, 1;
+  return step;
+}
+
+ScanMatcher::ScanMatcher(double point_std, double keyframe_dist, double keyframe_angle,
+    const ICPParams &params) : _point_std(point_std), _keyframe_dist(keyframe_dist),
+    _keyframe_angle(keyframe_angle), _params(params), _keyframe(), _candidate(),
+    _pending(), _has_match(false), _match() {}
+
+void ScanMatcher::addScan(int pose_id, const points_t &scan, const transform_t &odom) {
+  if (_pending.valid()) finishMatch();
+  _candidate.pose_id = pose_id;
+  _candidate.odom = odom;
+  Keyframe keyframe = _keyframe;
+  double point_std = _point_std;
+  ICPParams params = _params;
+  _pending = std::async(std::launch::async, [=] {
+    MatchTask task;
+    task.target = std::make_shared<const ICPTarget>(scan, params.max_neighbour_gap);
+    if (!keyframe.target) return task;
+
+    // The scan is registered onto the keyframe, so ICP estimates the inverse of the
+    // relative transform
+    transform_t guess = odom * keyframe.odom.inverse();
+    ICPResult icp = point_to_line_icp(scan, *keyframe.target, guess.inverse(), params);
+    if (!icp.converged || icp.num_inliers < MIN_INLIERS ||
+        icp.hessian.determinant() <= 0) return task;
+
+    ScanMatch &m = task.match;
+    m.keyframe_id = keyframe.pose_id;
+    m.pose_id = pose_id;
+    m.rel_tf = icp.tf.inverse();
+    m.icp = icp;
+
+    // Covariance of the left correction, propagated to (x, y, theta) of rel_tf
+    // through a numerical Jacobian. The Hessian only accounts for the noise of the scan;
+    // the keyframe's points are as noisy, which doubles the variance of each residual.
+    double var = std::max(point_std * point_std, icp.rms_error * icp.rms_error);
+    Eigen::Matrix3d delta_cov = 2 * var * icp.hessian.inverse();
+    double theta = toPose(m.rel_tf, 0)(2);
+    Eigen::Matrix3d J;
+    const double eps = 1e-6;
+    for (int k = 0; k < 3; k++) {
+      Eigen::Vector3d d = Eigen::Vector3d::Zero();
+      d(k) = eps;
+      pose_t plus = toPose((leftIncrement(d) * icp.tf).inverse(), theta);
+      pose_t minus = toPose((leftIncrement(-d) * icp.tf).inverse(), theta);
+      J.col(k) = (plus - minus) / (2 * eps);
+    }
+    m.cov = J * delta_cov * J.transpose();
+    task.ok = true;
+    return task;
+  });
+}
+
+void ScanMatcher::finishMatch() {
+  MatchTask task = _pending.get();
+  _candidate.target = task.target;
+  bool new_keyframe = !task.ok;
+  if (task.ok) {
+    _match = task.match;
+    _has_match = true;
+    pose_t moved = toPose(_match.rel_tf, 0);
+    new_keyframe = moved.topRows(2).norm() > _keyframe_dist || std::abs(moved(2)) > _keyframe_angle;
+  }
+  if (new_keyframe) _keyframe = _candidate;
+}
+
+bool ScanMatcher::getMatch(ScanMatch &match) {
+  if (_pending.valid()) finishMatch();
+  if (!_has_match) return false;
+  match = _match;
+  _has_match = false;
+  return true;
+}
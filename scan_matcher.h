@@ -0,0 +1,72 @@
+#ifndef SCAN_MATCHER_H
+#define SCAN_MATCHER_H
+
+#include <future>
+#include <memory>
+#include "icp.h"
+#include "utils.h"
+
+struct ScanMatch {
+  ScanMatch() : keyframe_id(-1), pose_id(-1), rel_tf(transform_t::Identity()),
+      cov(Eigen::Matrix3d::Zero()), icp() {}
+
+  int keyframe_id;
+  int pose_id;
+  // pose_tf * keyframe_tf^-1, the same convention as odometry measurements
+  transform_t rel_tf;
+  // Covariance of toPose(rel_tf, 0) in (x, y, theta)
+  Eigen::Matrix3d cov;
+  ICPResult icp;
+};
+
+/* Lidar odometry front end. Keeps the scan of the last keyframe and registers each new
+ * scan against it with point_to_line_icp. Matching runs on a worker thread, so the caller
+ * can start a match, run FriendlyGraph::solve() and collect the result afterwards.
+ *
+ * A new scan becomes the keyframe once the robot has moved `keyframe_dist` meters or
+ * `keyframe_angle` radians away from the current one, or if matching against it failed. */
+class ScanMatcher {
+public:
+  /* point_std: standard deviation of lidar points, in meters. The match covariance is
+   *            scaled by the larger of this and the RMS error of the match, counted once
+   *            for the scan and once for the keyframe. */
+  ScanMatcher(double point_std, double keyframe_dist, double keyframe_angle,
+      const ICPParams &params = ICPParams());
+
+  /* Starts matching `scan` (taken at pose_id) against the keyframe. `odom` is the
+   * odometry reading at the time of the scan; it provides the initial guess.
+   * The first scan (or one after a failed match) just becomes the keyframe. */
+  void addScan(int pose_id, const points_t &scan, const transform_t &odom);
+  /* Waits for the last match started by addScan. Returns false if there is none or
+   * it failed. Each match is only returned once. */
+  bool getMatch(ScanMatch &match);
+
+private:
+  struct Keyframe {
+    Keyframe() : pose_id(-1), odom(transform_t::Identity()), target() {}
+    int pose_id;
+    transform_t odom;
+    std::shared_ptr<const ICPTarget> target;
+  };
+  // What the worker thread hands back: the match, and the new scan prepared as a target
+  struct MatchTask {
+    MatchTask() : ok(false), match(), target() {}
+    bool ok;
+    ScanMatch match;
+    std::shared_ptr<const ICPTarget> target;
+  };
+
+  double _point_std;
+  double _keyframe_dist;
+  double _keyframe_angle;
+  ICPParams _params;
+  Keyframe _keyframe;
+  Keyframe _candidate; // the scan being matched; becomes the keyframe if needed
+  std::future<MatchTask> _pending;
+  bool _has_match;
+  ScanMatch _match;
+
+  void finishMatch();
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include "scenario.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "serialization.h"
+
+namespace {
+
+const char SCENARIO_MAGIC[8] = {'P', 'S', 'I', 'M', 'S', 'C', 'N', '\0'};
+constexpr size_t HEADER_SIZE = sizeof(SCENARIO_MAGIC) + 2 * sizeof(uint32_t) +
+                               3 * sizeof(double) + 4 * sizeof(uint64_t);
+constexpr size_t LEG_SIZE = 2 * sizeof(int64_t) + 2 * sizeof(double);
+
+int addLandmark(Scenario &scenario, double x, double y) {
+  scenario.landmarks.push_back(point_t(x, scenario.is_2d ? y : 0.0, 1));
+  return (int) scenario.landmarks.size() - 1;
+}
+
+}
+
+bool parseScenario(std::istream &in, Scenario &scenario, std::string &error) {
+  std::string line;
+  for (int line_number = 1; std::getline(in, line); line_number++) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream words(line);
+    std::string item;
+    if (!(words >> item)) continue;
+    std::vector<double> v;
+    double x;
+    while (words >> x) v.push_back(x);
+    bool numbers_ok = words.eof();
+
+    size_t expected = 0;
+    if (item == "dimension") {
+      expected = 1;
+      if (v.size() == 1) scenario.is_2d = v[0] == 2;
+      numbers_ok = numbers_ok && v.size() == 1 && (v[0] == 1 || v[0] == 2);
+    } else if (item == "start") {
+      expected = 3;
+      if (v.size() == 3) scenario.start = pose_t(v[0], v[1], v[2]);
+    } else if (item == "obstacle") {
+      expected = v.size() >= 6 && v.size() % 2 == 0 ? v.size() : 6;
+      if (v.size() == expected) {
+        obstacle_t o((long) v.size() / 2, 2);
+        for (size_t i = 0; i < v.size() / 2; i++) {
+          o((long) i, 0) = v[2 * i];
+          o((long) i, 1) = v[2 * i + 1];
+        }
+        scenario.obstacles.push_back(o);
+      }
+    } else if (item == "landmark") {
+      expected = 2;
+      if (v.size() == 2) addLandmark(scenario, v[0], v[1]);
+    } else if (item == "post") {
+      expected = 4;
+      if (v.size() == 4) {
+        int id = addLandmark(scenario, v[0], v[1]);
+        scenario.legs.push_back(URCLeg{id, -1, {v[2], v[3], 1}});
+      }
+    } else if (item == "gate") {
+      expected = 6;
+      if (v.size() == 6) {
+        double theta = v[2], width = v[3];
+        int right_id = addLandmark(scenario, v[0] + sin(theta)*width/2, v[1] - cos(theta)*width/2);
+        int left_id = addLandmark(scenario, v[0] - sin(theta)*width/2, v[1] + cos(theta)*width/2);
+        scenario.legs.push_back(URCLeg{left_id, right_id, {v[4], v[5], 1}});
+      }
+    } else {
+      error = "line " + std::to_string(line_number) + ": unknown item '" + item + "'";
+      return false;
+    }
+    if (!numbers_ok || v.size() != expected) {
+      error = "line " + std::to_string(line_number) + ": bad numbers for '" + item + "'";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool writeScenario(const std::string &path, const Scenario &scenario) {
+  BlobWriter out;
+  for (char c : SCENARIO_MAGIC) out.write(c);
+  out.write(SCENARIO_VERSION);
+  out.write<uint32_t>(scenario.is_2d);
+  for (int i = 0; i < 3; i++) out.write(scenario.start(i));
+  uint64_t num_vertices = 0;
+  for (const obstacle_t &o : scenario.obstacles) num_vertices += (uint64_t) o.rows();
+  out.write<uint64_t>(scenario.obstacles.size());
+  out.write(num_vertices);
+  out.write<uint64_t>(scenario.landmarks.size());
+  out.write<uint64_t>(scenario.legs.size());
+
+  uint64_t offset = 0;
+  for (const obstacle_t &o : scenario.obstacles) {
+    out.write(offset);
+    offset += (uint64_t) o.rows();
+  }
+  out.write(offset);
+  for (const obstacle_t &o : scenario.obstacles) {
+    for (long i = 0; i < o.rows(); i++) {
+      out.write(o(i, 0));
+      out.write(o(i, 1));
+    }
+  }
+  for (const point_t &lm : scenario.landmarks) {
+    out.write(lm(0));
+    out.write(lm(1));
+  }
+  for (const URCLeg &leg : scenario.legs) {
+    out.write<int64_t>(leg.left_post_id);
+    out.write<int64_t>(leg.right_post_id);
+    out.write(leg.approx_GPS(0));
+    out.write(leg.approx_GPS(1));
+  }
+
+  FILE *f = fopen(path.c_str(), "wb");
+  if (f == nullptr) return false;
+  bool ok = fwrite(out.data().data(), 1, out.data().size(), f) == out.data().size();
+  return fclose(f) == 0 && ok;
+}
+
+ScenarioFile::ScenarioFile(const std::string &path)
+    : _map(nullptr), _size(0), _ok(false), _counts(nullptr), _offsets(nullptr),
+      _vertices(nullptr), _landmarks(nullptr), _legs(nullptr) {
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+    printf("Could not open scenario %s\n", path.c_str());
+    if (fd >= 0) close(fd);
+    return;
+  }
+  void *map = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    printf("Could not map scenario %s\n", path.c_str());
+    return;
+  }
+  _map = static_cast<const char *>(map);
+  _size = (size_t) st.st_size;
+  _ok = validate();
+  if (!_ok) printf("%s is not a valid scenario (version %u)\n", path.c_str(), SCENARIO_VERSION);
+}
+
+ScenarioFile::~ScenarioFile() {
+  if (_map != nullptr) munmap(const_cast<char *>(_map), _size);
+}
+
+// Checks the header, that the sections exactly fill the file, and that the obstacle
+// offsets and leg landmark ids are in range, so the accessors can trust the contents
+bool ScenarioFile::validate() {
+  if (_size < HEADER_SIZE || memcmp(_map, SCENARIO_MAGIC, sizeof(SCENARIO_MAGIC)) != 0)
+    return false;
+  uint32_t version;
+  memcpy(&version, _map + sizeof(SCENARIO_MAGIC), sizeof(version));
+  if (version != SCENARIO_VERSION) return false;
+  _counts = reinterpret_cast<const uint64_t *>(_map + HEADER_SIZE - 4 * sizeof(uint64_t));
+  uint64_t num_obstacles = _counts[0], num_vertices = _counts[1];
+  uint64_t num_landmarks = _counts[2], num_legs = _counts[3];
+  // Bounded so that the sizes below can't overflow
+  const uint64_t max_count = uint64_t(1) << 40;
+  if (num_obstacles >= max_count || num_vertices >= max_count || num_landmarks >= max_count ||
+      num_legs >= max_count)
+    return false;
+  uint64_t expected_size = HEADER_SIZE + (num_obstacles + 1) * sizeof(uint64_t) +
+                           (num_vertices + num_landmarks) * 2 * sizeof(double) +
+                           num_legs * LEG_SIZE;
+  if (expected_size != _size) return false;
+
+  _offsets = reinterpret_cast<const uint64_t *>(_map + HEADER_SIZE);
+  _vertices = reinterpret_cast<const double *>(_offsets + num_obstacles + 1);
+  _landmarks = _vertices + 2 * num_vertices;
+  _legs = reinterpret_cast<const char *>(_landmarks + 2 * num_landmarks);
+  if (_offsets[0] != 0 || _offsets[num_obstacles] != num_vertices) return false;
+  for (uint64_t i = 0; i < num_obstacles; i++) {
+    if (_offsets[i + 1] < _offsets[i] + 3) return false;
+  }
+  for (uint64_t i = 0; i < num_legs; i++) {
+    int64_t ids[2];
+    memcpy(ids, _legs + i * LEG_SIZE, sizeof(ids));
+    if (ids[0] < 0 || (uint64_t) ids[0] >= num_landmarks || ids[1] < -1 ||
+        (ids[1] >= 0 && (uint64_t) ids[1] >= num_landmarks))
+      return false;
+  }
+  return true;
+}
+
+bool ScenarioFile::ok() const {
+  return _ok;
+}
+
+bool ScenarioFile::is2D() const {
+  uint32_t is_2d;
+  memcpy(&is_2d, _map + sizeof(SCENARIO_MAGIC) + sizeof(uint32_t), sizeof(is_2d));
+  return is_2d != 0;
+}
+
+pose_t ScenarioFile::start() const {
+  const double *start = reinterpret_cast<const double *>(_map + sizeof(SCENARIO_MAGIC) +
+                                                         2 * sizeof(uint32_t));
+  return pose_t(start[0], start[1], start[2]);
+}
+
+size_t ScenarioFile::numObstacles() const {
+  return (size_t) _counts[0];
+}
+
+const uint64_t *ScenarioFile::obstacleOffsets() const {
+  return _offsets;
+}
+
+const double *ScenarioFile::vertices() const {
+  return _vertices;
+}
+
+size_t ScenarioFile::numLandmarks() const {
+  return (size_t) _counts[2];
+}
+
+const double *ScenarioFile::landmarks() const {
+  return _landmarks;
+}
+
+size_t ScenarioFile::numLegs() const {
+  return (size_t) _counts[3];
+}
+
+URCLeg ScenarioFile::leg(size_t i) const {
+  int64_t ids[2];
+  double gps[2];
+  memcpy(ids, _legs + i * LEG_SIZE, sizeof(ids));
+  memcpy(gps, _legs + i * LEG_SIZE + sizeof(ids), sizeof(gps));
+  return URCLeg{(int) ids[0], (int) ids[1], {gps[0], gps[1], 1}};
+}
@@ -0,0 +1,79 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+#include "utils.h"
+
+/* Everything that defines a world's layout: obstacles, landmarks, the URC legs (posts,
+ * gates and their GPS waypoints, by landmark id) and where the robot starts. */
+struct Scenario {
+  Scenario() : is_2d(true), start(0, 0, 0), obstacles({}), landmarks({}), legs({}) {}
+
+  bool is_2d;
+  pose_t start;
+  obstacles_t obstacles;
+  points_t landmarks;
+  std::vector<URCLeg> legs;
+};
+
+/* Reads the text form of a scenario, one item per line ('#' starts a comment):
+ *   dimension 1|2
+ *   start x y theta
+ *   obstacle x1 y1 x2 y2 x3 y3 ...
+ *   landmark x y
+ *   post x y gps_x gps_y
+ *   gate x y theta width gps_x gps_y
+ * Posts and gates add their landmarks and a leg, like World::addPost and addGate.
+ * Returns false (with the line and reason in `error`) on a malformed line. */
+bool parseScenario(std::istream &in, Scenario &scenario, std::string &error);
+
+/* The binary form is what worlds load. All sections are arrays of 8-byte aligned
+ * values, so a loaded file is used in place:
+ *   header:    "PSIMSCN\0", uint32 version, uint32 is_2d, double start x, y, theta,
+ *              uint64 obstacle, vertex, landmark and leg counts
+ *   offsets:   uint64 per obstacle + 1, the index of its first vertex
+ *   vertices:  double x, y per vertex
+ *   landmarks: double x, y per landmark
+ *   legs:      int64 left id, int64 right id (-1 for posts), double gps x, gps y
+ * Values are in the host's byte order. */
+constexpr uint32_t SCENARIO_VERSION = 1;
+bool writeScenario(const std::string &path, const Scenario &scenario);
+
+/* A memory-mapped binary scenario. Accessors point into the mapping, which lives as
+ * long as this object. */
+class ScenarioFile {
+public:
+  explicit ScenarioFile(const std::string &path);
+  ScenarioFile(const ScenarioFile &) = delete;
+  ScenarioFile &operator=(const ScenarioFile &) = delete;
+  ~ScenarioFile();
+
+  // False if the file couldn't be mapped or isn't a scenario of this version
+  bool ok() const;
+  bool is2D() const;
+  pose_t start() const;
+  size_t numObstacles() const;
+  // Obstacle i has vertices obstacleOffsets()[i] to obstacleOffsets()[i+1] - 1
+  const uint64_t *obstacleOffsets() const;
+  const double *vertices() const;  // x, y pairs
+  size_t numLandmarks() const;
+  const double *landmarks() const; // x, y pairs
+  size_t numLegs() const;
+  URCLeg leg(size_t i) const;
+
+private:
+  const char *_map;
+  size_t _size;
+  bool _ok;
+  const uint64_t *_counts;  // obstacles, vertices, landmarks, legs
+  const uint64_t *_offsets;
+  const double *_vertices, *_landmarks;
+  const char *_legs;
+
+  bool validate();
+};
+
+#endif
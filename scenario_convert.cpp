@@ -0,0 +1,49 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "scenario.h"
+#include "world.h"
+
+// Usage: scenario_convert.out <scenario.txt> <scenario.scn>
+//        scenario_convert.out --urc|--default <scenario.scn>
+// Converts the text form of a scenario (see scenario.h) to the binary form worlds load,
+// or writes out one of the built-in 2D worlds.
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cout << "Usage: " << argv[0] << " <scenario.txt> <scenario.scn>" << std::endl
+              << "       " << argv[0] << " --urc|--default <scenario.scn>" << std::endl;
+    return 1;
+  }
+  Scenario scenario;
+  if (strcmp(argv[1], "--urc") == 0 || strcmp(argv[1], "--default") == 0) {
+    World w(true, true);
+    if (strcmp(argv[1], "--urc") == 0) {
+      w.addURCObstacles();
+    } else {
+      w.addDefaultObstacles();
+      w.addDefaultLandmarks();
+    }
+    scenario.start = toPose(w.readTrueTransform(), 0.0);
+    scenario.obstacles = w.obstacles();
+    scenario.landmarks = w.trueLandmarks();
+    for (int i = 0; w.getLeg(i).left_post_id >= 0; i++) scenario.legs.push_back(w.getLeg(i));
+  } else {
+    std::ifstream in(argv[1]);
+    std::string error;
+    if (!in) {
+      std::cout << "Could not open " << argv[1] << std::endl;
+      return 1;
+    }
+    if (!parseScenario(in, scenario, error)) {
+      std::cout << argv[1] << ": " << error << std::endl;
+      return 1;
+    }
+  }
+  if (!writeScenario(argv[2], scenario)) {
+    std::cout << "Could not write " << argv[2] << std::endl;
+    return 1;
+  }
+  std::cout << scenario.obstacles.size() << " obstacles, " << scenario.landmarks.size()
+            << " landmarks, " << scenario.legs.size() << " legs" << std::endl;
+  return 0;
+}
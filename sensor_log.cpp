@@ -0,0 +1,233 @@
+#include "sensor_log.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+const char SENSOR_LOG_MAGIC[8] = {'P', 'S', 'I', 'M', 'L', 'O', 'G', '\0'};
+constexpr size_t CHUNK_HEADER_SIZE = 4 * sizeof(uint32_t);
+
+void writePoints(BlobWriter &out, const points_t &points) {
+  out.write<int32_t>((int32_t) points.size());
+  for (const point_t &p : points) {
+    out.write(p(0));
+    out.write(p(1));
+    out.write(p(2));
+  }
+}
+
+bool readPoints(BlobReader &in, points_t &points) {
+  int32_t n = 0;
+  if (!in.read(n) || n < 0) return false;
+  points.resize((size_t) n);
+  for (point_t &p : points) {
+    if (!in.read(p(0)) || !in.read(p(1)) || !in.read(p(2))) return false;
+  }
+  return true;
+}
+
+}
+
+SensorLogWriter::SensorLogWriter(const std::string &path, bool is_2d,
+                                 const points_t &true_landmarks, int records_per_chunk)
+    : _file(fopen(path.c_str(), "wb")), _records_per_chunk(records_per_chunk), _chunk(),
+      _chunk_records(0), _mutex(), _cv(), _pending(), _closing(false), _ok(_file != nullptr),
+      _writer() {
+  if (!_ok) {
+    printf("Could not create sensor log %s\n", path.c_str());
+    return;
+  }
+  BlobWriter header;
+  for (char c : SENSOR_LOG_MAGIC) header.write(c);
+  header.write(SENSOR_LOG_VERSION);
+  header.write<uint8_t>(is_2d);
+  writePoints(header, true_landmarks);
+  _ok = fwrite(header.data().data(), 1, header.data().size(), _file) == header.data().size();
+  _writer = std::thread([this] { writeLoop(); });
+}
+
+SensorLogWriter::~SensorLogWriter() {
+  close();
+}
+
+void SensorLogWriter::record(const SensorReading &reading) {
+  if (_file == nullptr) return;
+  _chunk.write<uint8_t>((uint8_t) reading.type);
+  _chunk.write(reading.stamp);
+  writePoints(_chunk, reading.points);
+  _chunk.writeMatrix(reading.transform);
+  _chunk.writeMatrix(reading.truth);
+  if (++_chunk_records >= _records_per_chunk) flushChunk();
+}
+
+void SensorLogWriter::flushChunk() {
+  if (_chunk_records == 0) return;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pending.emplace_back(_chunk.data(), _chunk_records);
+  }
+  _cv.notify_one();
+  _chunk = BlobWriter();
+  _chunk_records = 0;
+}
+
+void SensorLogWriter::close() {
+  if (_file == nullptr) return;
+  flushChunk();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closing = true;
+  }
+  _cv.notify_one();
+  if (_writer.joinable()) _writer.join();
+  if (fclose(_file) != 0) _ok = false;
+  _file = nullptr;
+}
+
+bool SensorLogWriter::ok() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _ok;
+}
+
+// Compresses and writes chunks in the order they were filled, until closed
+void SensorLogWriter::writeLoop() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true) {
+    _cv.wait(lock, [this] { return _closing || !_pending.empty(); });
+    if (_pending.empty()) return;
+    std::pair<std::string, int> chunk = std::move(_pending.front());
+    _pending.pop_front();
+    lock.unlock();
+
+    const std::string &raw = chunk.first;
+    uLongf compressed_size = compressBound(raw.size());
+    std::string compressed(compressed_size, '\0');
+    bool written = compress2(reinterpret_cast<Bytef *>(&compressed[0]), &compressed_size,
+                             reinterpret_cast<const Bytef *>(raw.data()), raw.size(),
+                             Z_BEST_SPEED) == Z_OK;
+    if (written) {
+      BlobWriter header;
+      header.write((uint32_t) raw.size());
+      header.write((uint32_t) compressed_size);
+      header.write((uint32_t) crc32(0L, reinterpret_cast<const Bytef *>(compressed.data()),
+                                    (uInt) compressed_size));
+      header.write((uint32_t) chunk.second);
+      written = fwrite(header.data().data(), 1, header.data().size(), _file) ==
+                    header.data().size() &&
+                fwrite(compressed.data(), 1, compressed_size, _file) == compressed_size;
+    }
+
+    lock.lock();
+    if (!written) _ok = false;
+  }
+}
+
+SensorLogReader::SensorLogReader(const std::string &path)
+    : _map(nullptr), _size(0), _offset(0), _ok(false), _is_2d(true), _true_landmarks(),
+      _chunk(), _records(), _chunk_records(0) {
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+    printf("Could not open sensor log %s\n", path.c_str());
+    if (fd >= 0) ::close(fd);
+    return;
+  }
+  void *map = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    printf("Could not map sensor log %s\n", path.c_str());
+    return;
+  }
+  _map = static_cast<const char *>(map);
+  _size = (size_t) st.st_size;
+  _ok = readHeader();
+  if (!_ok) printf("%s is not a sensor log (version %u)\n", path.c_str(), SENSOR_LOG_VERSION);
+}
+
+SensorLogReader::~SensorLogReader() {
+  if (_map != nullptr) munmap(const_cast<char *>(_map), _size);
+}
+
+bool SensorLogReader::ok() const {
+  return _ok;
+}
+
+bool SensorLogReader::is2D() const {
+  return _is_2d;
+}
+
+const points_t &SensorLogReader::trueLandmarks() const {
+  return _true_landmarks;
+}
+
+bool SensorLogReader::readHeader() {
+  // Only the header's own bytes go through a BlobReader; chunks are read in place
+  size_t fixed_size = sizeof(SENSOR_LOG_MAGIC) + sizeof(uint32_t) + sizeof(uint8_t) +
+                      sizeof(int32_t);
+  if (_size < fixed_size) return false;
+  int32_t num_landmarks = 0;
+  memcpy(&num_landmarks, _map + fixed_size - sizeof(int32_t), sizeof(int32_t));
+  if (num_landmarks < 0) return false;
+  size_t header_size = fixed_size + (size_t) num_landmarks * 3 * sizeof(double);
+  if (_size < header_size) return false;
+  std::string header(_map, header_size);
+  BlobReader in(header);
+  char magic[sizeof(SENSOR_LOG_MAGIC)];
+  for (char &c : magic) in.read(c);
+  uint32_t version = 0;
+  uint8_t is_2d = 0;
+  in.read(version);
+  in.read(is_2d);
+  bool ok = readPoints(in, _true_landmarks) && in.ok() && in.atEnd() &&
+            memcmp(magic, SENSOR_LOG_MAGIC, sizeof(magic)) == 0 &&
+            version == SENSOR_LOG_VERSION;
+  _is_2d = is_2d != 0;
+  _offset = header_size;
+  return ok;
+}
+
+bool SensorLogReader::next(SensorReading &reading) {
+  if (!_ok) return false;
+  while (_chunk_records == 0) {
+    if (!readChunk()) return false;
+  }
+  uint8_t type = 0;
+  _records->read(type);
+  _records->read(reading.stamp);
+  readPoints(*_records, reading.points);
+  _records->readMatrix(reading.transform);
+  _records->readMatrix(reading.truth);
+  _chunk_records--;
+  if (!_records->ok() || type >= NUM_SENSOR_TYPES || (_chunk_records == 0 && !_records->atEnd())) {
+    _ok = false;
+    return false;
+  }
+  reading.type = SensorType(type);
+  return true;
+}
+
+// Decompresses the chunk at _offset. A chunk cut short by the end of the file is the
+// end of the log; any other damage makes the reader fail.
+bool SensorLogReader::readChunk() {
+  if (_offset + CHUNK_HEADER_SIZE > _size) return false;
+  uint32_t header[4];
+  memcpy(header, _map + _offset, sizeof(header));
+  uint32_t raw_size = header[0], compressed_size = header[1], crc = header[2];
+  if (_offset + CHUNK_HEADER_SIZE + compressed_size > _size) return false;
+  const Bytef *compressed = reinterpret_cast<const Bytef *>(_map + _offset + CHUNK_HEADER_SIZE);
+  _chunk.assign(raw_size, '\0');
+  uLongf size = raw_size;
+  if (crc32(0L, compressed, compressed_size) != crc ||
+      uncompress(reinterpret_cast<Bytef *>(&_chunk[0]), &size, compressed, compressed_size) != Z_OK ||
+      size != raw_size) {
+    _ok = false;
+    return false;
+  }
+  _records.reset(new BlobReader(_chunk));
+  _chunk_records = (int) header[3];
+  _offset += CHUNK_HEADER_SIZE + compressed_size;
+  return true;
+}
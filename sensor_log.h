@@ -0,0 +1,91 @@
+#ifndef SENSOR_LOG_H
+#define SENSOR_LOG_H
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "sensor_reading.h"
+#include "serialization.h"
+
+/* A sensor log is an append-only binary file of SensorReadings, so a run can be fed to
+ * an estimator again with exactly the same inputs. Layout (host byte order, like
+ * BlobWriter):
+ *   header: "PSIMLOG\0", uint32 version, uint8 is_2d, then the ground truth landmarks
+ *           (int32 count, then x, y, 1 for each)
+ *   chunks: uint32 raw size, uint32 compressed size, uint32 crc32 of the compressed
+ *           bytes, uint32 record count, then the zlib-compressed records
+ *   record: uint8 type, double stamp, int32 point count, the points (x, y, w), then the
+ *           transform and truth (column-major)
+ * Chunks are only written whole, so the log of a run that was killed ends cleanly at
+ * its last complete chunk. */
+constexpr uint32_t SENSOR_LOG_VERSION = 1;
+
+/* Records readings into a sensor log. record() only serializes into the current chunk;
+ * full chunks are compressed and written by a background thread, so recording stays
+ * cheap for the thread that produces the readings. Use from one thread at a time. */
+class SensorLogWriter {
+public:
+  SensorLogWriter(const std::string &path, bool is_2d, const points_t &true_landmarks,
+                  int records_per_chunk = 64);
+  SensorLogWriter(const SensorLogWriter &) = delete;
+  SensorLogWriter &operator=(const SensorLogWriter &) = delete;
+  ~SensorLogWriter();
+
+  void record(const SensorReading &reading);
+  // Writes the last (partial) chunk and waits until everything is on disk
+  void close();
+  // False if the file couldn't be created or a write failed
+  bool ok();
+
+private:
+  FILE *_file;
+  int _records_per_chunk;
+  BlobWriter _chunk;
+  int _chunk_records;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::deque<std::pair<std::string, int>> _pending;  // full chunks and their record counts
+  bool _closing;
+  bool _ok;
+  std::thread _writer;
+
+  void flushChunk();
+  void writeLoop();
+};
+
+/* Reads a sensor log back. The file is memory-mapped and decompressed a chunk at a
+ * time. */
+class SensorLogReader {
+public:
+  explicit SensorLogReader(const std::string &path);
+  SensorLogReader(const SensorLogReader &) = delete;
+  SensorLogReader &operator=(const SensorLogReader &) = delete;
+  ~SensorLogReader();
+
+  // False if the file couldn't be mapped, or its header or a chunk is damaged
+  bool ok() const;
+  bool is2D() const;
+  const points_t &trueLandmarks() const;
+  // The next reading; false at the end of the log or at a damaged chunk
+  bool next(SensorReading &reading);
+
+private:
+  const char *_map;
+  size_t _size;
+  size_t _offset;  // of the next chunk
+  bool _ok;
+  bool _is_2d;
+  points_t _true_landmarks;
+  std::string _chunk;
+  std::unique_ptr<BlobReader> _records;
+  int _chunk_records;  // still to read from _chunk
+
+  bool readHeader();
+  bool readChunk();
+};
+
+#endif
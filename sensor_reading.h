@@ -0,0 +1,23 @@
+#ifndef SENSOR_READING_H
+#define SENSOR_READING_H
+
+#include "utils.h"
+
+/* Measurements the World's sensor scheduler delivers (see World::subscribe) and
+ * sensor logs store (see sensor_log.h) */
+enum SensorType { LIDAR_SENSOR = 0, LANDMARK_SENSOR, GPS_SENSOR, ODOM_SENSOR, NUM_SENSOR_TYPES };
+
+struct SensorReading {
+  SensorReading(SensorType type = LIDAR_SENSOR, double stamp = 0.0, const points_t &points = {},
+                const transform_t &transform = transform_t::Zero(),
+                const transform_t &truth = transform_t::Identity())
+      : type(type), stamp(stamp), points(points), transform(transform), truth(truth) {}
+
+  SensorType type;
+  double stamp;           // simulated time the reading was taken
+  points_t points;        // lidar hits or landmark readings, in the robot frame
+  transform_t transform;  // GPS fix or odometry
+  transform_t truth;      // ground truth transform when taken
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/* Holds a plain value that one thread updates and any number of threads read, without
+ * locks. A reader copies the value and retries if a store overlapped the copy, so it
+ * always gets a value that was stored as a whole; the writer never waits.
+ * Only one thread may call store() at a time. The value is kept in atomic words, so
+ * concurrent reads and stores are not a data race. */
+template <typename T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock can only hold plain values");
+
+public:
+  explicit SeqLock(const T &value = T()) : _seq(0), _words() {
+    store(value);
+  }
+
+  void store(const T &value) {
+    std::array<uint64_t, WORDS> buf{};
+    std::memcpy(buf.data(), &value, sizeof(T));
+    uint64_t seq = _seq.load(std::memory_order_relaxed);
+    _seq.store(seq + 1, std::memory_order_relaxed); // odd: store in progress
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++) _words[i].store(buf[i], std::memory_order_relaxed);
+    _seq.store(seq + 2, std::memory_order_release);
+  }
+
+  T load() const {
+    std::array<uint64_t, WORDS> buf;
+    uint64_t before, after;
+    do {
+      before = _seq.load(std::memory_order_acquire);
+      for (size_t i = 0; i < WORDS; i++) buf[i] = _words[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = _seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    T value;
+    std::memcpy(&value, buf.data(), sizeof(T));
+    return value;
+  }
+
+private:
+  static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  std::atomic<uint64_t> _seq;
+  std::array<std::atomic<uint64_t>, WORDS> _words;
+};
+
+#endif
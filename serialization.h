@@ -0,0 +1,77 @@
+#ifndef SERIALIZATION_H
+#define SERIALIZATION_H
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+/* Appends values to a compact binary blob. Values are stored as raw bytes in the host's
+ * representation, so blobs are only meant to be read back on the same kind of machine
+ * (e.g. checkpoints of a running process). */
+class BlobWriter {
+public:
+  BlobWriter() : _data() {}
+
+  template <typename T>
+  void write(const T &v) {
+    static_assert(std::is_trivially_copyable<T>::value, "can only write plain values");
+    _data.append(reinterpret_cast<const char *>(&v), sizeof(T));
+  }
+
+  template <typename Derived>
+  void writeMatrix(const Eigen::MatrixBase<Derived> &m) {
+    typename Derived::PlainObject plain = m;
+    write<int32_t>((int32_t) plain.rows());
+    write<int32_t>((int32_t) plain.cols());
+    _data.append(reinterpret_cast<const char *>(plain.data()),
+        sizeof(typename Derived::Scalar) * (size_t) plain.size());
+  }
+
+  const std::string &data() const { return _data; }
+
+private:
+  std::string _data;
+};
+
+/* Reads back what a BlobWriter wrote. Reading past the end (or a matrix of the wrong
+ * fixed size) puts the reader in a failed state; check `ok()` once at the end. */
+class BlobReader {
+public:
+  explicit BlobReader(const std::string &blob) : _data(blob), _pos(0), _ok(true) {}
+
+  template <typename T>
+  bool read(T &v) {
+    static_assert(std::is_trivially_copyable<T>::value, "can only read plain values");
+    if (!_ok || _pos + sizeof(T) > _data.size()) return _ok = false;
+    std::memcpy(&v, _data.data() + _pos, sizeof(T));
+    _pos += sizeof(T);
+    return true;
+  }
+
+  template <typename Derived>
+  bool readMatrix(Eigen::PlainObjectBase<Derived> &m) {
+    int32_t rows = 0, cols = 0;
+    if (!read(rows) || !read(cols) || rows < 0 || cols < 0) return _ok = false;
+    if ((Derived::RowsAtCompileTime != Eigen::Dynamic && Derived::RowsAtCompileTime != rows) ||
+        (Derived::ColsAtCompileTime != Eigen::Dynamic && Derived::ColsAtCompileTime != cols))
+      return _ok = false;
+    size_t bytes = sizeof(typename Derived::Scalar) * (size_t) rows * (size_t) cols;
+    if (_pos + bytes > _data.size()) return _ok = false;
+    m.resize(rows, cols);
+    std::memcpy(m.data(), _data.data() + _pos, bytes);
+    _pos += bytes;
+    return true;
+  }
+
+  bool ok() const { return _ok; }
+  bool atEnd() const { return _pos == _data.size(); }
+
+private:
+  const std::string &_data;
+  size_t _pos;
+  bool _ok;
+};
+
+#endif
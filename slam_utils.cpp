@@ -1,5 +1,10 @@
 
 #include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
 #include <Eigen/Core>
 #include <Eigen/LU>
 #include "print_results.h"
@@ -7,114 +12,383 @@
 #include "utils.h"
 #include "graph.h"
 #include "friendly_graph.h"
+#include "scan_matcher.h"
+#include "scan_filter.h"
+#include "occupancy_grid.h"
+#include "sensor_log.h"
 #include "graphics.h"
 #include "world.h"
 #include "constants.h"
 
 using namespace NavSim;
 
+template <typename Traits>
 values toVector(const trajectory_t &traj, const points_t &r, int max_num_poses, double prev_theta) {
   int num_extra_poses = (int) traj.size() - max_num_poses;
   int L = (int) r.size();
-  int pose_size(1), lm_size(1);
-  if (IS_2D) {
-    pose_size = 3;
-    lm_size = 2;
-  }
+  int pose_size = Traits::POSE_SIZE;
+  int lm_size = Traits::LM_SIZE;
   int N = lm_size*L + pose_size*max_num_poses;
   values v = values::Zero(N);
-  printf("Vectorizing trajectory and landmarks to dimension %ld\n", v.size());
   for (int i = 0; i < L; i++) {
     v.block(lm_size*i, 0, lm_size, 1) = r[(size_t)i].topRows(lm_size);
   }
   for (int i = 0; i < max_num_poses; i++) {
     transform_t trf = traj[(size_t)(i+num_extra_poses)];
-    pose_t p = toPose(trf, prev_theta);
-    v.block(lm_size*L + pose_size*i,0,pose_size,1) = p.topRows(pose_size);
-    prev_theta = p(2);
+    v.block(lm_size*L + pose_size*i,0,pose_size,1) = Traits::toState(trf, prev_theta);
+    prev_theta = toPose(trf, prev_theta)(2);
   }
   return v;
 }
 
-void collectDataAndRunSLAM() {
-  constexpr int T = 30;
-  points_t prior_landmarks({
-      {0,0,1},
-      {0,0,1},
-      {0,0,1},
-      {0,0,1},
-      {0,0,1},
-      {0,0,1}});
-  int L = (int)prior_landmarks.size();
-
-  traj_points_t landmark_readings({});
-  trajectory_t ground_truth({});
-  trajectory_t odom_traj({});
-  trajectory_t gps_traj({});
-
-  transform_t start_pose_guess = toTransform({13,-1,M_PI*2/3});
-  transform_t odom_accumulated_guess = start_pose_guess;
-
-  FriendlyGraph fg(L, 10, 0.3, 3.0, 0.05);
+// What a SLAM run recorded, besides the graph itself
+struct SLAMRun {
+  SLAMRun() : prior_landmarks({}), landmark_readings({}), ground_truth({}), odom_traj({}),
+      gps_traj({}), map(0.1 * ROBOT_LENGTH) {}
+
+  points_t prior_landmarks;
+  traj_points_t landmark_readings;
+  trajectory_t ground_truth;
+  trajectory_t odom_traj;
+  trajectory_t gps_traj;
+  OccupancyGrid map; // from the lidar (2D only)
+};
+
+// The readings SLAM takes at one pose, all stamped with the time of the pose
+struct SLAMFrame {
+  SLAMFrame() : stamp(0.0), landmarks({}), odom(transform_t::Identity()),
+      gps(transform_t::Zero()), scan({}), truth(transform_t::Identity()) {}
+
+  double stamp;
+  points_t landmarks;
+  transform_t odom;
+  transform_t gps;  // zero if there was no fix
+  points_t scan;    // 2D only
+  transform_t truth;
+};
+
+template <typename Traits>
+SLAMFrame readFrame(World &w) {
+  SLAMFrame frame;
+  frame.stamp = w.time();
+  frame.landmarks = w.readLandmarks();
+  frame.odom = w.readOdom();
+  frame.gps = w.readGPS();
+  if (Traits::IS_2D) frame.scan = w.readLidar();
+  frame.truth = w.readTrueTransform();
+  return frame;
+}
+
+void logFrame(SensorLogWriter &log, const SLAMFrame &frame) {
+  log.record(SensorReading{LANDMARK_SENSOR, frame.stamp, frame.landmarks,
+                           transform_t::Zero(), frame.truth});
+  log.record(SensorReading{ODOM_SENSOR, frame.stamp, {}, frame.odom, frame.truth});
+  if (frame.gps.norm() != 0.0) {
+    log.record(SensorReading{GPS_SENSOR, frame.stamp, {}, frame.gps, frame.truth});
+  }
+  if (!frame.scan.empty()) {
+    log.record(SensorReading{LIDAR_SENSOR, frame.stamp, frame.scan, transform_t::Zero(),
+                             frame.truth});
+  }
+}
+
+// Feeds the frames of one run to `fg`, one pose per frame, solving after each
+template <typename Traits>
+class SLAMSession {
+public:
+  SLAMSession(FriendlyGraph<Traits> &fg, SLAMRun &run, int num_landmarks);
+
+  void addFrame(const SLAMFrame &frame);
+  // Adds the match of the last frame's scan, if any, and solves once more
+  void finish();
+
+private:
+  FriendlyGraph<Traits> &fg_;
+  SLAMRun &run_;
+  int L_;
+  int pose_id_;
+  ScanMatcher matcher_;
+  ScanFilterParams scan_filter_;
+  transform_t prev_odom_;
+  transform_t odom_accumulated_guess_;
+
+  void addPriors(const transform_t &start_truth);
+  bool addScanMatch();
+};
+
+// Lidar odometry (2D only). Each scan is matched while the graph is solved, and the
+// result is added before the next solve. Without obstacles the lidar only sees the
+// landmarks, which is too little to match against, so this only kicks in for worlds
+// with some structure.
+ICPParams sessionICPParams() {
+  ICPParams icp_params;
+  icp_params.max_correspondence_dist = 0.3 * ROBOT_LENGTH; // odometry is a good initial guess
+  return icp_params;
+}
+
+template <typename Traits>
+SLAMSession<Traits>::SLAMSession(FriendlyGraph<Traits> &fg, SLAMRun &run, int num_landmarks)
+    : fg_(fg), run_(run), L_(num_landmarks), pose_id_(0),
+      matcher_(CORRUPTION_STD * sqrt(LIDAR_MAX_RANGE), ROBOT_LENGTH, M_PI / 8, sessionICPParams()),
+      scan_filter_(), prev_odom_(transform_t::Identity()),
+      odom_accumulated_guess_(transform_t::Identity()) {
+  run_.prior_landmarks.assign((size_t)L_, point_t(0,0,1));
+  // Scans are thinned and cleaned of isolated hits before matching
+  scan_filter_.min_range = LIDAR_MIN_RANGE;
+  scan_filter_.max_range = LIDAR_MAX_RANGE;
+  scan_filter_.voxel_size = 0.1 * ROBOT_LENGTH;
+  scan_filter_.outlier_radius = 0.5 * ROBOT_LENGTH;
+}
+
+template <typename Traits>
+void SLAMSession<Traits>::addPriors(const transform_t &start_truth) {
+  // Informed (but deliberately wrong) guess of the start pose
+  pose_t start_offset(-2, -1, -M_PI/3);
+  transform_t start_pose_guess = Traits::toTransform(
+      Traits::toState(toTransform(toPose(start_truth, 0) + start_offset), 0));
+  odom_accumulated_guess_ = start_pose_guess;
+
   float prior_xy_std = 3.0;
   float prior_th_std = 1.0;
-  covariance<3> prior_cov = covariance<3>::Zero();
-  prior_cov << prior_xy_std * prior_xy_std, 0, 0,
-               0, prior_xy_std * prior_xy_std, 0,
-               0, 0, prior_th_std * prior_th_std;
-  fg.addPosePrior(0, start_pose_guess, prior_cov); // informed prior
-  for (int l = 0; l < L; l++) {
+  pose_t prior_var(prior_xy_std * prior_xy_std, prior_xy_std * prior_xy_std,
+                   prior_th_std * prior_th_std);
+  covariance<Traits::POSE_SIZE> prior_cov =
+      prior_var.topRows(Traits::POSE_SIZE).asDiagonal();
+  fg_.addPosePrior(0, start_pose_guess, prior_cov); // informed prior
+  for (int l = 0; l < L_; l++) {
     point_t location({0,0,1});
-    fg.addLandmarkPrior(l, location, 20.0); // uninformative prior
+    fg_.addLandmarkPrior(l, location, 20.0); // uninformative prior
   }
+}
 
-  World w;
-  w.addDefaultLandmarks();
+// Waits for the match started with the previous scan and adds it to the graph
+template <typename Traits>
+bool SLAMSession<Traits>::addScanMatch() {
+  ScanMatch match;
+  if (!Traits::IS_2D || !matcher_.getMatch(match)) return false;
+  return fg_.addRelativePoseMeasurement(match.pose_id, match.keyframe_id, match.rel_tf,
+      match.cov.topLeftCorner<Traits::POSE_SIZE, Traits::POSE_SIZE>());
+}
+
+template <typename Traits>
+void SLAMSession<Traits>::addFrame(const SLAMFrame &frame) {
+  int pose_id = pose_id_++;
+  if (pose_id == 0) {
+    addPriors(frame.truth);
+    prev_odom_ = frame.odom;
+  }
+  addScanMatch();
+  run_.landmark_readings.push_back(frame.landmarks);
+  for (int lm_id = 0; lm_id < L_; lm_id++) {
+    point_t lm = frame.landmarks[(size_t)lm_id];
+    if (lm(2) != 0.0) fg_.addLandmarkMeasurement(pose_id, lm_id, lm);
+  }
+  if (pose_id > 0) {
+    fg_.addOdomMeasurement(pose_id, pose_id-1, frame.odom, prev_odom_);
+    odom_accumulated_guess_ = frame.odom * prev_odom_.inverse() * odom_accumulated_guess_;
+    prev_odom_ = frame.odom;
+  }
+  run_.odom_traj.push_back(odom_accumulated_guess_);
+  if (frame.gps.norm() != 0.0) {
+    run_.gps_traj.push_back(frame.gps);
+    fg_.addGPSMeasurement(pose_id, frame.gps);
+  }
+
+  if (Traits::IS_2D) {
+    points_t scan = frame.scan;
+    filterScan(scan, scan_filter_);
+    matcher_.addScan(pose_id, scan, prev_odom_);
+  }
+  run_.ground_truth.push_back(frame.truth);
+  fg_.solve();
+  // Each scan is mapped from the estimate of its pose right after solving, as an
+  // online mapper would; later corrections to that pose don't move it
+  if (Traits::IS_2D) run_.map.addScan(toTransform(fg_.getPoseEstimate(pose_id)), frame.scan);
+}
+
+template <typename Traits>
+void SLAMSession<Traits>::finish() {
+  if (addScanMatch()) fg_.solve();
+}
+
+// Drives the robot through `w`, feeding the readings at each of T+1 poses to `fg` (and
+// to `log`, if given). A headless (lockstep) world is stepped between poses; otherwise
+// this sleeps while the simulation thread moves the robot.
+template <typename Traits>
+void runSLAM(World &w, FriendlyGraph<Traits> &fg, bool headless, SLAMRun &run,
+             SensorLogWriter *log = nullptr) {
+  constexpr int T = 30;
+  SLAMSession<Traits> session(fg, run, (int)w.trueLandmarks().size());
   w.start();
-  transform_t prev_odom = w.readOdom();
   for (int pose_id = 0; pose_id < T+1; pose_id++) {
-    points_t lm_reading = w.readLandmarks();
-    landmark_readings.push_back(lm_reading);
-    for (int lm_id = 0; lm_id < L; lm_id++) {
-      point_t lm = lm_reading[(size_t)lm_id];
-      if (lm(2) != 0.0) fg.addLandmarkMeasurement(pose_id, lm_id, lm);
+    SLAMFrame frame = readFrame<Traits>(w);
+    if (log != nullptr) logFrame(*log, frame);
+    session.addFrame(frame);
+    if (pose_id == 0) w.setCmdVel(0.0, ROBOT_LENGTH);
+    if (headless) {
+      w.step(0.498);
+    } else {
+      // Make this "relatively prime" with 1000 * 1000 to avoid randomness
+      // due to context switching. (Less randomness == good for debugging.)
+      usleep(498 * 1000);
     }
-    if (pose_id > 0) {
-      transform_t odom = w.readOdom();
-      fg.addOdomMeasurement(pose_id, pose_id-1, odom, prev_odom);
-      odom_accumulated_guess = odom * prev_odom.inverse() * odom_accumulated_guess;
-      prev_odom = odom;
+  }
+  session.finish();
+  w.setCmdVel(0.0, 0.0);
+}
+
+template <typename Traits>
+void collectDataAndRunSLAM(bool headless, const std::string &log_path) {
+  World w(Traits::IS_2D, headless);
+  w.addDefaultLandmarks();
+  FriendlyGraph<Traits> fg((int)w.trueLandmarks().size(), 10, 0.3, 3.0, 0.05);
+  SLAMRun run;
+  std::unique_ptr<SensorLogWriter> log;
+  if (!log_path.empty()) log.reset(new SensorLogWriter(log_path, Traits::IS_2D, w.trueLandmarks()));
+  runSLAM<Traits>(w, fg, headless, run, log.get());
+  if (log) {
+    log->close();
+    if (!log->ok()) printf("Writing sensor log %s failed\n", log_path.c_str());
+  }
+  const traj_points_t &landmark_readings = run.landmark_readings;
+  const trajectory_t &ground_truth = run.ground_truth;
+  const trajectory_t &odom_traj = run.odom_traj;
+  const trajectory_t &gps_traj = run.gps_traj;
+
+  std::unique_ptr<MyWindow> window;
+  if (!headless) {
+    window.reset(new MyWindow("SLAM visualization", Traits::IS_2D));
+    window->display();
+    window->drawTraj(gps_traj, sf::Color::Red);
+    window->drawTraj(odom_traj, sf::Color::Blue);
+    window->drawPoints(landmark_readings[0], sf::Color::Blue, 3);
+    window->drawPoints(run.map.occupiedCells(), sf::Color(128,128,128), 2);
+    window->drawTraj(ground_truth, sf::Color::Black);
+    window->drawPoints(w.trueLandmarks(), sf::Color::Black, 3);
+    window->display();
+    window->drawTraj(gps_traj, sf::Color::Red);
+    window->drawTraj(odom_traj, sf::Color::Blue);
+    window->drawPoints(landmark_readings[0], sf::Color::Blue, 3);
+    window->drawPoints(run.map.occupiedCells(), sf::Color(128,128,128), 2);
+    window->drawTraj(ground_truth, sf::Color::Black);
+    window->drawPoints(w.trueLandmarks(), sf::Color::Black, 3);
+  }
+
+  printResults<Traits>(window.get(), fg, ground_truth, w.trueLandmarks(), odom_traj,
+      run.prior_landmarks);
+}
+
+template <typename Traits>
+bool replaySLAM(const std::string &log_path, double speed) {
+  SensorLogReader log(log_path);
+  if (!log.ok()) return false;
+  if (log.is2D() != Traits::IS_2D) {
+    printf("%s is a %dD log\n", log_path.c_str(), log.is2D() ? 2 : 1);
+    return false;
+  }
+  int L = (int)log.trueLandmarks().size();
+  FriendlyGraph<Traits> fg(L, 10, 0.3, 3.0, 0.05);
+  SLAMRun run;
+  SLAMSession<Traits> session(fg, run, L);
+
+  // Consecutive readings with the same stamp make up one frame
+  auto wall_start = std::chrono::steady_clock::now();
+  double first_stamp = 0.0;
+  int num_frames = 0;
+  SLAMFrame frame;
+  SensorReading reading;
+  bool more = log.next(reading);
+  while (more) {
+    frame = SLAMFrame();
+    frame.stamp = reading.stamp;
+    frame.truth = reading.truth;
+    for (; more && reading.stamp == frame.stamp; more = log.next(reading)) {
+      switch (reading.type) {
+        case LANDMARK_SENSOR: frame.landmarks = reading.points; break;
+        case ODOM_SENSOR: frame.odom = reading.transform; break;
+        case GPS_SENSOR: frame.gps = reading.transform; break;
+        case LIDAR_SENSOR: frame.scan = reading.points; break;
+        case NUM_SENSOR_TYPES: break;
+      }
     }
-    odom_traj.push_back(odom_accumulated_guess);
-    transform_t gps = w.readGPS();
-    if (gps.norm() != 0.0) {
-      gps_traj.push_back(gps);
-      fg.addGPSMeasurement(pose_id, gps);
+    if (frame.landmarks.size() != (size_t)L) break; // not a frame SLAM logged
+    if (num_frames++ == 0) first_stamp = frame.stamp;
+    if (speed > 0) {
+      std::this_thread::sleep_until(wall_start + std::chrono::duration<double>(
+          (frame.stamp - first_stamp) / speed));
     }
-
-    ground_truth.push_back(w.readTrueTransform());
-    if (pose_id == 0) w.setCmdVel(0.0, ROBOT_LENGTH);
-    fg.solve();
-    // Make this "relatively prime" with 1000 * 1000 to avoid randomness
-    // due to context switching. (Less randomness == good for debugging.)
-    usleep(498 * 1000);
+    session.addFrame(frame);
   }
-  w.setCmdVel(0.0, 0.0);
+  session.finish();
+  if (!log.ok()) printf("Sensor log %s is damaged after %d frames\n", log_path.c_str(), num_frames);
+  if (num_frames == 0) return false;
+
+  printResults<Traits>(nullptr, fg, run.ground_truth, log.trueLandmarks(), run.odom_traj,
+      run.prior_landmarks);
+  return true;
+}
+
+template <typename Traits>
+SLAMErrors runSLAMTrial(uint64_t seed, uint32_t run_id) {
+  World w(Traits::IS_2D, true);
+  w.useRandomStreams(seed, run_id);
+  w.addDefaultLandmarks();
+  FriendlyGraph<Traits> fg((int)w.trueLandmarks().size(), 10, 0.3, 3.0, 0.05);
+  fg._graph.setVerbose(false);
+  SLAMRun run;
+  runSLAM<Traits>(w, fg, true, run);
+  return evaluateSLAM<Traits>(fg, run.ground_truth, w.trueLandmarks(), run.odom_traj,
+      run.prior_landmarks);
+}
+
+namespace {
+
+// Whether the whole of `arg` is a number
+bool isNumber(const char *arg) {
+  char *end = nullptr;
+  strtod(arg, &end);
+  return end != arg && *end == '\0';
+}
 
-  MyWindow window("SLAM visualization");
-  window.display();
-  window.drawTraj(gps_traj, sf::Color::Red);
-  window.drawTraj(odom_traj, sf::Color::Blue);
-  window.drawPoints(landmark_readings[0], sf::Color::Blue, 3);
-  window.drawTraj(ground_truth, sf::Color::Black);
-  window.drawPoints(w.trueLandmarks(), sf::Color::Black, 3);
-  window.display();
-  window.drawTraj(gps_traj, sf::Color::Red);
-  window.drawTraj(odom_traj, sf::Color::Blue);
-  window.drawPoints(landmark_readings[0], sf::Color::Blue, 3);
-  window.drawTraj(ground_truth, sf::Color::Black);
-  window.drawPoints(w.trueLandmarks(), sf::Color::Black, 3);
+}
 
-  printResults(window, fg, ground_truth, w.trueLandmarks(), odom_traj, prior_landmarks);
+template <typename Traits>
+int slamMain(int argc, char **argv) {
+  std::string record_path, replay_path;
+  bool headless = false, replay = false, ok = true;
+  double speed = 0.0;
+  for (int arg = 1; arg < argc && ok; arg++) {
+    if (strcmp(argv[arg], "--record") == 0 && arg + 1 < argc && record_path.empty()) {
+      record_path = argv[++arg];
+    } else if (strcmp(argv[arg], "--headless") == 0 && !headless) {
+      headless = true;
+      if (arg + 1 < argc && isNumber(argv[arg + 1])) setNormalSeed(atol(argv[++arg]));
+    } else if (strcmp(argv[arg], "--replay") == 0 && arg + 1 < argc && !replay) {
+      replay = true;
+      replay_path = argv[++arg];
+      if (arg + 1 < argc && isNumber(argv[arg + 1])) speed = atof(argv[++arg]);
+    } else {
+      ok = false;
+    }
+  }
+  // A replay runs no simulation, so there is nothing to record or run headless
+  if (!ok || (replay && (headless || !record_path.empty()))) {
+    printf("Usage: %s [--record <log>] [--headless [seed]]\n"
+           "       %s --replay <log> [speed]\n", argv[0], argv[0]);
+    return 1;
+  }
+  if (replay) return replaySLAM<Traits>(replay_path, speed) ? 0 : 1;
+  collectDataAndRunSLAM<Traits>(headless, record_path);
+  return 0;
 }
 
+template values toVector<Planar2D>(const trajectory_t &, const points_t &, int, double);
+template values toVector<Linear1D>(const trajectory_t &, const points_t &, int, double);
+template void collectDataAndRunSLAM<Planar2D>(bool, const std::string &);
+template void collectDataAndRunSLAM<Linear1D>(bool, const std::string &);
+template bool replaySLAM<Planar2D>(const std::string &, double);
+template bool replaySLAM<Linear1D>(const std::string &, double);
+template SLAMErrors runSLAMTrial<Planar2D>(uint64_t, uint32_t);
+template SLAMErrors runSLAMTrial<Linear1D>(uint64_t, uint32_t);
+template int slamMain<Planar2D>(int, char **);
+template int slamMain<Linear1D>(int, char **);
@@ -2,11 +2,43 @@
 #ifndef __SLAM_UTILS_H__
 #define __SLAM_UTILS_H__
 
+#include <cstdint>
+#include <string>
 #include "utils.h"
 #include "graph.h"
 
+/* How far a SLAM run's estimates are from the ground truth, before (odometry and
+ * prior landmarks) and after smoothing. Potentials are the graph's cost function. */
+struct SLAMErrors {
+  double initial_error;
+  double smoothed_error;
+  double initial_potential;
+  double smoothed_potential;
+  double ground_truth_potential;
+};
+
+/* All of these are instantiated for Planar2D and Linear1D (see state_space.h). */
+template <typename Traits>
 values toVector(const trajectory_t &traj, const points_t &r, int max_num_poses, double prev_theta);
-//void collectDataAndRunSLAM(Graph (*smooth)(const values &x0, const traj_points_t &readings));
-void collectDataAndRunSLAM();
+/* Drives the robot through a World, runs SLAM on its readings and prints the results.
+ * Headless runs use a lockstep World and don't open any windows. If log_path is given,
+ * the readings are also recorded there (see sensor_log.h). */
+template <typename Traits>
+void collectDataAndRunSLAM(bool headless = false, const std::string &log_path = "");
+/* Runs SLAM on the readings recorded by collectDataAndRunSLAM and prints the results,
+ * without any simulation. Poses are fed at `speed` times the recorded rate, or as fast
+ * as possible if speed is 0. False if the log can't be read or is of the other
+ * dimension. */
+template <typename Traits>
+bool replaySLAM(const std::string &log_path, double speed = 0.0);
+/* The same run, headless and silent, with the world's noise drawn from the random
+ * streams of (seed, run_id) (see World::useRandomStreams). Runs are independent of each
+ * other and of the rest of the process, so they can go on separate threads. */
+template <typename Traits>
+SLAMErrors runSLAMTrial(uint64_t seed, uint32_t run_id);
+/* The command line of 2D.out and 1D.out (see 2D_slam.cpp), with the flags in any order.
+ * Prints the usage and returns 1 for anything it doesn't recognize. */
+template <typename Traits>
+int slamMain(int argc, char **argv);
 
 #endif
@@ -0,0 +1,125 @@
+#ifndef STATE_SPACE_H
+#define STATE_SPACE_H
+
+#include <cmath>
+#include "factors.h"
+#include "utils.h"
+
+/* State-space traits for FriendlyGraph and the SLAM pipeline. Each traits type fixes the
+ * pose and landmark dimensions at compile time and knows how to turn the simulator's
+ * transforms into state vectors and factors of that dimension.
+ *
+ * Required members:
+ *   IS_2D, POSE_SIZE, LM_SIZE
+ *   toState(tf, prev_theta)       world->robot transform to a pose state
+ *   toTransform(state)            inverse of toState
+ *   toPose(state)                 pose state padded out to a full (x, y, theta) pose_t
+ *   odomCovariance(rate)          odometry covariance for 1 meter of travel
+ *   gpsCovariance(xy_std)
+ *   odomNoiseDistanceSq(diff, wheel_base)
+ *                                 scales the odometry covariance for a relative motion
+ *   relativeFactor(to, from, ...) factor on state(to) - state(from) expressed in the
+ *                                 frame of `from`; from = -1 makes it a prior on `to`
+ *   landmarkFactor(lm, pose, ...) factor on the landmark as seen from `pose`;
+ *                                 pose = -1 makes it a prior on the landmark
+ */
+
+// SE(2) poses (x, y, theta) with (x, y) landmarks
+struct Planar2D {
+  static constexpr bool IS_2D = true;
+  static constexpr int POSE_SIZE = 3;
+  static constexpr int LM_SIZE = 2;
+
+  static measurement<POSE_SIZE> toState(const transform_t &tf, double prev_theta) {
+    return ::toPose(tf, prev_theta);
+  }
+
+  static transform_t toTransform(const measurement<POSE_SIZE> &state) {
+    return ::toTransform(state);
+  }
+
+  static pose_t toPose(const measurement<POSE_SIZE> &state) {
+    return state;
+  }
+
+  static covariance<POSE_SIZE> odomCovariance(double rate) {
+    covariance<POSE_SIZE> cov;
+    // TODO what are the right numbers here? Should y be correlated with theta?
+    cov << rate, 0, 0,
+           0, rate, rate/2.0,
+           0, rate/2.0, rate;
+    return cov;
+  }
+
+  static covariance<POSE_SIZE> gpsCovariance(double xy_std) {
+    // GPS has no heading measurements
+    // which we represent using a large covariance
+    covariance<POSE_SIZE> cov;
+    cov << xy_std * xy_std, 0, 0,
+           0, xy_std * xy_std, 0,
+           0, 0, 50.0 * 50.0;
+    return cov;
+  }
+
+  static double odomNoiseDistanceSq(const measurement<POSE_SIZE> &diff, double wheel_base) {
+    double lin_dist = diff(0);
+    // Turning introduces more noise than going in a straight line
+    double ang_dist = wheel_base * diff(2) * 4;
+    return lin_dist*lin_dist + ang_dist*ang_dist;
+  }
+
+  static AbstractFactor *relativeFactor(int to_idx, int from_idx,
+      const covariance<POSE_SIZE> &sigma_inv, const measurement<POSE_SIZE> &m) {
+    return new OdomFactor2D(to_idx, from_idx, sigma_inv, m);
+  }
+
+  static AbstractFactor *landmarkFactor(int lm_idx, int pose_idx,
+      const covariance<LM_SIZE> &sigma_inv, const measurement<LM_SIZE> &m) {
+    return new LandmarkFactor2D(lm_idx, pose_idx, sigma_inv, m);
+  }
+};
+
+// Positions along a line. The robot never turns, so the state is just x.
+struct Linear1D {
+  static constexpr bool IS_2D = false;
+  static constexpr int POSE_SIZE = 1;
+  static constexpr int LM_SIZE = 1;
+
+  static measurement<POSE_SIZE> toState(const transform_t &tf, double prev_theta) {
+    return measurement<POSE_SIZE> { ::toPose(tf, prev_theta)(0) };
+  }
+
+  static transform_t toTransform(const measurement<POSE_SIZE> &state) {
+    return ::toTransform(pose_t(state(0), 0, 0));
+  }
+
+  static pose_t toPose(const measurement<POSE_SIZE> &state) {
+    return pose_t(state(0), 0, 0);
+  }
+
+  static covariance<POSE_SIZE> odomCovariance(double rate) {
+    return covariance<POSE_SIZE> { rate };
+  }
+
+  static covariance<POSE_SIZE> gpsCovariance(double xy_std) {
+    return covariance<POSE_SIZE> { xy_std * xy_std };
+  }
+
+  static double odomNoiseDistanceSq(const measurement<POSE_SIZE> &diff, double /*wheel_base*/) {
+    return diff(0) * diff(0);
+  }
+
+  static AbstractFactor *relativeFactor(int to_idx, int from_idx,
+      const covariance<POSE_SIZE> &sigma_inv, const measurement<POSE_SIZE> &m) {
+    double sigma = 1/sqrt(sigma_inv(0,0));
+    if (from_idx < 0) return new GPSFactor(to_idx, sigma, m(0));
+    return new OdomFactor(from_idx, to_idx, sigma, m(0));
+  }
+
+  static AbstractFactor *landmarkFactor(int lm_idx, int pose_idx,
+      const covariance<LM_SIZE> &sigma_inv, const measurement<LM_SIZE> &m) {
+    return new LandmarkFactor1D(lm_idx, pose_idx, sigma_inv, m);
+  }
+};
+
+#endif
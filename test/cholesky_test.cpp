@@ -0,0 +1,73 @@
+
+#include "cholesky.h"
+#include "graph.h"
+#include "factors.h"
+#include <iostream>
+#include <Eigen/LU>
+
+// Checks the supernodal Cholesky solve against LU, first on a sparse matrix shaped like
+// a long SLAM window (a band of poses plus landmarks seen from a few poses each), including
+// refactoring with a cached analysis, then through Graph::solve on a pose chain.
+hessian slamLikeMatrix(int num_landmarks, int num_poses) {
+  int L = 2 * num_landmarks;
+  int N = L + 3 * num_poses;
+  hessian A = hessian::Identity(N, N);
+  for (int t = 0; t + 1 < num_poses; t++) {
+    // odometry couples consecutive poses
+    A.block(L + 3*t, L + 3*t, 6, 6) += hessian::Constant(6, 6, 0.5) + 6.0 * hessian::Identity(6, 6);
+  }
+  for (int l = 0; l < num_landmarks; l++) {
+    for (int k = 0; k < 3; k++) {
+      int t = (l * 7 + k * 5) % num_poses;
+      A.block(2*l, 2*l, 2, 2) += 2.0 * hessian::Identity(2, 2);
+      A.block(L + 3*t, L + 3*t, 3, 3) += 2.0 * hessian::Identity(3, 3);
+      A.block(2*l, L + 3*t, 2, 3) += hessian::Constant(2, 3, -0.3);
+      A.block(L + 3*t, 2*l, 3, 2) += hessian::Constant(3, 2, -0.3);
+    }
+  }
+  return A;
+}
+
+void buildChain(Graph &g, int num_poses) {
+  covariance<3> odom_cov_inv = covariance<3>::Identity() / (0.05 * 0.05);
+  covariance<3> pose_prior_inv = covariance<3>::Identity() / (0.01 * 0.01);
+  g.add(new OdomFactor2D(0, -1, pose_prior_inv, measurement<3> {0, 0, 0}));
+  for (int t = 1; t < num_poses; t++)
+    g.add(new OdomFactor2D(3*t, 3*(t-1), odom_cov_inv, measurement<3> {1.0, 0, 0.1}));
+}
+
+int main() {
+  hessian A = slamLikeMatrix(40, 60);
+  values b = values::LinSpaced(A.rows(), -1.0, 1.0);
+  SupernodalCholesky chol;
+  bool factored = chol.compute(A);
+  double solve_err = (chol.solve(b) - A.inverse() * b).norm();
+  std::cout << "Supernodes: " << chol.numSupernodes() << " for " << A.rows() << " columns" << std::endl;
+  std::cout << "Solve difference: " << solve_err << std::endl;
+
+  // A matrix with the same pattern reuses the analysis; a new pattern redoes it
+  hessian A2 = A;
+  A2.diagonal() *= 3.0;
+  bool refactored = chol.compute(A2) && chol.numAnalyses() == 1;
+  solve_err = std::max(solve_err, (chol.solve(b) - A2.inverse() * b).norm());
+  hessian A3 = slamLikeMatrix(30, 50);
+  values b3 = values::LinSpaced(A3.rows(), -1.0, 1.0);
+  refactored = refactored && chol.compute(A3) && chol.numAnalyses() == 2;
+  solve_err = std::max(solve_err, (chol.solve(b3) - A3.inverse() * b3).norm());
+  std::cout << "Analyses for three matrices with two patterns: " << chol.numAnalyses()
+            << "; worst solve difference: " << solve_err << std::endl;
+
+  values x0 = values::Zero(3 * 30);
+  Graph lu, cholesky;
+  buildChain(lu, 30);
+  buildChain(cholesky, 30);
+  cholesky.setLinearSolver(LinearSolver::Cholesky);
+  lu.solve(x0);
+  cholesky.solve(x0);
+  double sol_err = (lu.solution() - cholesky.solution()).norm();
+  double cov_err = (lu.covariance() - cholesky.covariance()).norm();
+  std::cout << "Graph solution difference: " << sol_err << std::endl;
+  std::cout << "Graph covariance difference: " << cov_err << std::endl;
+
+  return (factored && refactored && solve_err < 1e-8 && sol_err < 1e-8 && cov_err < 1e-8) ? 0 : 1;
+}
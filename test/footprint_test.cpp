@@ -0,0 +1,171 @@
+#include "obstacle_grid.h"
+#include "constants.h"
+#include <Eigen/LU>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+namespace {
+
+using NavSim::ROBOT_LENGTH;
+using NavSim::ROBOT_WHEEL_BASE;
+
+double cross(const point_t &o, const point_t &a, const point_t &b) {
+  return (a(0) - o(0)) * (b(1) - o(1)) - (a(1) - o(1)) * (b(0) - o(0));
+}
+
+// Whether p is inside (or on) the counterclockwise convex polygon
+bool inside(const point_t &p, const std::vector<point_t> &poly) {
+  for (size_t i = 0; i < poly.size(); i++)
+    if (cross(poly[i], poly[(i + 1) % poly.size()], p) < 0) return false;
+  return true;
+}
+
+// Whether p is inside any simple polygon, by counting the edges a ray from p crosses
+bool insidePolygon(const point_t &p, const std::vector<point_t> &poly) {
+  bool in = false;
+  for (size_t i = 0, j = poly.size() - 1; i < poly.size(); j = i++) {
+    if ((poly[i](1) > p(1)) != (poly[j](1) > p(1)) &&
+        p(0) < poly[j](0) + (p(1) - poly[j](1)) * (poly[i](0) - poly[j](0)) / (poly[i](1) - poly[j](1)))
+      in = !in;
+  }
+  return in;
+}
+
+bool segmentsCross(const point_t &a, const point_t &b, const point_t &c, const point_t &d) {
+  return cross(a, b, c) * cross(a, b, d) <= 0 && cross(c, d, a) * cross(c, d, b) <= 0;
+}
+
+// The footprint in the world frame, counterclockwise
+std::vector<point_t> worldFootprint(const transform_t &tf) {
+  transform_t robot_to_world = tf.inverse();
+  return {robot_to_world * point_t(ROBOT_LENGTH/2, 0, 1),
+          robot_to_world * point_t(-ROBOT_LENGTH/2, ROBOT_WHEEL_BASE/2, 1),
+          robot_to_world * point_t(-ROBOT_LENGTH/2, -ROBOT_WHEEL_BASE/2, 1)};
+}
+
+// Two polygons overlap if a vertex of one is inside the other or their edges cross
+bool bruteForce(const transform_t &tf, const obstacles_t &obstacles) {
+  std::vector<point_t> robot = worldFootprint(tf);
+  for (const obstacle_t &o : obstacles) {
+    // Obstacle vertices are within 6.6 of each other, footprint corners within 1.1
+    if (std::hypot(o(0, 0) - robot[0](0), o(0, 1) - robot[0](1)) > 8) continue;
+    std::vector<point_t> poly;
+    for (int i = 0; i < o.rows(); i++) poly.push_back(point_t(o(i, 0), o(i, 1), 1));
+    bool hit = false;
+    for (const point_t &p : robot) hit = hit || insidePolygon(p, poly);
+    for (const point_t &p : poly) hit = hit || inside(p, robot);
+    for (size_t i = 0; i < robot.size(); i++)
+      for (size_t j = 0; j < poly.size(); j++)
+        hit = hit || segmentsCross(robot[i], robot[(i + 1) % 3], poly[j], poly[(j + 1) % poly.size()]);
+    if (hit) return true;
+  }
+  return false;
+}
+
+// 2000 random obstacles over a 300 m square: regular polygons, or pentagons with random
+// radii like the URC layout (mostly non-convex)
+void randomObstacles(std::mt19937 &gen, bool regular, obstacles_t &obstacles, ObstacleGrid &grid) {
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  for (int i = 0; i < 2000; i++) {
+    double cx = 300 * unit(gen) - 150, cy = 300 * unit(gen) - 150;
+    double radius = 0.3 + 3 * unit(gen), phase = 2 * M_PI * unit(gen);
+    int n = regular ? 3 + (int) (4 * unit(gen)) : 5;
+    obstacle_t o(n, 2);
+    for (int j = 0; j < n; j++) {
+      double r = regular ? radius : 0.3 + 3 * unit(gen);
+      o(j, 0) = cx + cos(phase + 2 * M_PI * j / n) * r;
+      o(j, 1) = cy + sin(phase + 2 * M_PI * j / n) * r;
+    }
+    obstacles.push_back(o);
+    grid.add(o);
+  }
+}
+
+}
+
+// Checks the footprint test against a brute-force one on random convex and non-convex
+// obstacles, that the swept test catches every collision along densely sampled motions,
+// that the batched API agrees with single queries, and times them.
+int main() {
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  obstacles_t obstacles;
+  ObstacleGrid grid;
+  randomObstacles(gen, true, obstacles, grid);
+  int failures = 0;
+
+  trajectory_t poses;
+  for (int k = 0; k < 20000; k++)
+    poses.push_back(toTransform(pose_t(300 * unit(gen) - 150, 300 * unit(gen) - 150, 2 * M_PI * unit(gen))));
+  auto start = std::chrono::steady_clock::now();
+  std::vector<char> single;
+  for (const transform_t &tf : poses) single.push_back(footprintCollides(tf, grid));
+  auto mid = std::chrono::steady_clock::now();
+  std::vector<char> batched = footprintCollides(poses, grid);
+  auto end = std::chrono::steady_clock::now();
+  int mismatches = 0, collisions = 0;
+  for (size_t k = 0; k < poses.size(); k++) {
+    mismatches += single[k] != bruteForce(poses[k], obstacles);
+    collisions += single[k];
+  }
+  std::cout << "Poses: " << collisions << " collisions, " << mismatches << " mismatches of "
+            << poses.size() << "; single "
+            << std::chrono::duration<double, std::micro>(mid - start).count() / poses.size()
+            << " us per pose, batched "
+            << std::chrono::duration<double, std::micro>(end - mid).count() / poses.size()
+            << " us per pose" << std::endl;
+  failures += mismatches > 0 || collisions == 0 || batched != single;
+
+  // Motions up to a robot length and 90 degrees: the swept test must report every
+  // collision a dense sampling of the motion finds
+  int missed = 0, swept_hits = 0, sampled_hits = 0;
+  double swept_us = 0;
+  for (int k = 0; k < 5000; k++) {
+    pose_t a(300 * unit(gen) - 150, 300 * unit(gen) - 150, 2 * M_PI * unit(gen));
+    pose_t b = a + pose_t(ROBOT_LENGTH * (2 * unit(gen) - 1), ROBOT_LENGTH * (2 * unit(gen) - 1),
+                          M_PI / 2 * (2 * unit(gen) - 1));
+    auto t0 = std::chrono::steady_clock::now();
+    bool swept = sweptFootprintCollides(toTransform(a), toTransform(b), grid);
+    swept_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    bool sampled = false;
+    for (int s = 0; s <= 200 && !sampled; s++)
+      sampled = footprintCollides(toTransform(a + (b - a) * s / 200.0), grid);
+    missed += sampled && !swept;
+    swept_hits += swept;
+    sampled_hits += sampled;
+  }
+  std::cout << "Motions: " << swept_hits << " swept collisions, " << sampled_hits
+            << " found by sampling, " << missed << " missed; " << swept_us / 5000
+            << " us per motion" << std::endl;
+  failures += missed > 0 || swept_hits == 0;
+
+  // Non-convex obstacles are split into convex pieces, so the test stays exact for them
+  obstacles_t pentagons;
+  ObstacleGrid pentagon_grid;
+  randomObstacles(gen, false, pentagons, pentagon_grid);
+  mismatches = 0;
+  collisions = 0;
+  for (const transform_t &tf : poses) {
+    bool hit = footprintCollides(tf, pentagon_grid);
+    mismatches += hit != bruteForce(tf, pentagons);
+    collisions += hit;
+  }
+  std::cout << "Random pentagons: " << collisions << " collisions, " << mismatches
+            << " mismatches of " << poses.size() << std::endl;
+  failures += mismatches > 0 || collisions == 0;
+
+  // The notch of a U is free, its arms are not, and the robot can back out of the notch
+  ObstacleGrid u_grid;
+  obstacle_t u(8, 2);
+  u << 0, 0,  3, 0,  3, 3,  2, 3,  2, 1,  1, 1,  1, 3,  0, 3;
+  u_grid.add(u);
+  transform_t in_notch = toTransform(pose_t(1.5, 2.2, M_PI / 2));
+  bool exact = !footprintCollides(in_notch, u_grid) &&
+               footprintCollides(toTransform(pose_t(0.5, 2, M_PI / 2)), u_grid) &&
+               !sweptFootprintCollides(in_notch, toTransform(pose_t(1.5, 4, M_PI / 2)), u_grid);
+  if (!exact) std::cout << "U-shaped obstacle is not tested exactly" << std::endl;
+  failures += !exact;
+  return failures == 0 ? 0 : 1;
+}
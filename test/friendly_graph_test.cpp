@@ -0,0 +1,179 @@
+#include "friendly_graph.h"
+#include "constants.h"
+#include <Eigen/LU>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const points_t LANDMARKS = {point_t(3, 1, 1), point_t(2, -2, 1), point_t(6, 0.5, 1)};
+
+// The robot creeps forward 1 mm a frame for 20 frames (standing still would give the
+// odometry factors zero variance), then drives forward in steps of 0.2 m while turning
+// slightly
+transform_t frameTransform(int i) {
+  int moving = std::max(0, i - 19);
+  double creep = 0.001 * std::min(i, 19);
+  return toTransform(pose_t(creep + 0.2 * moving, 0.01 * moving, 0.02 * moving));
+}
+
+// Feeds frames [first, last), seeing every landmark from every pose. Measurements carry
+// a small deterministic error so that fusing them is not trivially exact. Returns how
+// many factor linearizations the solves did.
+int drive(FriendlyGraph<Planar2D> &fg, int first, int last) {
+  int linearizations = 0;
+  fg._graph.setVerbose(false);
+  if (first == 0) {
+    for (int l = 0; l < (int) LANDMARKS.size(); l++) fg.addLandmarkPrior(l, point_t(0, 0, 1), 20.0);
+  }
+  for (int i = first; i < last; i++) {
+    transform_t tf = frameTransform(i);
+    if (i == 0) {
+      fg.addPosePrior(0, tf, covariance<3>::Identity() * 1e-4);
+    } else {
+      fg.addOdomMeasurement(i, i - 1, tf, frameTransform(i - 1));
+    }
+    for (int l = 0; l < (int) LANDMARKS.size(); l++) {
+      point_t bearing = tf * LANDMARKS[(size_t) l];
+      bearing(0) += 0.02 * ((i + l) % 3 - 1);
+      bearing(1) -= 0.02 * ((i * 2 + l) % 3 - 1);
+      fg.addLandmarkMeasurement(i, l, bearing);
+    }
+    fg.solve();
+    linearizations += fg._graph.numLinearizations();
+  }
+  return linearizations;
+}
+
+double landmarkDifference(FriendlyGraph<Planar2D> &a, FriendlyGraph<Planar2D> &b) {
+  double diff = 0.0;
+  points_t la = a.getLandmarkLocations(), lb = b.getLandmarkLocations();
+  for (size_t l = 0; l < la.size(); l++) diff = std::max(diff, (la[l] - lb[l]).norm());
+  return diff;
+}
+
+double trajectoryDifference(FriendlyGraph<Planar2D> &a, FriendlyGraph<Planar2D> &b) {
+  double diff = 0.0;
+  trajectory_t ta = a.getSmoothedTrajectory(), tb = b.getSmoothedTrajectory();
+  if (ta.size() != tb.size()) return INFINITY;
+  for (size_t i = 0; i < ta.size(); i++) diff = std::max(diff, (ta[i] - tb[i]).norm());
+  return diff;
+}
+
+}
+
+// Checks that merging the observations a nearly stationary robot makes gives the same
+// estimate as keeping every factor, with far fewer factors, that poses without a guess
+// aren't merged, and that the per-landmark budget holds.
+// Then checks that a graph restored from a checkpoint carries on exactly like the
+// original, and reports the checkpoint's size and cost. Finally checks that lazy
+// relinearization does less work for the same estimate.
+int main() {
+  int failures = 0;
+  const int num_frames = 30, num_lms = (int) LANDMARKS.size();
+
+  FriendlyGraph<Planar2D> plain(num_lms, 40, 0.3f, 3.0f, 0.05f);
+  FriendlyGraph<Planar2D> merged(num_lms, 40, 0.3f, 3.0f, 0.05f);
+  merged.setLandmarkSparsification(0, 0.05 * NavSim::ROBOT_LENGTH, 0.05);
+  drive(plain, 0, num_frames);
+  drive(merged, 0, num_frames);
+  double lm_diff = landmarkDifference(plain, merged), traj_diff = trajectoryDifference(plain, merged);
+  std::cout << "Merging: " << plain.numLandmarkFactors(0) << " factors for landmark 0 without, "
+            << merged.numLandmarkFactors(0) << " with; landmarks differ by " << lm_diff
+            << ", poses by " << traj_diff << std::endl;
+  failures += plain.numLandmarkFactors(0) != num_frames || merged.numLandmarkFactors(0) > 11 ||
+              lm_diff > 1e-3 || traj_diff > 1e-3;
+
+  // A pose seen only through a landmark has no guess to compare, so it is never merged
+  FriendlyGraph<Planar2D> unguessed(num_lms, 40, 0.3f, 3.0f, 0.05f);
+  unguessed.setLandmarkSparsification(0, 0.05 * NavSim::ROBOT_LENGTH, 0.05);
+  unguessed._graph.setVerbose(false);
+  unguessed.addPosePrior(0, frameTransform(0), covariance<3>::Identity() * 1e-4);
+  unguessed.addLandmarkMeasurement(0, 0, frameTransform(0) * LANDMARKS[0]);
+  unguessed.addLandmarkMeasurement(1, 0, frameTransform(0) * LANDMARKS[0]);
+  unguessed.solve();
+  std::cout << "Pose without a guess: " << unguessed.numLandmarkFactors(0) << " factors" << std::endl;
+  failures += unguessed.numLandmarkFactors(0) != 2;
+
+  // Without merging, a budget caps the factors per landmark and later observations are
+  // dropped; the estimate stays close to the full one
+  FriendlyGraph<Planar2D> budgeted(num_lms, 40, 0.3f, 3.0f, 0.05f);
+  budgeted.setLandmarkSparsification(5, -1.0, -1.0);
+  drive(budgeted, 0, num_frames);
+  int max_factors = 0;
+  for (int l = 0; l < num_lms; l++) max_factors = std::max(max_factors, budgeted.numLandmarkFactors(l));
+  lm_diff = landmarkDifference(plain, budgeted);
+  std::cout << "Budget of 5: at most " << max_factors << " factors per landmark; landmarks differ by "
+            << lm_diff << std::endl;
+  failures += max_factors != 5 || lm_diff > 0.2;
+
+  // Checkpoint a trimmed 10-pose window (as slam_utils runs), restore it into a fresh
+  // graph, and keep feeding both the same frames
+  FriendlyGraph<Planar2D> original(num_lms, 10, 0.3f, 3.0f, 0.05f);
+  drive(original, 0, 25);
+  auto start = std::chrono::steady_clock::now();
+  std::string blob = original.checkpoint();
+  auto mid = std::chrono::steady_clock::now();
+  FriendlyGraph<Planar2D> restored(0, 1, 1.0f, 1.0f, 1.0f);
+  bool restore_ok = restored.restore(blob);
+  auto end = std::chrono::steady_clock::now();
+  double cov_diff = (original._graph.covariance() - restored._graph.covariance()).norm();
+  const std::string path = "friendly_graph_test.ckpt";
+  restore_ok = restore_ok && original.writeCheckpoint(path).get();
+  FriendlyGraph<Planar2D> from_file(0, 1, 1.0f, 1.0f, 1.0f);
+  restore_ok = restore_ok && from_file.restoreFromFile(path);
+  std::remove(path.c_str());
+  if (restore_ok) {
+    drive(original, 25, num_frames);
+    drive(restored, 25, num_frames);
+    drive(from_file, 25, num_frames);
+  }
+  lm_diff = std::max(landmarkDifference(original, restored), landmarkDifference(original, from_file));
+  traj_diff = std::max(trajectoryDifference(original, restored), trajectoryDifference(original, from_file));
+  std::cout << "Checkpoint: " << blob.size() << " bytes, written in "
+            << std::chrono::duration<double, std::micro>(mid - start).count() << " us, restored in "
+            << std::chrono::duration<double, std::micro>(end - mid).count() << " us; covariance differs by "
+            << cov_diff << "; after 5 more solves landmarks differ by " << lm_diff << ", poses by "
+            << traj_diff << std::endl;
+  failures += !restore_ok || cov_diff > 1e-9 || lm_diff > 1e-9 || traj_diff > 1e-9;
+
+  // Bad blobs are refused and leave the graph as it was: a truncated checkpoint, and a
+  // graph part with a zero landmark size or an unknown linear solver
+  std::string before = original.checkpoint();
+  int refused = !original.restore(blob.substr(0, blob.size() / 2));
+  BlobWriter graph_out, x0_out;
+  original._graph.serialize(graph_out);
+  x0_out.writeMatrix(original._graph.x0());
+  size_t lm_size_at = 2 * x0_out.data().size() + sizeof(int32_t); // after x0, sol, count
+  size_t solver_at = lm_size_at + sizeof(int32_t) + sizeof(double);
+  for (size_t at : {lm_size_at, solver_at}) {
+    std::string bad = graph_out.data();
+    if (at == solver_at) bad[at] = 7;
+    else std::memset(&bad[at], 0, sizeof(int32_t));
+    BlobReader in(bad);
+    refused += !original._graph.deserialize(in);
+  }
+  bool unchanged = original.checkpoint() == before;
+  std::cout << "Bad checkpoints: " << refused << " of 3 refused, graph "
+            << (unchanged ? "unchanged" : "changed") << std::endl;
+  failures += refused != 3 || !unchanged;
+
+  // Lazy relinearization skips factors whose variables barely moved, and still lands on
+  // the same estimate
+  FriendlyGraph<Planar2D> eager(num_lms, 10, 0.3f, 3.0f, 0.05f);
+  FriendlyGraph<Planar2D> lazy(num_lms, 10, 0.3f, 3.0f, 0.05f);
+  eager._graph.setRelinearizeThreshold(0.0);
+  lazy._graph.setRelinearizeThreshold(1e-4);
+  int eager_count = drive(eager, 0, num_frames), lazy_count = drive(lazy, 0, num_frames);
+  lm_diff = landmarkDifference(eager, lazy);
+  traj_diff = trajectoryDifference(eager, lazy);
+  std::cout << "Relinearization: " << eager_count << " linearizations with threshold 0, "
+            << lazy_count << " with 1e-4; landmarks differ by " << lm_diff << ", poses by "
+            << traj_diff << std::endl;
+  failures += lazy_count >= eager_count || lm_diff > 1e-3 || traj_diff > 1e-3;
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+
+#include "world.h"
+#include "icp.h"
+#include "correlative_matcher.h"
+#include <Eigen/LU>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+
+// Benchmarks scan registration on synthetic scans of the URC obstacle field.
+// Each scan samples points on the obstacle outlines around the field, in order along
+// the outlines (as a lidar would sweep them), with Gaussian noise and a fraction of
+// uniformly random outliers. The source scan is an independent sample seen from a pose
+// offset by a known transform.
+//
+// Usage: icp_benchmark.out [max_points] [noise_std] [outlier_fraction]
+// Everything is built without optimization by default; for representative timings use
+// `make clean && make icp_benchmark ARCH="-march=native -O2"`.
+
+struct Sampler {
+  std::vector<Eigen::Vector2d> starts, ends;
+  std::vector<double> cumulative_length;
+  Eigen::Vector2d center;
+  double radius;
+};
+
+Sampler makeSampler(const obstacles_t &obstacles, const Eigen::Vector2d &center, double radius) {
+  Sampler s = {{}, {}, {}, center, radius};
+  double total = 0;
+  for (const obstacle_t &obs : obstacles) {
+    for (int i = 0; i < obs.rows(); i++) {
+      Eigen::Vector2d a = obs.row(i).transpose();
+      Eigen::Vector2d b = obs.row((i + 1) % obs.rows()).transpose();
+      if ((a - center).norm() > radius && (b - center).norm() > radius) continue;
+      total += (b - a).norm();
+      s.starts.push_back(a);
+      s.ends.push_back(b);
+      s.cumulative_length.push_back(total);
+    }
+  }
+  return s;
+}
+
+points_t sampleScan(const Sampler &s, int n, double noise_std, double outlier_fraction,
+    const transform_t &tf, std::mt19937 &gen) {
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::normal_distribution<double> noise(0.0, noise_std);
+  // Positions along the concatenated outlines, sorted so that neighbouring points of
+  // the scan are neighbours on an outline
+  std::vector<double> positions((size_t) n);
+  for (double &l : positions) l = unit(gen) * s.cumulative_length.back();
+  std::sort(positions.begin(), positions.end());
+
+  points_t scan({});
+  scan.reserve((size_t) n);
+  for (double l : positions) {
+    Eigen::Vector2d p;
+    if (unit(gen) < outlier_fraction) {
+      p = s.center + s.radius * Eigen::Vector2d(2 * unit(gen) - 1, 2 * unit(gen) - 1);
+    } else {
+      size_t e = (size_t) (std::lower_bound(s.cumulative_length.begin(),
+            s.cumulative_length.end(), l) - s.cumulative_length.begin());
+      double edge_start = e == 0 ? 0.0 : s.cumulative_length[e - 1];
+      double t = (l - edge_start) / (s.cumulative_length[e] - edge_start);
+      p = s.starts[e] + t * (s.ends[e] - s.starts[e]);
+      p += Eigen::Vector2d(noise(gen), noise(gen));
+    }
+    scan.push_back(tf * point_t(p(0), p(1), 1));
+  }
+  return scan;
+}
+
+void report(const char *method, int n, double ms, int iters, const transform_t &tf,
+    const transform_t &truth) {
+  pose_t err = toPose(tf, 0) - toPose(truth, 0);
+  printf("%-14s %8d %12.3f %6d %12.5f %12.5f\n", method, n, ms, iters,
+      err.head<2>().norm(), std::abs(err(2)));
+}
+
+double timeMs(const std::function<void()> &f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+  int max_points = argc > 1 ? atoi(argv[1]) : 100000;
+  double noise_std = argc > 2 ? atof(argv[2]) : 0.03;
+  double outlier_fraction = argc > 3 ? atof(argv[3]) : 0.05;
+
+  World w;
+  w.addURCObstacles();
+  // The obstacle field of leg 6
+  Sampler sampler = makeSampler(w.obstacles(), Eigen::Vector2d(25, -50), 15);
+  std::mt19937 gen(11);
+  // Scans are expressed relative to the field's center, as a robot there would see them
+  transform_t to_robot = toTransform({25, -50, 0});
+  transform_t truth = toTransform({0.3, -0.2, 0.1});
+
+  printf("noise %.3f m, outliers %.0f%%\n", noise_std, 100 * outlier_fraction);
+  printf("%-14s %8s %12s %6s %12s %12s\n", "method", "points", "time (ms)", "iters",
+      "xy error", "theta error");
+  for (int n = 100; n <= max_points; n *= 10) {
+    points_t target = sampleScan(sampler, n, noise_std, outlier_fraction, to_robot, gen);
+    // tf * source = target, so the source is seen through truth^-1
+    points_t source = sampleScan(sampler, n, noise_std, outlier_fraction,
+        truth.inverse() * to_robot, gen);
+
+    transform_t tf;
+    double ms = timeMs([&] { tf = do_icp(source, target, 1.0); });
+    report("do_icp", n, ms, 10, tf, truth);
+
+    ICPResult res;
+    ms = timeMs([&] { res = point_to_line_icp(source, target); });
+    report("point_to_line", n, ms, res.iterations, res.tf, truth);
+
+    if (n <= 10000) {
+      CorrelativeResult corr;
+      ms = timeMs([&] {
+        CorrelativeScanMatcher matcher(target);
+        corr = matcher.match(source);
+      });
+      report("correlative", n, ms, 1, corr.tf, truth);
+    }
+  }
+  return 0;
+}
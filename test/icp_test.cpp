@@ -1,6 +1,7 @@
 
 #include "utils.h"
 #include "icp.h"
+#include <cmath>
 #include <random>
 #include <iostream>
 
@@ -40,5 +41,56 @@ int main(int argc, char** argv) {
   std::cout << "Ground truth:\n" << toPose(tf, 0.0) << std::endl;
   std::cout << "ICP:\n" << toPose(sol2, 0.0) << std::endl;
 
-  return 0;
+  // A scan of the walls of a room, like World::readLidar would produce. The second
+  // scan samples the walls at different points, so there are no exact pairs.
+  points_t room({}), room2({});
+  for (int i = 0; i < 200; i++) {
+    double s = 0.1 * (i % 50) + 0.05;
+    double s2 = s + 0.03;
+    int wall = i / 50;
+    point_t p, p2;
+    if (wall == 0) { p << s, 0, 1; p2 << s2, 0, 1; }
+    else if (wall == 1) { p << 5, s, 1; p2 << 5, s2, 1; }
+    else if (wall == 2) { p << 5 - s, 5, 1; p2 << 5 - s2, 5, 1; }
+    else { p << 0, 5 - s, 1; p2 << 0, 5 - s2, 1; }
+    room.push_back(p);
+    room2.push_back(tf * p2);
+  }
+  std::cout << "\nPoint-to-line on a room scan:\n";
+  ICPResult res = point_to_line_icp(room, room2);
+  std::cout << "Ground truth:\n" << toPose(tf, 0.0) << std::endl;
+  std::cout << "ICP:\n" << toPose(res.tf, 0.0) << std::endl;
+  std::cout << "Iterations: " << res.iterations << ", rms error: " << res.rms_error
+            << ", inliers: " << res.num_inliers << ", converged: " << res.converged << std::endl;
+  // The walls were resampled 3 cm along themselves, which point-to-line ignores
+  pose_t pose_err = toPose(res.tf, 0.0) - toPose(tf, 0.0);
+  int failures = 0;
+  failures += !res.converged || res.num_inliers < 190 || pose_err.topRows(2).norm() > 0.01 ||
+              std::abs(pose_err(2)) > 0.005;
+
+  // Batch registration of a few room scans against each other should match
+  // registering the pairs one at a time
+  std::vector<points_t> scans({room, room2});
+  for (int k = 1; k <= 4; k++) {
+    transform_t shift = toTransform({0.05 * k, -0.03 * k, 0.02 * k});
+    scans.push_back(transformReadings(room, shift));
+  }
+  std::vector<ScanPair> pairs({});
+  for (int s = 0; s < (int) scans.size(); s++) {
+    for (int t = 0; t < (int) scans.size(); t++) {
+      if (s != t) pairs.push_back({s, t, transform_t::Identity()});
+    }
+  }
+  std::vector<ICPResult> batch = point_to_line_icp_batch(scans, pairs);
+  double batch_diff = 0;
+  for (size_t k = 0; k < pairs.size(); k++) {
+    ICPResult single = point_to_line_icp(scans[(size_t) pairs[k].source],
+        scans[(size_t) pairs[k].target]);
+    batch_diff += (batch[k].tf - single.tf).norm();
+  }
+  std::cout << "\nBatch of " << pairs.size() << " pairs, difference from one at a time: "
+            << batch_diff << std::endl;
+  failures += batch.size() != pairs.size() || batch_diff > 1e-9;
+
+  return failures == 0 ? 0 : 1;
 }
@@ -0,0 +1,39 @@
+
+#include "kdtree.h"
+#include <iostream>
+#include <random>
+
+// Compares k-d tree nearest neighbour queries against a brute force search.
+int main() {
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<double> coord(-10.0, 10.0);
+  points_t cloud({});
+  for (int i = 0; i < 2000; i++) {
+    cloud.push_back({coord(gen), coord(gen), 1});
+  }
+  // A few points on a line, like a lidar scan of a wall
+  for (int i = 0; i < 100; i++) {
+    cloud.push_back({0.1 * i, 3.0, 1});
+  }
+  KdTree2D tree(cloud);
+
+  int mismatches = 0;
+  for (int k = 0; k < 1000; k++) {
+    point_t q = {coord(gen), coord(gen), 1};
+    double max_dist = (k % 2 == 0) ? INFINITY : 0.2;
+    double best = max_dist * max_dist;
+    int brute = -1;
+    for (size_t i = 0; i < cloud.size(); i++) {
+      double d = (cloud[i] - q).squaredNorm();
+      if (d < best) {
+        best = d;
+        brute = (int) i;
+      }
+    }
+    double dist_sq = 0;
+    int found = tree.nearest(q, max_dist, &dist_sq);
+    if (found != brute || (found != -1 && dist_sq != best)) mismatches++;
+  }
+  std::cout << "Mismatches: " << mismatches << " of 1000" << std::endl;
+  return mismatches == 0 ? 0 : 1;
+}
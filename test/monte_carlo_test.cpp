@@ -0,0 +1,44 @@
+#include <Eigen/LU>
+#include <cstring>
+#include <iostream>
+#include "monte_carlo.h"
+#include "philox.h"
+#include "state_space.h"
+
+// Checks Philox against the published known-answer vectors, that random streams can
+// be seeked, and that a Monte Carlo batch gives bit-identical results on 1 and 4 threads.
+int main() {
+  int failures = 0;
+
+  philox_counter_t zero = philox4x32({0, 0, 0, 0}, {0, 0});
+  philox_counter_t ones = philox4x32({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                                     {0xffffffff, 0xffffffff});
+  bool kat = zero == philox_counter_t{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}
+          && ones == philox_counter_t{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd};
+  std::cout << "Philox known answers: " << (kat ? "ok" : "FAILED") << std::endl;
+  failures += !kat;
+
+  NormalStream stream(5, 2, 1), seeked(5, 2, 1);
+  double samples[200];
+  stream.fill(samples, 200);
+  seeked.seek(137);
+  bool seek_ok = seeked.next() == samples[137] && seeked.next() == samples[138];
+  double mean = 0.0, var = 0.0;
+  for (double s : samples) mean += s / 200;
+  for (double s : samples) var += (s - mean) * (s - mean) / 199;
+  std::cout << "Seek: " << (seek_ok ? "ok" : "FAILED") << ", mean " << mean
+            << ", variance " << var << std::endl;
+  failures += !seek_ok;
+
+  MonteCarloSummary one = runMonteCarlo<Planar2D>(4, 7, 1);
+  MonteCarloSummary four = runMonteCarlo<Planar2D>(4, 7, 4);
+  bool identical = memcmp(one.runs.data(), four.runs.data(), 4 * sizeof(SLAMErrors)) == 0
+      && memcmp(&one.mean, &four.mean, sizeof(SLAMErrors)) == 0;
+  bool distinct = one.runs[0].smoothed_error != one.runs[1].smoothed_error;
+  std::cout << "1 vs 4 threads: " << (identical ? "identical" : "DIFFERENT")
+            << "; runs " << (distinct ? "differ" : "DO NOT DIFFER") << " from each other"
+            << "; mean smoothed error " << one.mean.smoothed_error << std::endl;
+  failures += !identical + !distinct;
+
+  return failures == 0 ? 0 : 1;
+}
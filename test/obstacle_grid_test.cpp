@@ -0,0 +1,62 @@
+#include "obstacle_grid.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+// Compares the grid's segment queries against the linear scans in utils.cpp on a field
+// of random pentagons like the URC layout, and times both. Footprint collisions are
+// checked in footprint_test.
+int main() {
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  obstacles_t obstacles({});
+  ObstacleGrid grid;
+  for (int i = 0; i < 2000; i++) {
+    double cx = 300 * unit(gen) - 150, cy = 300 * unit(gen) - 150;
+    obstacle_t o(5, 2);
+    for (int j = 0; j < 5; j++) {
+      double theta = 2 * M_PI * j / 5;
+      double dist = 0.5 + 4.5 * unit(gen);
+      o(j, 0) = cx + cos(theta) * dist;
+      o(j, 1) = cy + sin(theta) * dist;
+    }
+    obstacles.push_back(o);
+    grid.add(o);
+  }
+
+  // Lidar-length rays, plus some long segments that cross many cells
+  std::vector<std::pair<point_t, point_t>> segments;
+  for (int k = 0; k < 2000; k++) {
+    point_t r0(300 * unit(gen) - 150, 300 * unit(gen) - 150, 1);
+    double angle = 2 * M_PI * unit(gen), len = (k % 10 == 0) ? 40.0 : 5.6;
+    segments.push_back({r0, r0 + len * point_t(cos(angle), sin(angle), 0)});
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<double> linear;
+  for (const auto &s : segments) linear.push_back(obstacleIntersection(s.first, s.second, obstacles));
+  auto mid = std::chrono::steady_clock::now();
+  std::vector<double> indexed;
+  for (const auto &s : segments) indexed.push_back(obstacleIntersection(s.first, s.second, grid));
+  auto end = std::chrono::steady_clock::now();
+
+  // The linear scan skips obstacles far from r0 (fine for lidar rays), and may report
+  // hits past the end of the segment (t > 1), which the grid reports as misses; compare
+  // against an exhaustive scan instead
+  int ray_mismatches = 0, hits = 0;
+  for (size_t k = 0; k < segments.size(); k++) {
+    double expected = 2.0;
+    for (const obstacle_t &o : obstacles)
+      expected = std::min(expected, obstacleIntersection(segments[k].first, segments[k].second, o));
+    if (expected > 1.0) expected = 2.0;
+    if (indexed[k] != expected) ray_mismatches++;
+    if (indexed[k] <= 1.0) hits++;
+  }
+  std::cout << "Segments: " << hits << " hits, " << ray_mismatches << " mismatches of "
+            << segments.size() << "; linear "
+            << std::chrono::duration<double, std::milli>(mid - start).count() << " ms, grid "
+            << std::chrono::duration<double, std::milli>(end - mid).count() << " ms" << std::endl;
+
+  return ray_mismatches == 0 ? 0 : 1;
+}
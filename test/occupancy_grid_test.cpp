@@ -0,0 +1,82 @@
+#include "occupancy_grid.h"
+#include "obstacle_grid.h"
+#include <Eigen/LU>
+#include <chrono>
+#include <iostream>
+
+// Maps a square room from noiseless 100-beam scans taken inside it and checks the walls,
+// the free interior and the unknown outside; then checks dirty tiles and that scans far
+// apart don't allocate the space between them.
+int main() {
+  const double max_range = 8.0, resolution = 0.1;
+  ObstacleGrid room;
+  obstacle_t wall(4, 2);
+  wall << -5, -5,  5, -5,  5, -4.8,  -5, -4.8;  room.add(wall);
+  wall << -5, 4.8,  5, 4.8,  5, 5,  -5, 5;      room.add(wall);
+  wall << -5, -5,  -4.8, -5,  -4.8, 5,  -5, 5;  room.add(wall);
+  wall << 4.8, -5,  5, -5,  5, 5,  4.8, 5;      room.add(wall);
+
+  auto scanAt = [&](const pose_t &pose) {
+    transform_t tf = toTransform(pose);
+    point_t origin(pose(0), pose(1), 1);
+    points_t hits;
+    for (int j = 0; j < 100; j++) {
+      double angle = 2 * M_PI * j / 100;
+      point_t end = origin + max_range * point_t(cos(angle + pose(2)), sin(angle + pose(2)), 0);
+      double t = obstacleIntersection(origin, end, room);
+      if (t <= 1.0) hits.push_back(point_t(t * max_range * cos(angle), t * max_range * sin(angle), 1));
+    }
+    return std::make_pair(tf, hits);
+  };
+
+  OccupancyGrid grid(resolution);
+  double total_us = 0;
+  int scans = 0;
+  for (double x = -3; x <= 3; x += 1.5) {
+    for (double y = -3; y <= 3; y += 1.5) {
+      auto scan = scanAt(pose_t(x, y, 0.3 * x - 0.2 * y));
+      auto start = std::chrono::steady_clock::now();
+      grid.addScan(scan.first, scan.second);
+      total_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+      scans++;
+    }
+  }
+
+  int failures = 0;
+  int wall_cells = 0, wall_occupied = 0, free_cells = 0, free_ok = 0;
+  for (double v = -4.75; v <= 4.75; v += 0.5) {
+    for (point_t p : {point_t(v, -4.85, 1), point_t(v, 4.85, 1), point_t(-4.85, v, 1), point_t(4.85, v, 1)}) {
+      wall_cells++;
+      wall_occupied += grid.probability(p(0), p(1)) > 0.7;
+    }
+    for (double u = -4.25; u <= 4.25; u += 0.5) {
+      free_cells++;
+      free_ok += grid.probability(u, v) < 0.3;
+    }
+  }
+  bool outside_unknown = grid.logOdds(20, 20) == 0.0f && grid.logOdds(-5.5, 0) == 0.0f;
+  std::cout << wall_occupied << " of " << wall_cells << " wall cells occupied, " << free_ok
+            << " of " << free_cells << " interior cells free, " << grid.numTiles() << " tiles, "
+            << total_us / scans << " us per 100-beam scan" << std::endl;
+  failures += wall_occupied < wall_cells * 9 / 10 || free_ok < free_cells * 9 / 10 ||
+              !outside_unknown || grid.occupiedCells().empty();
+
+  // Every tile is dirty after the first scans; repeating a scan only dirties the tiles it
+  // still changes (log-odds stop changing once clamped)
+  bool dirty_ok = grid.takeDirtyTiles().size() == grid.numTiles() && grid.takeDirtyTiles().empty();
+  auto scan = scanAt(pose_t(0, 0, 0));
+  for (int i = 0; i < 20; i++) grid.addScan(scan.first, scan.second);
+  grid.takeDirtyTiles();
+  grid.addScan(scan.first, scan.second);
+  dirty_ok = dirty_ok && grid.takeDirtyTiles().empty();
+  if (!dirty_ok) std::cout << "dirty tiles are wrong" << std::endl;
+  failures += !dirty_ok;
+
+  // Two short rays 1 km apart only allocate the tiles around them
+  OccupancyGrid sparse(resolution);
+  sparse.addRay(point_t(0, 0, 1), point_t(1, 0, 1), true);
+  sparse.addRay(point_t(1000, 1000, 1), point_t(1000, 1001, 1), true);
+  std::cout << "two rays 1 km apart: " << sparse.numTiles() << " tiles" << std::endl;
+  failures += sparse.numTiles() > 4;
+  return failures == 0 ? 0 : 1;
+}
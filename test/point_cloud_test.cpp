@@ -0,0 +1,36 @@
+
+#include "point_cloud.h"
+#include <iostream>
+#include <random>
+
+// Checks the PointCloud kernels against the same math on points_t. 103 points, so the
+// vectorized loops also have a tail, and a few "no data" points.
+int main() {
+  std::mt19937 gen(5);
+  std::uniform_real_distribution<double> coord(-10.0, 10.0);
+  points_t points({});
+  for (int i = 0; i < 103; i++) {
+    if (i % 17 == 3) points.push_back({0, 0, 0});
+    else points.push_back({coord(gen), coord(gen), 1});
+  }
+  PointCloud cloud(points);
+  transform_t tf = toTransform({1.0, -2.0, 0.7});
+
+  PointCloud moved;
+  transformCloud(tf, cloud, moved);
+  double tf_err = 0;
+  for (size_t i = 0; i < points.size(); i++) {
+    if (!moved.valid(i)) continue;
+    point_t expected = tf * points[i];
+    tf_err += std::abs(moved.x()[i] - expected(0)) + std::abs(moved.y()[i] - expected(1));
+  }
+
+  Eigen::Vector2d sum = Eigen::Vector2d::Zero();
+  for (const point_t &p : points) sum += p.head<2>();
+  double centroid_err = (centroid(cloud) - sum / (double) cloud.numValid()).norm();
+
+  std::cout << "Valid points: " << cloud.numValid() << " of " << cloud.size() << std::endl;
+  std::cout << "Transform error: " << tf_err << std::endl;
+  std::cout << "Centroid error: " << centroid_err << std::endl;
+  return (tf_err < 1e-9 && centroid_err < 1e-9) ? 0 : 1;
+}
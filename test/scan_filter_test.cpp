@@ -0,0 +1,82 @@
+#include "scan_filter.h"
+#include <iostream>
+#include <random>
+
+// Runs each filter on a dense scan of two walls with noise, "no data" points and
+// scattered outliers, and checks what survives.
+int main() {
+  std::mt19937 gen(5);
+  std::normal_distribution<double> noise(0.0, 0.02);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  points_t scan({});
+  int num_outliers = 0;
+  for (int i = 0; i < 4000; i++) {
+    double t = i / 4000.0;
+    if (i % 97 == 0) {
+      scan.push_back(point_t::Zero());
+    } else if (i % 50 == 0) {
+      scan.push_back({12 * unit(gen) - 6, 12 * unit(gen) - 6, 1});
+      num_outliers++;
+    } else if (t < 0.5) {
+      scan.push_back({4 + noise(gen), -4 + 16 * t, 1}); // wall x = 4
+    } else {
+      scan.push_back({4 - 16 * (t - 0.5), 4 + noise(gen), 1}); // wall y = 4
+    }
+  }
+  int failures = 0;
+
+  points_t ranged = scan;
+  rangeFilter(ranged, 1.0, 5.0);
+  int bad_range = 0;
+  for (const point_t &p : ranged) {
+    double r = p.head<2>().norm();
+    if (p(2) == 0.0 || r < 1.0 || r > 5.0) bad_range++;
+  }
+  std::cout << "Range filter: " << scan.size() << " -> " << ranged.size()
+            << " points, " << bad_range << " out of range" << std::endl;
+  failures += bad_range != 0;
+
+  for (VoxelSelect select : {VoxelSelect::Centroid, VoxelSelect::Nearest}) {
+    points_t voxels = scan;
+    voxelDownsample(voxels, 0.1, select);
+    // One point per cell; "nearest" keeps original points, "centroid" stays on the walls.
+    // Only outliers are off the walls: "no data" points (at the origin) must not become voxels.
+    int off_wall = 0, no_data = 0;
+    for (const point_t &p : voxels) {
+      bool on_wall = std::abs(p(0) - 4) < 0.1 || std::abs(p(1) - 4) < 0.1;
+      if (!on_wall) off_wall++;
+      if (p(2) == 0.0 || p.head<2>().norm() < 0.1) no_data++;
+    }
+    std::cout << (select == VoxelSelect::Centroid ? "Centroid" : "Nearest")
+              << " voxels: " << scan.size() << " -> " << voxels.size()
+              << " points, " << off_wall << " off the walls, " << no_data << " from no data" << std::endl;
+    failures += voxels.size() > scan.size() / 5 || off_wall > num_outliers || no_data != 0;
+  }
+
+  points_t cleaned = scan;
+  ScanFilterParams params;
+  params.min_range = 1.0;
+  params.max_range = 8.0;
+  params.voxel_size = 0.05;
+  params.outlier_radius = 0.3;
+  params.outlier_min_neighbours = 2;
+  filterScan(cleaned, params);
+  int off_wall = 0;
+  for (const point_t &p : cleaned) {
+    if (std::abs(p(0) - 4) > 0.1 && std::abs(p(1) - 4) > 0.1) off_wall++;
+  }
+  // Scan order survives: the wall x = 4 is traversed upwards (away from the corner)
+  int out_of_order = 0;
+  for (size_t i = 1; i < cleaned.size(); i++) {
+    bool both_on_wall = std::abs(cleaned[i](0) - 4) < 0.1 && std::abs(cleaned[i - 1](0) - 4) < 0.1
+        && cleaned[i](1) < 3.5 && cleaned[i - 1](1) < 3.5;
+    if (both_on_wall && cleaned[i](1) < cleaned[i - 1](1) - 0.1) out_of_order++;
+  }
+  std::cout << "Pipeline: " << scan.size() << " -> " << cleaned.size() << " points, "
+            << off_wall << " of " << num_outliers << " outliers left, "
+            << out_of_order << " out of order" << std::endl;
+  failures += off_wall > num_outliers / 10;
+  failures += out_of_order != 0;
+
+  return failures == 0 ? 0 : 1;
+}
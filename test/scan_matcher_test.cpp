@@ -0,0 +1,172 @@
+#include "scan_matcher.h"
+#include "scan_filter.h"
+#include "friendly_graph.h"
+#include "state_space.h"
+#include "constants.h"
+#include "world.h"
+#include <Eigen/Cholesky>
+#include <Eigen/LU>
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+using namespace NavSim;
+
+namespace {
+
+obstacle_t box(double x0, double y0, double x1, double y1) {
+  obstacle_t o(4, 2);
+  o << x0, y0,  x1, y0,  x1, y1,  x0, y1;
+  return o;
+}
+
+// A corridor with pillars along its walls, so that matches are constrained along it too
+void addCorridor(World &w) {
+  w.addObstacle(box(-3, -2.2, 15, -2));
+  w.addObstacle(box(-3, 2, 15, 2.2));
+  for (double x = -2; x < 15; x += 1.7) {
+    w.addObstacle(box(x, -2, x + 0.3, -1.7));
+    w.addObstacle(box(x + 0.8, 1.7, x + 1.1, 2));
+  }
+}
+
+struct Stats {
+  Stats() : scans(0), matches(0), max_match_err(0), sum_match_err(0), sum_odom_err(0),
+      sum_chi2(0), cov_ok(true), keyframes(), truth(), odom(), found() {}
+
+  int scans, matches;
+  double max_match_err, sum_match_err, sum_odom_err;
+  double sum_chi2; // of the (x, y, theta) match error against the match covariance
+  bool cov_ok;
+  std::set<int> keyframes;
+  trajectory_t truth, odom;
+  std::vector<ScanMatch> found;
+};
+
+double translationError(const transform_t &estimate, const transform_t &truth) {
+  return toPose(estimate * truth.inverse(), 0).topRows(2).norm();
+}
+
+// Drives through the world as SLAMSession does (a frame every half second, scans
+// filtered the same way) and checks every match against the true relative motion
+Stats drive(World &w, int num_frames) {
+  ScanFilterParams filter;
+  filter.min_range = LIDAR_MIN_RANGE;
+  filter.max_range = LIDAR_MAX_RANGE;
+  filter.voxel_size = 0.1 * ROBOT_LENGTH;
+  filter.outlier_radius = 0.5 * ROBOT_LENGTH;
+  ICPParams params;
+  params.max_correspondence_dist = 0.3 * ROBOT_LENGTH;
+  ScanMatcher matcher(CORRUPTION_STD * sqrt(LIDAR_MAX_RANGE), ROBOT_LENGTH, M_PI / 8, params);
+
+  Stats stats;
+  trajectory_t &truth = stats.truth, &odom = stats.odom;
+  w.start();
+  w.setCmdVel(0.02, ROBOT_LENGTH);
+  auto check = [&](const ScanMatch &m) {
+    stats.matches++;
+    stats.keyframes.insert(m.keyframe_id);
+    transform_t true_rel = truth[(size_t) m.pose_id] * truth[(size_t) m.keyframe_id].inverse();
+    transform_t odom_rel = odom[(size_t) m.pose_id] * odom[(size_t) m.keyframe_id].inverse();
+    double err = translationError(m.rel_tf, true_rel);
+    stats.max_match_err = std::max(stats.max_match_err, err);
+    stats.sum_match_err += err;
+    stats.sum_odom_err += translationError(odom_rel, true_rel);
+    stats.cov_ok = stats.cov_ok && m.cov.llt().info() == Eigen::Success;
+    if (stats.cov_ok) {
+      pose_t e = toPose(m.rel_tf, 0) - toPose(true_rel, 0);
+      e(2) = nearestHeadingBranch(e(2), 0.0);
+      stats.sum_chi2 += e.dot(m.cov.llt().solve(e));
+    }
+    stats.found.push_back(m);
+  };
+  for (int i = 0; i < num_frames; i++) {
+    truth.push_back(w.readTrueTransform());
+    odom.push_back(w.readOdom());
+    points_t scan = w.readLidar();
+    filterScan(scan, filter);
+    ScanMatch m;
+    if (matcher.getMatch(m)) check(m);
+    matcher.addScan(i, scan, odom.back());
+    stats.scans++;
+    w.step(0.5);
+  }
+  // The last scan's match is still waiting
+  ScanMatch m;
+  if (matcher.getMatch(m)) check(m);
+  return stats;
+}
+
+// Mean translation error of the trajectory that FriendlyGraph smooths out of the odometry
+// of a drive, with or without its scan matches; each match is added when it came in.
+// The odometry model fits the simulated wheels (WHEEL_STD) over the half-meter steps of
+// drive(), so that the comparison is between two calibrated sources.
+double smoothedError(const Stats &stats, bool use_matches) {
+  int num_poses = (int) stats.truth.size();
+  FriendlyGraph<Planar2D> fg(0, num_poses, 0.3, 3.0, (float) (4 * WHEEL_STD * WHEEL_STD));
+  fg._graph.setVerbose(false);
+  fg.addPosePrior(0, stats.truth[0], covariance<3>::Identity() * 1e-6);
+  size_t next_match = 0;
+  for (int i = 1; i < num_poses; i++) {
+    fg.addOdomMeasurement(i, i - 1, stats.odom[(size_t) i], stats.odom[(size_t) i - 1]);
+    for (; next_match < stats.found.size() && stats.found[next_match].pose_id < i; next_match++) {
+      const ScanMatch &m = stats.found[next_match];
+      if (use_matches) fg.addRelativePoseMeasurement(m.pose_id, m.keyframe_id, m.rel_tf, m.cov);
+    }
+    fg.solve();
+  }
+  for (; use_matches && next_match < stats.found.size(); next_match++) {
+    const ScanMatch &m = stats.found[next_match];
+    fg.addRelativePoseMeasurement(m.pose_id, m.keyframe_id, m.rel_tf, m.cov);
+  }
+  fg.solve();
+  double sum = 0;
+  for (int i = 0; i < num_poses; i++) {
+    pose_t est = fg.getPoseEstimate(i);
+    sum += (est.topRows(2) - toPose(stats.truth[(size_t) i], 0).topRows(2)).norm();
+  }
+  return sum / num_poses;
+}
+
+}
+
+// Runs the lidar odometry front end through a corridor and checks that it matches most
+// scans, moves its keyframe along, stays within a few cm of the true motion, reports a
+// covariance that fits its error and doesn't hurt a smoothed trajectory; then checks that
+// an empty world gives no matches.
+int main() {
+  int failures = 0;
+  World corridor(true, true);
+  corridor.useRandomStreams(5, 0);
+  addCorridor(corridor);
+  corridor.setStartPose(pose_t(0, 0, 0));
+  Stats stats = drive(corridor, 24);
+  double mean_err = stats.matches > 0 ? stats.sum_match_err / stats.matches : INFINITY;
+  double odom_err = stats.matches > 0 ? stats.sum_odom_err / stats.matches : 0.0;
+  std::cout << "Corridor: " << stats.matches << " matches for " << stats.scans << " scans against "
+            << stats.keyframes.size() << " keyframes; translation error mean " << mean_err
+            << " max " << stats.max_match_err << " (odometry: mean " << odom_err << ")" << std::endl;
+  failures += stats.matches < 3 * (stats.scans - 1) / 4 || stats.keyframes.size() < 3 ||
+              !stats.cov_ok || mean_err > 0.06 || stats.max_match_err > 0.15;
+
+  // The covariance should describe the error: its chi-squared statistic has 3 degrees
+  // of freedom, so over a couple dozen matches the mean should be near 3
+  double mean_chi2 = stats.matches > 0 ? stats.sum_chi2 / stats.matches : INFINITY;
+  std::cout << "Match error chi-squared: mean " << mean_chi2 << " (expect about 3)" << std::endl;
+  failures += !(mean_chi2 > 0.5 && mean_chi2 < 9.0);
+
+  // ...so the matches should not make the smoothed trajectory worse than odometry alone
+  double odom_only = smoothedError(stats, false);
+  double with_matches = smoothedError(stats, true);
+  std::cout << "Smoothed trajectory error: odometry only " << odom_only
+            << ", with matches " << with_matches << std::endl;
+  failures += with_matches > odom_only * 1.05;
+
+  World empty(true, true);
+  empty.useRandomStreams(5, 0);
+  empty.setStartPose(pose_t(0, 0, 0));
+  Stats none = drive(empty, 5);
+  std::cout << "Empty world: " << none.matches << " matches" << std::endl;
+  failures += none.matches != 0;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#include "scenario.h"
+#include "world.h"
+#include <Eigen/LU>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace {
+
+bool sameWorld(World &a, World &b) {
+  obstacles_t obs_a = a.obstacles(), obs_b = b.obstacles();
+  if (obs_a.size() != obs_b.size()) return false;
+  for (size_t i = 0; i < obs_a.size(); i++) {
+    if (obs_a[i].rows() != obs_b[i].rows() || !(obs_a[i] == obs_b[i]).all()) return false;
+  }
+  if (a.trueLandmarks() != b.trueLandmarks()) return false;
+  for (int i = 0; a.getLeg(i).left_post_id >= 0 || b.getLeg(i).left_post_id >= 0; i++) {
+    URCLeg la = a.getLeg(i), lb = b.getLeg(i);
+    if (la.left_post_id != lb.left_post_id || la.right_post_id != lb.right_post_id ||
+        la.approx_GPS != lb.approx_GPS)
+      return false;
+  }
+  return (a.readTrueTransform() - b.readTrueTransform()).norm() < 1e-12;
+}
+
+}
+
+// Round trips scenarios through the text and binary forms, checks that damaged files
+// are refused, and times loading a large course.
+int main() {
+  const std::string path = "scenario_test.scn";
+  int failures = 0;
+
+  // The text form builds the same world as the equivalent World calls
+  std::istringstream text(
+      "# a small course\n"
+      "dimension 2\n"
+      "start 1 2 0.5\n"
+      "obstacle 3 1  4 2  2 2.5   # a triangle\n"
+      "obstacle 5 -1  5.5 -1  5.5 2  5 2\n"
+      "landmark 7 8\n"
+      "post 10 0 10 0.5\n"
+      "gate -4 3 3.14159 2.0 -4 3\n");
+  Scenario scenario;
+  std::string error;
+  bool parsed = parseScenario(text, scenario, error) && writeScenario(path, scenario);
+  World loaded(true, true), built(true, true);
+  ScenarioFile file(path);
+  parsed = parsed && loaded.loadScenario(file);
+  obstacle_t o1(3, 2), o2(4, 2);
+  o1 << 3, 1, 4, 2, 2, 2.5;
+  o2 << 5, -1, 5.5, -1, 5.5, 2, 5, 2;
+  built.addObstacle(o1);
+  built.addObstacle(o2);
+  built.addLandmark(7, 8);
+  built.addPost(10, 0, 10, 0.5);
+  built.addGate(-4, 3, 3.14159, 2.0, -4, 3);
+  built.setStartPose(pose_t(1, 2, 0.5));
+  bool same = parsed && sameWorld(loaded, built);
+  std::cout << "text scenario: " << (same ? "ok" : "differs: " + error) << std::endl;
+  failures += !same;
+
+  std::istringstream bad("obstacle 1 2 3\n");
+  Scenario ignored;
+  bool refused = !parseScenario(bad, ignored, error);
+  std::cout << "malformed text: " << (refused ? error : "accepted") << std::endl;
+  failures += !refused;
+  World world_1d(false, true);
+  failures += world_1d.loadScenario(file);
+
+  // Damaged binary files are refused
+  std::ifstream in(path, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  for (size_t cut : {data.size() - 8, (size_t) 20}) {
+    std::ofstream(path, std::ios::binary).write(data.data(), (std::streamsize) cut);
+    failures += ScenarioFile(path).ok();
+  }
+  std::string bad_offsets = data;
+  bad_offsets[72 + 8] = 100; // first obstacle's end vertex
+  std::ofstream(path, std::ios::binary).write(bad_offsets.data(), (std::streamsize) data.size());
+  failures += ScenarioFile(path).ok();
+
+  // A large course loads within LOAD_BUDGET_MS, even in an unoptimised build, and matches
+  // adding its obstacles one by one
+  const double LOAD_BUDGET_MS = 700;
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  Scenario large;
+  for (int i = 0; i < 100000; i++) {
+    double cx = 2000 * unit(gen) - 1000, cy = 2000 * unit(gen) - 1000;
+    obstacle_t o(5, 2);
+    for (int j = 0; j < 5; j++) {
+      o(j, 0) = cx + cos(2 * M_PI * j / 5) * (0.5 + unit(gen));
+      o(j, 1) = cy + sin(2 * M_PI * j / 5) * (0.5 + unit(gen));
+    }
+    large.obstacles.push_back(o);
+  }
+  writeScenario(path, large);
+  auto start = std::chrono::steady_clock::now();
+  World big(true, true);
+  ScenarioFile big_file(path);
+  bool big_ok = big.loadScenario(big_file);
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  World big_built(true, true);
+  for (const obstacle_t &o : large.obstacles) big_built.addObstacle(o);
+  big_built.setStartPose(pose_t(0, 0, 0));
+  big_ok = big_ok && sameWorld(big, big_built);
+  std::cout << "100000 obstacles: loaded in " << ms << " ms (budget " << LOAD_BUDGET_MS
+            << " ms)" << (big_ok ? "" : ", but differ") << std::endl;
+  failures += !big_ok;
+  failures += ms > LOAD_BUDGET_MS;
+
+  std::remove(path.c_str());
+  return failures == 0 ? 0 : 1;
+}
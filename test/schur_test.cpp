@@ -0,0 +1,48 @@
+
+#include "graph.h"
+#include "factors.h"
+#include <iostream>
+#include <Eigen/LU>
+
+// Builds a small landmark graph (2 landmarks, 4 poses) and checks that eliminating
+// the landmarks gives the same solution and covariance as solving the full system.
+void buildGraph(Graph &g) {
+  covariance<2> lm_cov_inv = covariance<2>::Identity() / (0.1 * 0.1);
+  covariance<2> prior_cov_inv = covariance<2>::Identity() / (20.0 * 20.0);
+  covariance<3> odom_cov_inv = covariance<3>::Identity() / (0.05 * 0.05);
+  covariance<3> pose_prior_inv = covariance<3>::Identity() / (0.01 * 0.01);
+  int L = 2 * 2;
+  g.add(new LandmarkFactor2D(0, -1, prior_cov_inv, measurement<2> {0, 0}));
+  g.add(new LandmarkFactor2D(2, -1, prior_cov_inv, measurement<2> {0, 0}));
+  g.add(new OdomFactor2D(L, -1, pose_prior_inv, measurement<3> {0, 0, 0}));
+  for (int t = 1; t < 4; t++) {
+    g.add(new OdomFactor2D(L + 3*t, L + 3*(t-1), odom_cov_inv, measurement<3> {1.0, 0, 0.1}));
+  }
+  for (int t = 0; t < 4; t++) {
+    g.add(new LandmarkFactor2D(0, L + 3*t, lm_cov_inv, measurement<2> {3.0 - t, 1.0 + 0.1*t}));
+    g.add(new LandmarkFactor2D(2, L + 3*t, lm_cov_inv, measurement<2> {2.0 - t, -1.0 + 0.2*t}));
+  }
+}
+
+int main() {
+  values x0 = values::Zero(2*2 + 3*4);
+  x0.tail(12) << 0, 0, 0,  1, 0, 0.1,  2, 0.2, 0.2,  3, 0.5, 0.3;
+
+  Graph full;
+  buildGraph(full);
+  full.solve(x0);
+
+  Graph reduced;
+  buildGraph(reduced);
+  reduced.eliminateLandmarks(2);
+  reduced.solve(x0);
+
+  double sol_err = (full.solution() - reduced.solution()).norm();
+  double cov_err = (full.covariance() - reduced.covariance()).norm();
+  std::cout << "Full solution:\n" << full.solution().transpose() << std::endl;
+  std::cout << "Reduced solution:\n" << reduced.solution().transpose() << std::endl;
+  std::cout << "Solution difference: " << sol_err << std::endl;
+  std::cout << "Covariance difference: " << cov_err << std::endl;
+
+  return (sol_err < 1e-8 && cov_err < 1e-8) ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#include "sensor_log.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+namespace {
+
+bool same(const SensorReading &a, const SensorReading &b) {
+  if (a.type != b.type || a.stamp != b.stamp || a.points.size() != b.points.size() ||
+      a.transform != b.transform || a.truth != b.truth)
+    return false;
+  for (size_t i = 0; i < a.points.size(); i++) {
+    if (a.points[i] != b.points[i]) return false;
+  }
+  return true;
+}
+
+// Reads the whole log; returns how many readings matched `expected`, in order
+int readBack(const std::string &path, const std::vector<SensorReading> &expected, bool &ok) {
+  SensorLogReader log(path);
+  SensorReading r;
+  int n = 0;
+  while (log.next(r)) {
+    if ((size_t) n >= expected.size() || !same(r, expected[(size_t) n])) break;
+    n++;
+  }
+  ok = log.ok();
+  return n;
+}
+
+void writeFile(const std::string &path, const std::string &data) {
+  std::ofstream(path, std::ios::binary).write(data.data(), (std::streamsize) data.size());
+}
+
+}
+
+// Writes random readings to a log and reads them back, whole, truncated and corrupted.
+int main() {
+  const std::string path = "sensor_log_test.log";
+  const int chunk_size = 16;
+  std::mt19937 gen(5);
+  std::normal_distribution<double> normal;
+  points_t landmarks = {point_t(1, 2, 1), point_t(-3, 0.5, 1)};
+
+  std::vector<SensorReading> readings;
+  for (int i = 0; i < 200; i++) {
+    SensorReading r{SensorType(i % NUM_SENSOR_TYPES), 0.1 * i, {}, transform_t::Random(),
+                    transform_t::Random()};
+    int num_points = r.type == LIDAR_SENSOR ? 300 : r.type == LANDMARK_SENSOR ? 6 : 0;
+    for (int j = 0; j < num_points; j++) r.points.push_back(point_t(normal(gen), normal(gen), 1));
+    readings.push_back(r);
+  }
+  {
+    SensorLogWriter log(path, false, landmarks, chunk_size);
+    for (const SensorReading &r : readings) log.record(r);
+    log.close();
+    if (!log.ok()) {
+      std::cout << "writing failed" << std::endl;
+      return 1;
+    }
+  }
+
+  int failures = 0;
+  bool ok = false;
+  SensorLogReader header(path);
+  bool header_ok = header.ok() && !header.is2D() && header.trueLandmarks() == landmarks;
+  int n = readBack(path, readings, ok);
+  std::cout << "whole log: " << n << " of " << readings.size() << " readings" << std::endl;
+  failures += !header_ok || !ok || n != (int) readings.size();
+
+  std::ifstream in(path, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  // A log cut off mid-chunk (its writer was killed) ends at the last whole chunk
+  writeFile(path, data.substr(0, data.size() * 2 / 3));
+  n = readBack(path, readings, ok);
+  std::cout << "truncated log: " << n << " readings" << std::endl;
+  failures += !ok || n == 0 || n % chunk_size != 0 || n >= (int) readings.size();
+
+  // A flipped bit in a chunk is caught by its checksum
+  std::string damaged = data;
+  damaged[data.size() / 2] ^= 0x10;
+  writeFile(path, damaged);
+  n = readBack(path, readings, ok);
+  std::cout << "damaged log: " << n << " readings, " << (ok ? "not detected" : "detected")
+            << std::endl;
+  failures += ok || n % chunk_size != 0;
+
+  writeFile(path, "not a log");
+  failures += SensorLogReader(path).ok();
+  std::remove(path.c_str());
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#include "world.h"
+#include <Eigen/LU>
+#include <cmath>
+#include <iostream>
+
+// Subscribes to every sensor of a headless world with different rates and latencies,
+// steps it in uneven increments and checks when each reading was taken and delivered.
+int main() {
+  World w(true, true);
+  w.useRandomStreams(3, 0);
+  w.addDefaultLandmarks();
+  w.setSensorRate(LIDAR_SENSOR, 5.0, 0.05);
+  w.setSensorRate(GPS_SENSOR, 1.0, 0.3);
+
+  std::vector<SensorReading> received[NUM_SENSOR_TYPES];
+  std::vector<double> delivered[NUM_SENSOR_TYPES];
+  for (int s = 0; s < NUM_SENSOR_TYPES; s++) {
+    w.subscribe(SensorType(s), [&, s](const SensorReading &r) {
+      received[s].push_back(r);
+      delivered[s].push_back(w.time());
+    });
+  }
+  w.start();
+  w.setCmdVel(0.1, 0.5);
+  for (int i = 0; i < 8; i++) w.step(0.2501);
+
+  int failures = 0;
+  // Expected: samples at k / rate for every k with k / rate + latency <= 2.0008
+  const double rates[NUM_SENSOR_TYPES] = {5.0, 10.0, 1.0, 30.0};
+  const double latencies[NUM_SENSOR_TYPES] = {0.05, 0.0, 0.3, 0.0};
+  const char *names[NUM_SENSOR_TYPES] = {"lidar", "landmarks", "gps", "odom"};
+  for (int s = 0; s < NUM_SENSOR_TYPES; s++) {
+    size_t expected = (size_t) std::floor((8 * 0.2501 - latencies[s]) * rates[s] + 1e-6) + 1;
+    bool ok = received[s].size() == expected;
+    for (size_t k = 0; ok && k < received[s].size(); k++) {
+      const SensorReading &r = received[s][k];
+      ok = r.type == s && std::abs(r.stamp - k / rates[s]) < 1e-9 &&
+           std::abs(delivered[s][k] - (r.stamp + latencies[s])) < 1e-9;
+    }
+    std::cout << names[s] << ": " << received[s].size() << " readings (expected " << expected
+              << ")" << (ok ? "" : ", wrong stamps or delivery times") << std::endl;
+    failures += !ok;
+  }
+
+  // Odometry readings are of the pose after each physics tick
+  const SensorReading &last_odom = received[ODOM_SENSOR].back();
+  bool odom_ok = (last_odom.transform - w.readOdom()).norm() < 1e-12 &&
+                 (last_odom.truth - w.readTrueTransform()).norm() < 1e-12;
+  if (!odom_ok) std::cout << "last odometry reading is not the current odometry" << std::endl;
+  failures += !odom_ok;
+  return failures == 0 ? 0 : 1;
+}
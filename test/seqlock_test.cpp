@@ -0,0 +1,47 @@
+#include "seqlock.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+struct Sample {
+  double values[19];
+};
+
+// One thread stores samples whose fields all equal a counter while readers check that
+// every sample they load is whole (all fields equal) and that the counter never goes back.
+int main() {
+  const int num_stores = 2000000;
+  SeqLock<Sample> lock;
+  std::atomic<bool> done(false);
+  std::atomic<int> torn(0), backwards(0);
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 3; r++) {
+    readers.emplace_back([&] {
+      double last = 0;
+      while (!done) {
+        Sample s = lock.load();
+        for (double v : s.values) {
+          if (v != s.values[0]) {
+            torn++;
+            break;
+          }
+        }
+        if (s.values[0] < last) backwards++;
+        last = s.values[0];
+      }
+    });
+  }
+  for (int i = 1; i <= num_stores; i++) {
+    Sample s;
+    for (double &v : s.values) v = i;
+    lock.store(s);
+  }
+  done = true;
+  for (std::thread &t : readers) t.join();
+
+  bool ok = torn == 0 && backwards == 0 && lock.load().values[18] == num_stores;
+  std::cout << torn << " torn reads, " << backwards << " out of order" << std::endl;
+  return ok ? 0 : 1;
+}
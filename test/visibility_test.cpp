@@ -0,0 +1,71 @@
+#include "visibility.h"
+#include "obstacle_grid.h"
+#include <Eigen/LU>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+// Compares beam ranges sampled from the visibility polygon against casting each beam
+// with obstacleIntersection, on a field of random (overlapping) pentagons, and times
+// both for increasing beam counts. From a thousand beams the sweep must be the faster.
+int main() {
+  const double max_range = 5.6;
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  ObstacleGrid grid;
+  for (int i = 0; i < 1500; i++) {
+    double cx = 100 * unit(gen) - 50, cy = 100 * unit(gen) - 50;
+    obstacle_t o(5, 2);
+    for (int j = 0; j < 5; j++) {
+      double theta = 2 * M_PI * j / 5;
+      double dist = 0.3 + 2.0 * unit(gen);
+      o(j, 0) = cx + cos(theta) * dist;
+      o(j, 1) = cy + sin(theta) * dist;
+    }
+    grid.add(o);
+  }
+
+  int failures = 0;
+  for (int beams : {100, 1000, 10000}) {
+    int mismatches = 0, hits = 0;
+    double sweep_ms = 0, rays_ms = 0;
+    for (int k = 0; k < 20; k++) {
+      pose_t pose(80 * unit(gen) - 40, 80 * unit(gen) - 40, 2 * M_PI * unit(gen) - M_PI);
+      transform_t tf = toTransform(pose);
+      transform_t tf_inv = tf.inverse();
+      point_t robot_location(pose(0), pose(1), 1);
+
+      auto start = std::chrono::steady_clock::now();
+      VisibilityPolygon visible(sensorFrameEdges(tf, grid,
+            grid.obstaclesNear(pose(0), pose(1), max_range), max_range));
+      std::vector<double> swept;
+      for (int j = 0; j < beams; j++) {
+        double angle = -M_PI + (j + 0.5) * 2 * M_PI / beams;
+        swept.push_back(visible.range(angle));
+      }
+      auto mid = std::chrono::steady_clock::now();
+      std::vector<double> cast;
+      for (int j = 0; j < beams; j++) {
+        double angle = -M_PI + (j + 0.5) * 2 * M_PI / beams;
+        point_t r1(max_range * cos(angle), max_range * sin(angle), 1);
+        cast.push_back(obstacleIntersection(robot_location, tf_inv * r1, grid) * max_range);
+      }
+      auto end = std::chrono::steady_clock::now();
+      sweep_ms += std::chrono::duration<double, std::milli>(mid - start).count();
+      rays_ms += std::chrono::duration<double, std::milli>(end - mid).count();
+
+      for (int j = 0; j < beams; j++) {
+        bool hit = cast[(size_t) j] < max_range;
+        if (hit) hits++;
+        bool same = hit ? std::abs(swept[(size_t) j] - cast[(size_t) j]) < 1e-9
+                        : swept[(size_t) j] >= max_range;
+        if (!same) mismatches++;
+      }
+    }
+    std::cout << beams << " beams: " << hits << " hits, " << mismatches << " mismatches; "
+              << "sweep " << sweep_ms / 20 << " ms, per-ray " << rays_ms / 20 << " ms per scan"
+              << std::endl;
+    failures += mismatches != 0 || (beams >= 1000 && sweep_ms >= rays_ms);
+  }
+  return failures == 0 ? 0 : 1;
+}
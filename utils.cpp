@@ -1,12 +1,12 @@
+#include <algorithm>
 #include <random>
 #include <chrono>
+#include <cmath>
 #include <Eigen/LU>
 #include "utils.h"
 #include "constants.h"
 #include <iostream>
 
-bool IS_2D { true };
-
 points_t transformReadings(const points_t &ps, const transform_t &tf) {
   transform_t tf_inv = tf.inverse();
   points_t readings({});
@@ -34,31 +34,22 @@ bool inRange(const point_t &p, const obstacle_t &obs) {
   return ((p-op).norm() < 2*NavSim::OBSTACLE_MAX_SIZE);
 }
 
-bool collides(const transform_t &tf, const obstacles_t &obss)
+bool rayEdgeIntersection(double rx, double ry, double dx, double dy,
+                         double px, double py, double ex, double ey, double *t)
 {
-  pose_t p = toPose(tf,0);
-  for (const obstacle_t &obs : obss)
+  // Solve r + t0*d = p + t1*e by Cramer's rule, with n = (ey, -ex) the edge normal.
+  // The FMAs are explicit so the compiler can't contract these differently from the
+  // vector kernel in obstacle_grid.cpp.
+  double nx = ey, ny = -ex;
+  double bx = rx - px, by = ry - py;
+  double det = -std::fma(dx, nx, dy*ny);
+  if (det == 0.0) return false;
+  double t0 = std::fma(bx, nx, by*ny) / det;
+  double t1 = std::fma(bx, dy, -(dx*by)) / det;
+  if (t1 >= 0.0 && t1 <= 1.0 && t0 >= 0.0)
   {
-    if (!inRange(p, obs)) continue;
-    int n = obs.rows();
-    bool inside = true;
-    for(int i = 0; i < n; i++) {
-      point_t p0, p1;
-      p0 << obs(i,0), obs(i,1), 1;
-      if (i < (n-1)) {
-        p1 << obs(i+1,0), obs(i+1,1), 1;
-      } else {
-        p1 << obs(0,0), obs(0,1), 1;
-      }
-      p0 = tf*p0;
-      p1 = tf*p1;
-      // TODO handle actual robot footprints rather than single points
-      if (p0(0)*p1(1) - p1(0)*p0(1) < 0) {
-        inside = false;
-        break;
-      }
-    }
-    if (inside) return true;
+    *t = t0;
+    return true;
   }
   return false;
 }
@@ -66,19 +57,32 @@ bool collides(const transform_t &tf, const obstacles_t &obss)
 bool segmentIntersection(const point_t &r0, const point_t &r1,
                          const point_t &p0, const point_t &p1, double *t)
 {
-  Eigen::Matrix2d A;
-  Eigen::Vector2d b;
-  b = r0.topRows(2) - p0.topRows(2);
-  A.col(0) = r0.topRows(2) - r1.topRows(2);
-  A.col(1) = p1.topRows(2) - p0.topRows(2);
-  if (A.determinant() == 0.0) return false;
-  Eigen::Vector2d tt = A.inverse() * b;
-  if (tt(1) >= 0.0 && tt(1) <= 1.0 && tt(0) >= 0.0 && tt(1) <= 1.0)
+  return rayEdgeIntersection(r0(0), r0(1), r1(0) - r0(0), r1(1) - r0(1),
+                             p0(0), p0(1), p1(0) - p0(0), p1(1) - p0(1), t);
+}
+
+double obstacleIntersection(const point_t &r0, const point_t &r1, const obstacle_t &obs)
+{
+  double min_t = 2.0;
+  int n = obs.rows();
+  for(int i = 0; i < n; i++)
   {
-    *t = tt(0);
-    return true;
+    point_t p0, p1;
+    p0 << obs(i,0), obs(i,1), 1;
+    if (i < (n-1)) {
+      p1 << obs(i+1,0), obs(i+1,1), 1;
+    } else {
+      p1 << obs(0,0), obs(0,1), 1;
+    }
+
+    double t;
+    if (segmentIntersection(r0, r1, p0, p1, &t)) {
+      if (t < min_t) {
+        min_t = t;
+      }
+    }
   }
-  return false;
+  return min_t;
 }
 
 // returns: Fraction of distance along the segment r0->r1 where the segment hits an obstacle.
@@ -90,24 +94,7 @@ double obstacleIntersection(const point_t &r0, const point_t &r1, const obstacle
   for (const obstacle_t &obs : obss)
   {
     if (!inRange(r0, obs)) continue;
-    int n = obs.rows();
-    for(int i = 0; i < n; i++)
-    {
-      point_t p0, p1;
-      p0 << obs(i,0), obs(i,1), 1;
-      if (i < (n-1)) {
-        p1 << obs(i+1,0), obs(i+1,1), 1;
-      } else {
-        p1 << obs(0,0), obs(0,1), 1;
-      }
-
-      double t;
-      if (segmentIntersection(r0, r1, p0, p1, &t)) {
-        if (t < min_t) {
-          min_t = t;
-        }
-      }
-    }
+    min_t = std::min(min_t, obstacleIntersection(r0, r1, obs));
   }
 
   return min_t;
@@ -173,6 +160,13 @@ long getNormalSeed() {
   return seed;
 }
 
+void setNormalSeed(long new_seed) {
+  seed = new_seed;
+  main_generator.seed(static_cast<std::default_random_engine::result_type>(seed));
+  spin_generator.seed(static_cast<std::default_random_engine::result_type>(seed));
+  stdn_dist.reset();
+}
+
 double stdn(int thread_id) {
   if (thread_id == 0) return stdn_dist(main_generator);
   else return stdn_dist(spin_generator);
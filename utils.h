@@ -4,8 +4,6 @@
 #include <Eigen/Core>
 #include <vector>
 
-extern bool IS_2D;
-
 /* Obstacles are specifed as a list of 2D vertices. Must be convex.
  * Do not repeat the starting vertex at the end. */
 using obstacle_t = Eigen::ArrayX2d;
@@ -29,8 +27,8 @@ struct URCLeg {
 points_t transformReadings(const points_t &ps, const transform_t &tf);
 trajectory_t transformTraj(const trajectory_t &traj, const transform_t &tf);
 
-/* Whether the robot in location given by `tf` collides with anything. */
-bool collides(const transform_t &tf, const obstacles_t &obss);
+/* Whether the robot in location given by `tf` is within `radius` of a landmark. See
+ * footprintCollides in obstacle_grid.h for obstacles. */
 bool collides(const transform_t &tf, const points_t &lms, double radius);
 
 /* Returns the smallest number t in the unit interval [0,1] such that
@@ -38,6 +36,15 @@ bool collides(const transform_t &tf, const points_t &lms, double radius);
  * returns t=2.0. */
 double obstacleIntersection(const point_t &r0, const point_t &r1, const obstacles_t &obss);
 
+/* Single-obstacle building block of the above, for spatial indexes (see obstacle_grid.h):
+ * the smallest t over the edges of `obs`, or 2.0. */
+double obstacleIntersection(const point_t &r0, const point_t &r1, const obstacle_t &obs);
+
+/* The ray (rx, ry) + t(dx, dy), t >= 0, against the edge (px, py) + s(ex, ey), 0 <= s <= 1.
+ * Sets t and returns true if they cross. obstacleIntersection is built on this. */
+bool rayEdgeIntersection(double rx, double ry, double dx, double dy,
+                         double px, double py, double ex, double ey, double *t);
+
 /* Left-multiplying a (map-frame) point_t by this matrix will give the
  * corresponding point_t in the frame that was rotated counterclockwise
  * by theta, then shifted by (x,y) along the new (x,y)-axes.
@@ -73,5 +80,7 @@ transform_t toTransform(const pose_t &pose);
 double stdn(int thread_id);
 // Returns the random seed used for the stdn() function
 long getNormalSeed();
+// Restarts both sequences of stdn() from the given seed (World::start also seeds rand())
+void setNormalSeed(long seed);
 
 #endif
@@ -0,0 +1,249 @@
+#include "visibility.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <set>
+
+namespace {
+
+double cross(const Eigen::Vector2d &a, const Eigen::Vector2d &b) {
+  return a(0) * b(1) - a(1) * b(0);
+}
+
+// Distance along the ray at `angle` to the line through the edge
+double rayDistance(const VisibilityPolygon::Edge &e, double angle) {
+  double dx = cos(angle), dy = sin(angle);
+  double x0 = e.p0.x(), y0 = e.p0.y(), vx = e.p1.x() - x0, vy = e.p1.y() - y0;
+  double denom = dx * vy - dy * vx;
+  if (denom == 0.0) return std::min(e.p0.norm(), e.p1.norm()); // edge points at the sensor
+  return (x0 * vy - y0 * vx) / denom;
+}
+
+// An edge as the sweep sees it, counterclockwise from the sensor: (x0, y0) + t (vx, vy)
+// for t in [0, 1], between the angles start and end
+struct SweepEdge {
+  double x0, y0, vx, vy;
+  double c; // cross(p0, v); the distance along the ray d is c / cross(d, v)
+  double start, end;
+
+  double distance(double dx, double dy) const { return c / (dx * vy - dy * vx); }
+};
+
+// Events at the same angle are handled ends first, so that an edge ending where the next
+// one starts (a polygon's vertex) is never compared with it
+enum EventType { END = 0, CROSSING = 1, START = 2 };
+
+struct Event {
+  double angle;
+  EventType type;
+  int a, b; // the edge; for crossings, the nearer edge before the crossing and the farther
+
+  bool operator<(const Event &o) const {
+    return angle != o.angle ? angle < o.angle : type < o.type;
+  }
+  bool operator>(const Event &o) const { return o < *this; }
+};
+
+/* The edges crossed by the sweep ray, nearest first, in a set ordered by distance along
+ * the ray at the sweep's current angle. The order only changes where two neighbours in it
+ * cross; there the two are taken out and put back in their new order. Starts and ends
+ * are known up front and sorted once; crossings are queued as they are found. */
+class Sweep {
+public:
+  explicit Sweep(const std::vector<SweepEdge> &edges)
+      : _edges(edges), _angle(-M_PI), _dx(-1), _dy(0), _active(Nearer{this}),
+        _where(edges.size()), _open(edges.size(), false), _events(), _next(0), _crossings() {
+    _events.reserve(2 * edges.size());
+    for (size_t i = 0; i < edges.size(); i++) {
+      _events.push_back({edges[i].start, START, (int) i, -1});
+      _events.push_back({edges[i].end, END, (int) i, -1});
+    }
+    std::sort(_events.begin(), _events.end());
+  }
+
+  bool done() const { return _next == _events.size() && _crossings.empty(); }
+  double nextAngle() const { return peek().angle; }
+
+  // Handles the next event; returns the nearest edge after it, or -1 if there is none
+  int step() {
+    Event e = peek();
+    if (e.type == CROSSING) _crossings.pop();
+    else _next++;
+    if (e.angle != _angle) {
+      _angle = e.angle;
+      _dx = cos(e.angle);
+      _dy = sin(e.angle);
+    }
+    if (e.type == START) {
+      insert(e.a);
+    } else if (e.type == END) {
+      auto it = _where[(size_t) e.a];
+      auto next = std::next(it);
+      if (it != _active.begin() && next != _active.end()) scheduleCrossing(*std::prev(it), *next);
+      _active.erase(it);
+      _open[(size_t) e.a] = false;
+    } else if (_open[(size_t) e.a] && _open[(size_t) e.b] &&
+               std::next(_where[(size_t) e.a]) != _active.end() &&
+               *std::next(_where[(size_t) e.a]) == e.b) {
+      // Still neighbours in the old order (the same crossing may have been found twice)
+      _active.erase(_where[(size_t) e.a]);
+      _active.erase(_where[(size_t) e.b]);
+      insert(e.b);
+      insert(e.a);
+    }
+    return _active.empty() ? -1 : *_active.begin();
+  }
+
+private:
+  struct Nearer {
+    const Sweep *sweep;
+    bool operator()(int a, int b) const { return sweep->nearer(a, b); }
+  };
+
+  const std::vector<SweepEdge> &_edges;
+  double _angle, _dx, _dy; // the sweep ray
+  std::set<int, Nearer> _active;
+  std::vector<std::set<int, Nearer>::iterator> _where;
+  std::vector<bool> _open;
+  std::vector<Event> _events; // starts and ends, sorted
+  size_t _next;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> _crossings;
+
+  const Event &peek() const {
+    if (_next == _events.size()) return _crossings.top();
+    if (_crossings.empty() || !(_crossings.top() < _events[_next])) return _events[_next];
+    return _crossings.top();
+  }
+
+  bool nearer(int a, int b) const {
+    if (a == b) return false;
+    const SweepEdge &ea = _edges[(size_t) a], &eb = _edges[(size_t) b];
+    double da = ea.distance(_dx, _dy), db = eb.distance(_dx, _dy);
+    if (std::abs(da - db) > 1e-12 * (1.0 + std::abs(da))) return da < db;
+    // The edges meet on the ray (a shared vertex or a crossing): the nearer one is the
+    // one that is nearer just past it, halfway to where the first of them ends
+    double ahead = 0.5 * (_angle + std::min(ea.end, eb.end));
+    double dx = cos(ahead), dy = sin(ahead);
+    da = ea.distance(dx, dy);
+    db = eb.distance(dx, dy);
+    return da != db ? da < db : a < b;
+  }
+
+  void insert(int id) {
+    auto it = _active.insert(id).first;
+    _where[(size_t) id] = it;
+    _open[(size_t) id] = true;
+    if (it != _active.begin()) scheduleCrossing(*std::prev(it), id);
+    if (std::next(it) != _active.end()) scheduleCrossing(id, *std::next(it));
+  }
+
+  // Queues the crossing of two neighbours, `near` in front of `far`, if it is ahead
+  void scheduleCrossing(int near, int far) {
+    const SweepEdge &a = _edges[(size_t) near], &b = _edges[(size_t) far];
+    double denom = a.vx * b.vy - a.vy * b.vx;
+    if (denom == 0.0) return;
+    double wx = b.x0 - a.x0, wy = b.y0 - a.y0;
+    double ta = (wx * b.vy - wy * b.vx) / denom;
+    double tb = (wx * a.vy - wy * a.vx) / denom;
+    if (!(ta > 0.0 && ta < 1.0 && tb > 0.0 && tb < 1.0)) return;
+    double angle = atan2(a.y0 + ta * a.vy, a.x0 + ta * a.vx);
+    if (angle > _angle) _crossings.push({angle, CROSSING, near, far});
+  }
+};
+
+}
+
+VisibilityPolygon::VisibilityPolygon(const std::vector<Edge> &edges)
+    : _edges(), _angles(), _closest() {
+  // Orient every edge counterclockwise as seen from the sensor. Edges that wrap past pi
+  // are split where they cross the negative x axis, so that the sweep covers (-pi, pi].
+  std::vector<SweepEdge> sweep_edges;
+  auto addEdge = [&](const Edge &e) {
+    double start = atan2(e.p0(1), e.p0(0)), end = atan2(e.p1(1), e.p1(0));
+    if (start == M_PI) start = -M_PI;
+    if (end == -M_PI) end = M_PI;
+    if (end <= start) return;
+    Eigen::Vector2d v = e.p1 - e.p0;
+    _edges.push_back(e);
+    sweep_edges.push_back({e.p0(0), e.p0(1), v(0), v(1), cross(e.p0, v), start, end});
+  };
+  for (const Edge &e : edges) {
+    double c = cross(e.p0, e.p1);
+    if (c == 0.0) continue;
+    Edge oriented = c > 0 ? e : Edge{e.p1, e.p0};
+    if (oriented.p0(1) > 0 && oriented.p1(1) < 0) {
+      // Through the negative x axis (crossing the positive one would be clockwise)
+      Eigen::Vector2d x = oriented.p0 + oriented.p0(1) / (oriented.p0(1) - oriented.p1(1)) *
+          (oriented.p1 - oriented.p0);
+      x(1) = 0.0;
+      addEdge({oriented.p0, x});
+      addEdge({x, oriented.p1});
+    } else {
+      addEdge(oriented);
+    }
+  }
+  if (_edges.empty()) return;
+
+  // The nearest edge can only change at an event, so the polygon has one range per run
+  // of events with the same nearest edge
+  Sweep sweep(sweep_edges);
+  while (!sweep.done()) {
+    double angle = sweep.nextAngle();
+    int nearest = -1;
+    while (!sweep.done() && sweep.nextAngle() == angle) nearest = sweep.step();
+    if (!_closest.empty() && nearest == _closest.back()) continue;
+    _angles.push_back(angle);
+    _closest.push_back(nearest);
+  }
+  // Past the last event nothing is open: that angle just closes the last range
+  _closest.pop_back();
+}
+
+double VisibilityPolygon::range(double angle) const {
+  auto it = std::upper_bound(_angles.begin(), _angles.end(), angle);
+  if (it == _angles.begin()) return INFINITY;
+  size_t k = (size_t) (it - _angles.begin()) - 1;
+  // Rays exactly at the last angle belong to the range before it
+  if (k == _closest.size() && k > 0 && angle == _angles[k]) k--;
+  if (k >= _closest.size() || _closest[k] == -1) return INFINITY;
+  return rayDistance(_edges[(size_t) _closest[k]], angle);
+}
+
+size_t VisibilityPolygon::size() const {
+  return _closest.size();
+}
+
+std::vector<VisibilityPolygon::Edge> sensorFrameEdges(const transform_t &tf,
+    const ObstacleGrid &grid, const std::vector<int> &ids, double max_range) {
+  std::vector<VisibilityPolygon::Edge> edges;
+  std::vector<double> xs, ys;
+  for (int id : ids) {
+    const double *obs_x, *obs_y;
+    size_t n = (size_t) grid.vertices(id, obs_x, obs_y);
+    xs.resize(n);
+    ys.resize(n);
+    double area = 0;
+    bool inside = false;
+    for (size_t i = 0; i < n; i++) {
+      xs[i] = tf(0,0) * obs_x[i] + tf(0,1) * obs_y[i] + tf(0,2);
+      ys[i] = tf(1,0) * obs_x[i] + tf(1,1) * obs_y[i] + tf(1,2);
+    }
+    for (size_t i = 0, j = n - 1; i < n; j = i++) {
+      area += xs[j] * ys[i] - ys[j] * xs[i];
+      // Crossings of the positive x axis: odd if the sensor is inside the obstacle
+      if ((ys[i] > 0) != (ys[j] > 0) && xs[j] - ys[j] * (xs[i] - xs[j]) / (ys[i] - ys[j]) > 0)
+        inside = !inside;
+    }
+    for (size_t i = 0; i < n; i++) {
+      size_t j = (i + 1) % n;
+      // From outside, a ray has to go through a front face before it can reach a back
+      // face (one the sensor is on the inner side of), so back faces are never seen
+      if (!inside && (xs[i] * ys[j] - ys[i] * xs[j]) * area >= 0) continue;
+      double vx = xs[j] - xs[i], vy = ys[j] - ys[i], len_sq = vx * vx + vy * vy;
+      double t = len_sq > 0 ? std::max(0.0, std::min(1.0, -(xs[i] * vx + ys[i] * vy) / len_sq)) : 0;
+      if (std::hypot(xs[i] + t * vx, ys[i] + t * vy) > max_range) continue;
+      edges.push_back({Eigen::Vector2d(xs[i], ys[i]), Eigen::Vector2d(xs[j], ys[j])});
+    }
+  }
+  return edges;
+}
@@ -0,0 +1,48 @@
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+#include <Eigen/Core>
+#include <vector>
+#include "utils.h"
+#include "obstacle_grid.h"
+
+/* Everything visible from a sensor at the origin: for each range of angles, the obstacle
+ * edge that is closest along every ray in that range. Built once per scan with an
+ * angular sweep over the edges; after that each beam is a binary search plus one
+ * ray/line intersection, so the cost of a scan hardly depends on the number of beams.
+ *
+ * The sweep keeps the edges crossed by the sweep ray ordered by distance along it, and
+ * visits the edges' endpoints and the crossings of edges that are next to each other in
+ * that order (overlapping obstacles): O((E + I) log E) for E edges with I crossings.
+ *
+ * Angles are in (-pi, pi], measured from the x axis of the sensor frame. */
+class VisibilityPolygon {
+public:
+  struct Edge {
+    Eigen::Vector2d p0, p1;
+  };
+
+  // Edges in the sensor frame. Edges through the sensor itself are ignored.
+  explicit VisibilityPolygon(const std::vector<Edge> &edges);
+
+  // Distance to the closest edge along the ray at `angle`, or INFINITY if there is none
+  double range(double angle) const;
+  // Number of angular ranges the polygon is made of
+  size_t size() const;
+
+private:
+  std::vector<Edge> _edges;
+  // Range k covers [_angles[k], _angles[k+1]) and its closest edge is _closest[k]
+  // (-1 if there is none)
+  std::vector<double> _angles;
+  std::vector<int> _closest;
+};
+
+/* Edges of the obstacles with the given indices, in the frame of the sensor at `tf`
+ * (world to sensor, like the robot's transform_t). Leaves out edges that can't be the
+ * closest along any ray: those facing away from the sensor (unless it is inside their
+ * obstacle) and those entirely beyond max_range. */
+std::vector<VisibilityPolygon::Edge> sensorFrameEdges(const transform_t &tf,
+    const ObstacleGrid &grid, const std::vector<int> &ids, double max_range = INFINITY);
+
+#endif
@@ -2,32 +2,67 @@
 #include "utils.h"
 #include "constants.h"
 #include "graphics.h"
+#include "visibility.h"
 #include <Eigen/LU>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <unistd.h>
 #include <iostream>
+#include <mutex>
 #include <time.h>
 #include <sys/time.h>
 #include <ctime>
 
 using namespace NavSim;
 
-constexpr long GPS_UPDATE_PERIOD_USECS = 1000 * 1000;
+constexpr double SIM_HZ = 30.;
+constexpr double GPS_UPDATE_PERIOD = 1.0; // s, in simulated time
+// Default sensor schedule (see World::setSensorRate)
+constexpr double LIDAR_HZ = 10.;
+constexpr double LANDMARK_HZ = 10.;
 
 constexpr int SPIN_THREAD = 1; // must be nonzero. zero refers to the main/client thread
 
+// Guards the global rand() sequence, which the URC layout depends on
+std::mutex rand_mutex;
+
+// WorldState keeps transforms as plain column-major arrays
+transform_t fromArray(const double *m) {
+  return Eigen::Map<const transform_t>(m);
+}
+
+void toArray(const transform_t &tf, double *m) {
+  Eigen::Map<transform_t> out(m);
+  out = tf;
+}
+
 const sf::Color TRUTH_COLOR(0,0,0,128);
 const sf::Color ODOM_COLOR(0,0,255,128);
 const sf::Color LIDAR_COLOR(255,0,0,128);
 const sf::Color LANDMARK_COLOR(0,0,255);
 
-World::World() : obstacles_({}), landmarks_({}),
-                    cmd_vel_x_(0), cmd_vel_theta_(0),
-                    current_transform_truth_(toTransform({15,0,M_PI})),
+World::World(bool is_2d, bool headless) : is_2d_(is_2d), headless_(headless),
+                    obstacles_(), landmarks_({}),
+                    cmd_vel_(CmdVel{0, 0}),
+                    current_transform_truth_(toTransform(is_2d ? pose_t(15,0,M_PI) : pose_t(-5,0,0))),
                     current_transform_odom_(toTransform({0,0,0})),
+                    sim_time_(0.0), state_(),
                     spin_thread_(), done_(false),
-                    legs_({}), window_("Simulator visualization"),
-                    last_gps_reading_()
+                    legs_({}),
+                    window_(headless ? nullptr : new MyWindow("Simulator visualization", is_2d)),
+                    last_gps_time_(0.0),
+                    own_streams_(false), streams_(),
+                    events_(), next_event_seq_(0),
+                    sensors_({{SensorSchedule{LIDAR_HZ, 0.0, {}},
+                              SensorSchedule{LANDMARK_HZ, 0.0, {}},
+                              SensorSchedule{1.0 / GPS_UPDATE_PERIOD, 0.0, {}},
+                              SensorSchedule{SIM_HZ, 0.0, {}}}}),
+                    render_lidar_{LIDAR_SENSOR, 0.0, {}, transform_t::Zero(), transform_t::Identity()},
+                    render_landmarks_{LANDMARK_SENSOR, 0.0, {}, transform_t::Zero(),
+                                      transform_t::Identity()}
 {
+  publishState();
 }
 
 World::~World() {
@@ -36,11 +71,11 @@ World::~World() {
 }
 
 void World::addObstacle(const obstacle_t &obs) {
-  obstacles_.push_back(obs);
+  obstacles_.add(obs);
 }
 
 int World::addLandmark(double x, double y) {
-  if (!IS_2D) y = 0.0;
+  if (!is_2d_) y = 0.0;
   point_t lm;
   lm << x, y, 1;
   landmarks_.push_back(lm);
@@ -88,6 +123,7 @@ void World::addURCObstacles() {
   // Leg 6: The path is strewn with obstacles
   addGate(100*SCALE, -200*SCALE, 1./2.*M_PI, 2.0, 100*SCALE, -200*SCALE);
   size_t seed = 2; // This seed seems to be best for difficult-but-still-possible obstacles
+  std::lock_guard<std::mutex> lock(rand_mutex);
   std::srand(seed);
   int n_obstacles = 256 * SCALE * SCALE;
   int obs_verts = 5;
@@ -160,6 +196,33 @@ void World::addDefaultLandmarks() {
   addLandmark(0.1*scale, 1*scale);
 }
 
+bool World::loadScenario(const ScenarioFile &scenario) {
+  if (!scenario.ok()) return false;
+  if (scenario.is2D() != is_2d_) {
+    printf("Can't load a %dD scenario into a %dD world\n", scenario.is2D() ? 2 : 1, is_2d_ ? 2 : 1);
+    return false;
+  }
+  obstacles_.addAll(scenario.vertices(), scenario.obstacleOffsets(), scenario.numObstacles());
+  int first_landmark = (int) landmarks_.size();
+  const double *lms = scenario.landmarks();
+  for (size_t i = 0; i < scenario.numLandmarks(); i++) {
+    addLandmark(lms[2 * i], lms[2 * i + 1]);
+  }
+  for (size_t i = 0; i < scenario.numLegs(); i++) {
+    URCLeg leg = scenario.leg(i);
+    leg.left_post_id += first_landmark;
+    if (leg.right_post_id >= 0) leg.right_post_id += first_landmark;
+    legs_.push_back(leg);
+  }
+  setStartPose(scenario.start());
+  return true;
+}
+
+void World::setStartPose(const pose_t &pose) {
+  current_transform_truth_ = toTransform(is_2d_ ? pose : pose_t(pose(0), 0, 0));
+  publishState();
+}
+
 long getElapsedUsecs(const struct timeval &tp_start) {
   struct timeval tp0;
   gettimeofday(&tp0, NULL);
@@ -168,23 +231,21 @@ long getElapsedUsecs(const struct timeval &tp_start) {
 }
 
 void World::spinSim() {
-  const double SIM_HZ = 30.;
-  const double dt = 1/SIM_HZ;
   struct timeval tp_start;
-  while (!done_) {
+  for (long frame = 1; !done_; frame++) {
     gettimeofday(&tp_start, NULL);
     int c = 0;
     while (c != -1)
     {
-      c = window_.pollWindowEvent(); // We ignore these events.
+      c = window_->pollWindowEvent(); // We ignore these events.
     }
-    moveRobot(cmd_vel_theta_ * dt, cmd_vel_x_ * dt);
-    window_.setOrigin(toPose(current_transform_truth_, 0.0));
-    window_.drawObstacles(obstacles_);
-    window_.drawPoints(landmarks_, TRUTH_COLOR, 4);
-    renderReadings(window_);
-    window_.drawRobot(current_transform_truth_, TRUTH_COLOR);
-    window_.display();
+    advanceTo(frame / SIM_HZ);
+    window_->setOrigin(toPose(current_transform_truth_, 0.0));
+    window_->drawObstacles(obstacles_.obstacles());
+    window_->drawPoints(landmarks_, TRUTH_COLOR, 4);
+    renderReadings(*window_);
+    window_->drawRobot(current_transform_truth_, TRUTH_COLOR);
+    window_->display();
     long desiredUsecs = 1000 * 1000 / SIM_HZ;
     long elapsedUsecs = getElapsedUsecs(tp_start);
     if (desiredUsecs - elapsedUsecs > 0) {
@@ -193,43 +254,157 @@ void World::spinSim() {
   }
 }
 
+// Draws the latest scheduled readings rather than taking new ones every frame
 void World::renderReadings(MyWindow &window) {
-  transform_t tf = current_transform_truth_;
-  points_t lidar = readLidar(SPIN_THREAD);
-  window.drawPoints(transformReadings(lidar, tf), LIDAR_COLOR, 3);
-  points_t lms = readLandmarks(SPIN_THREAD);
-  window.drawPoints(transformReadings(lms, tf), LANDMARK_COLOR, 4);
+  window.drawPoints(transformReadings(render_lidar_.points, render_lidar_.truth), LIDAR_COLOR, 3);
+  window.drawPoints(transformReadings(render_landmarks_.points, render_landmarks_.truth),
+                    LANDMARK_COLOR, 4);
 }
 
 void World::start() {
-  long seed = getNormalSeed();
-  printf("World simulator seed: %ld\n", seed);
-  std::srand(seed);
-  gettimeofday(&last_gps_reading_, NULL);
-  spin_thread_ = std::thread( [this] {spinSim();} );
+  if (!own_streams_) {
+    long seed = getNormalSeed();
+    printf("World simulator seed: %ld\n", seed);
+    std::lock_guard<std::mutex> lock(rand_mutex);
+    std::srand(seed);
+  }
+  last_gps_time_ = time();
+  if (!headless_) {
+    subscribe(LIDAR_SENSOR, [this](const SensorReading &r) { render_lidar_ = r; });
+    subscribe(LANDMARK_SENSOR, [this](const SensorReading &r) { render_landmarks_ = r; });
+  }
+  schedule(1 / SIM_HZ, PHYSICS, NUM_SENSOR_TYPES, 1);
+  for (int s = 0; s < NUM_SENSOR_TYPES; s++) {
+    if (!sensors_[(size_t) s].subscribers.empty()) {
+      schedule(0.0, SAMPLE, SensorType(s), 0);
+    }
+  }
+  if (!headless_) spin_thread_ = std::thread( [this] {spinSim();} );
+}
+
+void World::step(double dt) {
+  assert("step() is only for headless worlds" && headless_);
+  advanceTo(sim_time_ + dt);
+}
+
+void World::setSensorRate(SensorType type, double rate_hz, double latency) {
+  assert("sensor rates must be positive" && rate_hz > 0);
+  sensors_[type].rate_hz = rate_hz;
+  sensors_[type].latency = latency;
+}
+
+void World::subscribe(SensorType type, sensor_callback_t callback) {
+  sensors_[type].subscribers.push_back(callback);
+}
+
+bool World::LaterEvent::operator()(const SimEvent &a, const SimEvent &b) const {
+  if (a.time != b.time) return a.time > b.time;
+  if (a.kind != b.kind) return a.kind > b.kind; // the robot moves before sensors sample
+  return a.seq > b.seq;
+}
+
+void World::schedule(double time, EventKind kind, SensorType sensor, long count,
+                     std::shared_ptr<const SensorReading> reading) {
+  events_.push(SimEvent{time, kind, next_event_seq_++, sensor, count, reading});
+}
+
+// Runs every event up to t_end (allowing for rounding in the caller's sum of steps)
+void World::advanceTo(double t_end) {
+  while (!events_.empty() && events_.top().time <= t_end + 1e-9) {
+    SimEvent event = events_.top();
+    events_.pop();
+    if (event.time > sim_time_) {
+      sim_time_ = event.time;
+      publishState(); // callbacks and readings see the time of their event
+    }
+    handleEvent(event);
+  }
+  sim_time_ = std::max(sim_time_, t_end);
+  publishState();
+}
+
+void World::handleEvent(const SimEvent &event) {
+  switch (event.kind) {
+    case PHYSICS: {
+      CmdVel cmd = cmd_vel_.load();
+      moveRobot(cmd.theta / SIM_HZ, cmd.x / SIM_HZ);
+      publishState();
+      schedule((event.count + 1) / SIM_HZ, PHYSICS, event.sensor, event.count + 1);
+      break;
+    }
+    case SAMPLE: {
+      const SensorSchedule &s = sensors_[event.sensor];
+      std::shared_ptr<const SensorReading> reading(new SensorReading(sample(event.sensor)));
+      schedule(event.time + s.latency, DELIVER, event.sensor, event.count, reading);
+      schedule((event.count + 1) / s.rate_hz, SAMPLE, event.sensor, event.count + 1);
+      break;
+    }
+    case DELIVER:
+      for (const sensor_callback_t &callback : sensors_[event.sensor].subscribers) {
+        callback(*event.reading);
+      }
+      break;
+  }
+}
+
+SensorReading World::sample(SensorType type) {
+  transform_t truth = readTrueTransform();
+  SensorReading reading{type, time(), {}, transform_t::Zero(), truth};
+  switch (type) {
+    case LIDAR_SENSOR: reading.points = readLidar(SPIN_THREAD); break;
+    case LANDMARK_SENSOR: reading.points = readLandmarks(SPIN_THREAD); break;
+    case GPS_SENSOR: reading.transform = gpsFix(truth, SPIN_THREAD); break;
+    case ODOM_SENSOR: reading.transform = readOdom(); break;
+    case NUM_SENSOR_TYPES: break;
+  }
+  return reading;
+}
+
+double World::time() const {
+  return state_.load().time;
+}
+
+void World::publishState() {
+  WorldState state;
+  toArray(current_transform_truth_, state.truth);
+  toArray(current_transform_odom_, state.odom);
+  state.time = sim_time_;
+  state_.store(state);
+}
+
+void World::useRandomStreams(uint64_t seed, uint32_t run) {
+  assert("random streams are only for headless worlds" && headless_);
+  own_streams_ = true;
+  for (uint32_t s = 0; s < NUM_SENSORS; s++) {
+    streams_[s] = NormalStream(seed, run, s);
+  }
+}
+
+double World::noise(Sensor sensor, int thread_id) {
+  return own_streams_ ? streams_[sensor].next() : stdn(thread_id);
 }
 
 void World::setCmdVel(double d_theta, double d_x) {
-  cmd_vel_theta_ = d_theta;
-  cmd_vel_x_ = d_x;
+  cmd_vel_.store(CmdVel{d_theta, d_x});
 }
 
 // This should only be called from the spin thread for random seed reproducibility
 void World::moveRobot(double d_theta, double d_x) {
   double noisy_x(0.), noisy_theta(0.);
-  if (IS_2D) {
+  if (is_2d_) {
     double d_r = d_x + 0.5*ROBOT_WHEEL_BASE*d_theta;
     double d_l = d_x - 0.5*ROBOT_WHEEL_BASE*d_theta;
     // Larger distance means more noise
-    double noisy_r = d_r + stdn(SPIN_THREAD) * WHEEL_STD * sqrt(abs(d_r));
-    double noisy_l = d_l + stdn(SPIN_THREAD) * WHEEL_STD * sqrt(abs(d_l));
+    double noisy_r = d_r + noise(MOTION, SPIN_THREAD) * WHEEL_STD * sqrt(abs(d_r));
+    double noisy_l = d_l + noise(MOTION, SPIN_THREAD) * WHEEL_STD * sqrt(abs(d_l));
     noisy_x = 0.5*(noisy_r + noisy_l);
     noisy_theta = (noisy_r - noisy_l) / ROBOT_WHEEL_BASE;
   } else {
-    noisy_x = d_x + stdn(SPIN_THREAD) * WHEEL_STD * sqrt(abs(d_x));
+    noisy_x = d_x + noise(MOTION, SPIN_THREAD) * WHEEL_STD * sqrt(abs(d_x));
   }
+  transform_t prev_truth = current_transform_truth_;
   current_transform_truth_ = toTransformRotateFirst(noisy_x, 0., noisy_theta) * current_transform_truth_;
-  if (collides(current_transform_truth_, obstacles_)) {
+  if (sweptFootprintCollides(prev_truth, current_transform_truth_, obstacles_)) {
     std::cout << "You crashed into an obstacle" << std::endl;
   }
   current_transform_odom_ = toTransformRotateFirst(d_x, 0., d_theta) * current_transform_odom_;
@@ -237,32 +412,36 @@ void World::moveRobot(double d_theta, double d_x) {
 
 // Currently this treats landmarks and lidar hits the same;
 // presumably in the real world they should have different noise models.
-void corrupt(point_t &p, double dist, int thread_id) {
+void World::corrupt(point_t &p, double dist, Sensor sensor, int thread_id) {
   // Add noise that increases with distance
-  p(0) += stdn(thread_id) * CORRUPTION_STD * sqrt(dist);
-  if (IS_2D) p(1) += stdn(thread_id) * CORRUPTION_STD * sqrt(dist);
+  p(0) += noise(sensor, thread_id) * CORRUPTION_STD * sqrt(dist);
+  if (is_2d_) p(1) += noise(sensor, thread_id) * CORRUPTION_STD * sqrt(dist);
   // Sometimes completely erase the data
-  if (stdn(thread_id) < DATA_LOSS_THRESHOLD) {
+  if (noise(sensor, thread_id) < DATA_LOSS_THRESHOLD) {
     p *= 0;
   }
 }
 
+obstacles_t World::obstacles() const {
+  return obstacles_.obstacles();
+}
+
 transform_t World::readTrueTransform() {
-  return current_transform_truth_;
+  return fromArray(state_.load().truth);
 }
 
 transform_t World::readOdom() {
-  return current_transform_odom_;
+  return fromArray(state_.load().odom);
 }
 
 points_t World::readLandmarks(int thread_id) {
   points_t landmark_readings;
-  transform_t tf = current_transform_truth_;
+  transform_t tf = readTrueTransform();
   point_t robot_location = tf.inverse() * point_t(0,0,1);
   for (point_t lm : landmarks_) {
     point_t reading = tf * lm;
     double dist = (robot_location - lm).norm();
-    corrupt(reading, dist, thread_id);
+    corrupt(reading, dist, LANDMARKS, thread_id);
     double t = obstacleIntersection(robot_location, lm, obstacles_);
     double angle = atan2(reading.y(), reading.x());
     if (abs(angle) > LANDMARK_HALF_FOV) {
@@ -279,21 +458,23 @@ points_t World::readLandmarks(int thread_id) {
 
 points_t World::readLidar(int thread_id) {
   points_t hits({});
-  transform_t tf_inv = current_transform_truth_.inverse();
+  transform_t tf = readTrueTransform();
+  transform_t tf_inv = tf.inverse();
   point_t r0({0,0,1});
   point_t robot_location = tf_inv * r0;
+  // All beams are sampled from one visibility polygon of the nearby obstacles
+  VisibilityPolygon visible(sensorFrameEdges(tf, obstacles_,
+      obstacles_.obstaclesNear(robot_location(0), robot_location(1), LIDAR_MAX_RANGE),
+      LIDAR_MAX_RANGE));
   for(int j = 0; j < LIDAR_RESOLUTION; j++)
   {
     double angle = LIDAR_FOV_DIR - (LIDAR_FOV / 2.0) + (j * LIDAR_FOV / LIDAR_RESOLUTION);
-    point_t r1;
-    r1 << LIDAR_MAX_RANGE*cos(angle), LIDAR_MAX_RANGE*sin(angle), 1;
-    double t = obstacleIntersection(robot_location, tf_inv*r1, obstacles_);
-    double dist = t*LIDAR_MAX_RANGE;
+    double dist = visible.range(atan2(sin(angle), cos(angle)));
     if (dist < LIDAR_MAX_RANGE && dist > LIDAR_MIN_RANGE)
     {
       point_t hit;
       hit << dist*cos(angle), dist*sin(angle), 1;
-      corrupt(hit, dist, thread_id);
+      corrupt(hit, dist, LIDAR, thread_id);
       if (hit(2) != 0.0) {
         hits.push_back(hit);
       }
@@ -310,14 +491,18 @@ points_t World::readLidar(int thread_id) {
 }
 
 transform_t World::readGPS() {
-  long elapsed = getElapsedUsecs(last_gps_reading_);
-  if (elapsed < GPS_UPDATE_PERIOD_USECS) return transform_t::Zero();
-  gettimeofday(&last_gps_reading_, NULL);
-
-  pose_t p = toPose(current_transform_truth_, 0.);
-  pose_t noise;
-  noise << stdn(0)*GPS_POS_STD, stdn(0)*GPS_POS_STD, stdn(0)*GPS_THETA_STD;
-  p += noise;
+  WorldState state = state_.load();
+  if (state.time - last_gps_time_ < GPS_UPDATE_PERIOD) return transform_t::Zero();
+  last_gps_time_ = state.time;
+  return gpsFix(fromArray(state.truth), 0);
+}
+
+transform_t World::gpsFix(const transform_t &truth, int thread_id) {
+  pose_t p = toPose(truth, 0.);
+  pose_t gps_noise;
+  gps_noise << noise(GPS, thread_id)*GPS_POS_STD, noise(GPS, thread_id)*GPS_POS_STD,
+               noise(GPS, thread_id)*GPS_THETA_STD;
+  p += gps_noise;
   p[2] = 0.0; // no heading information
   return toTransform(p);
 }
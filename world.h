@@ -1,15 +1,31 @@
 #ifndef WORLD_H
 #define WORLD_H
 
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <queue>
 #include <vector>
 #include <Eigen/Core>
 #include <thread>
 #include "utils.h"
 #include "graphics.h"
+#include "obstacle_grid.h"
+#include "philox.h"
+#include "scenario.h"
+#include "seqlock.h"
+#include "sensor_reading.h"
+
+using sensor_callback_t = std::function<void(const SensorReading &)>;
 
 class World {
 public:
-  World();
+  /* A 1D world keeps the robot and all landmarks on the x axis.
+   * A headless world has no window and no simulation thread: simulated time only
+   * advances in step(), so runs go as fast as the CPU allows and repeat exactly for a
+   * given random seed (see setNormalSeed). */
+  World(bool is_2d = true, bool headless = false);
   ~World();
 
   /* Obstacles trigger lidar hits and block landmarks from view.
@@ -23,10 +39,35 @@ public:
   void addDefaultObstacles();
   void addURCObstacles();
   void addDefaultLandmarks();
+  /* Adds the obstacles, landmarks and legs of a scenario file (see scenario.h) and
+   * moves the robot to its start pose. Call before start(). False (with a message) if
+   * the file isn't valid or is of the other dimension. */
+  bool loadScenario(const ScenarioFile &scenario);
+  void setStartPose(const pose_t &pose);
 
   void setCmdVel(double d_theta, double d_x);
 
-  /* The thread_id is used to choose which random number generator to use.
+  /* Draws this world's noise from its own counter-based streams (one per sensor, see
+   * philox.h) for the given seed and run, instead of the process-wide stdn() generators.
+   * Such worlds can be simulated side by side on different threads, and each run
+   * repeats exactly. The streams aren't thread-safe, so this is only for headless
+   * worlds, whose sensors and motion are all sampled on the thread calling step().
+   * Call before start(). */
+  void useRandomStreams(uint64_t seed, uint32_t run);
+
+  /* Sensors are also sampled on a schedule in simulated time: each sensor that has
+   * subscribers fires every 1/rate_hz seconds (from time 0) and its reading is handed
+   * to the subscribers `latency` seconds later. Callbacks run on whichever thread
+   * advances the simulation (the simulation thread, or the caller of step()), and a
+   * sensor nobody subscribed to is never computed. Defaults: lidar and landmarks at
+   * 10 Hz, GPS at 1 Hz, odometry at the physics rate; no latency.
+   * Configure and subscribe before start(). */
+  void setSensorRate(SensorType type, double rate_hz, double latency = 0.0);
+  void subscribe(SensorType type, sensor_callback_t callback);
+
+  /* Readings are of the state the simulation last published (see WorldState), so they
+   * can be taken from any thread while the simulation thread runs.
+   * The thread_id is used to choose which random number generator to use.
    * This is useful for debugging when trying to rerun a particular random seed.
    * If you're not worried about random reproducibility, just use the default (0). */
   points_t readLidar(int thread_id = 0);
@@ -35,28 +76,88 @@ public:
   transform_t readOdom();
   URCLeg getLeg(int index);
 
+  /* Headless worlds only: advances simulated time by dt seconds, running the physics
+   * (every 1/30 s) and sensor events that fall in that time, like the simulation
+   * thread does. */
+  void step(double dt);
+  /* Simulated time in seconds since start(). Readings are of the world at this time. */
+  double time() const;
+
   /* Ground truth */
   const points_t trueLandmarks();
+  obstacles_t obstacles() const; // a copy (see ObstacleGrid::obstacles)
   transform_t readTrueTransform();
 
   void start();
 
 private:
-  obstacles_t obstacles_;
+  /* What changes every tick, published as one snapshot so readers never see the truth
+   * and odometry of different ticks. Transforms are stored as column-major arrays
+   * because Eigen matrices are not trivially copyable. */
+  struct WorldState {
+    double truth[9];
+    double odom[9];
+    double time;
+  };
+  struct CmdVel {
+    double theta;
+    double x;
+  };
+  /* An entry of the event queue. Periodic events (physics ticks and sensor samples)
+   * are the count-th occurrence, at count times their period, so times don't drift. */
+  enum EventKind { PHYSICS = 0, SAMPLE, DELIVER };
+  struct SimEvent {
+    double time;
+    EventKind kind;
+    uint64_t seq;  // keeps equal events in the order they were queued
+    SensorType sensor;
+    long count;
+    std::shared_ptr<const SensorReading> reading;  // DELIVER only
+  };
+  struct LaterEvent {
+    bool operator()(const SimEvent &a, const SimEvent &b) const;
+  };
+  struct SensorSchedule {
+    double rate_hz;
+    double latency;
+    std::vector<sensor_callback_t> subscribers;
+  };
+
+  const bool is_2d_;
+  const bool headless_;
+  ObstacleGrid obstacles_;
   points_t landmarks_;
-  double cmd_vel_x_;
-  double cmd_vel_theta_;
+  SeqLock<CmdVel> cmd_vel_;          // written by the client, read each tick
+  // Owned by whichever thread ticks; everyone else reads state_
   transform_t current_transform_truth_;
   transform_t current_transform_odom_;
+  double sim_time_;
+  SeqLock<WorldState> state_;
   std::thread spin_thread_;
-  bool done_;
+  std::atomic<bool> done_;
   std::vector<URCLeg> legs_;
-  MyWindow window_;
-  struct timeval last_gps_reading_;
+  std::unique_ptr<MyWindow> window_; // null if headless
+  double last_gps_time_;
+  enum Sensor { MOTION = 0, LIDAR, LANDMARKS, GPS, NUM_SENSORS };
+  bool own_streams_;
+  std::array<NormalStream, NUM_SENSORS> streams_;
+  std::priority_queue<SimEvent, std::vector<SimEvent>, LaterEvent> events_;
+  uint64_t next_event_seq_;
+  std::array<SensorSchedule, NUM_SENSOR_TYPES> sensors_;
+  SensorReading render_lidar_, render_landmarks_; // simulation thread only
 
   void spinSim();
+  double noise(Sensor sensor, int thread_id);
+  void advanceTo(double t_end);
+  void schedule(double time, EventKind kind, SensorType sensor, long count,
+                std::shared_ptr<const SensorReading> reading = nullptr);
+  void handleEvent(const SimEvent &event);
+  SensorReading sample(SensorType type);
+  transform_t gpsFix(const transform_t &truth, int thread_id);
+  void publishState();
   void renderReadings(MyWindow &window);
   void moveRobot(double d_theta, double d_x);
+  void corrupt(point_t &p, double dist, Sensor sensor, int thread_id);
 };
 
 #endif